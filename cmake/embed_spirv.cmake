@@ -0,0 +1,34 @@
+# writes every .spv file of SPIRV_DIR into OUTPUT as a constexpr uint32_t
+# array, plus a table of them keyed by the path the pipelines load, e.g.
+# "shaders/simple_shader.vert.spv". run with cmake -P.
+
+file(GLOB SPIRV_FILES "${SPIRV_DIR}/*.spv")
+list(SORT SPIRV_FILES)
+
+# cmake regexes have no {n}, eight words per line.
+string(REPEAT "0x........," 8 EIGHT_WORDS)
+
+set(ARRAYS "")
+set(ENTRIES "")
+foreach (SPIRV ${SPIRV_FILES})
+	get_filename_component(FILE_NAME ${SPIRV} NAME)
+	string(MAKE_C_IDENTIFIER ${FILE_NAME} IDENTIFIER)
+
+	# spir-v is a stream of little endian words, swap every 4 bytes of the hex dump.
+	file(READ ${SPIRV} HEX HEX)
+	string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," WORDS "${HEX}")
+	string(REGEX REPLACE "(${EIGHT_WORDS})" "\\1\n    " WORDS "${WORDS}")
+
+	string(APPEND ARRAYS "alignas(4) constexpr uint32_t ${IDENTIFIER}[] = {\n    ${WORDS}\n};\n\n")
+	string(APPEND ENTRIES "    {\"shaders/${FILE_NAME}\", ${IDENTIFIER}, std::size(${IDENTIFIER})},\n")
+endforeach ()
+
+set(CONTENT "// generated by cmake/embed_spirv.cmake, do not edit.\n#pragma once\n\n#include <cstdint>\n#include <iterator>\n#include <string_view>\n\nnamespace vs::embedded_shaders {\n${ARRAYS}struct entry {\n  std::string_view name;\n  const uint32_t *words;\n  size_t word_count;\n};\n\nconstexpr entry registry[] = {\n${ENTRIES}};\n} // namespace vs::embedded_shaders\n")
+
+# only touch the header when a shader changed, everything including it rebuilds.
+if (EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} OLD_CONTENT)
+endif ()
+if (NOT "${OLD_CONTENT}" STREQUAL "${CONTENT}")
+	file(WRITE ${OUTPUT} "${CONTENT}")
+endif ()
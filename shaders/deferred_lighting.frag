@@ -0,0 +1,137 @@
+#version 450
+
+layout (location = 0) out vec4 outColor;
+
+struct point_light {
+    vec4 position;// w is range
+    vec4 color;// w is intensity
+    float radius;// of the billboard
+    int shadow_index;// layer group of the point shadow map, -1 for none
+};
+
+
+layout(set=0, binding=0) uniform global_ubo {
+    mat4 projection;
+    mat4 view;
+    vec4 ambient_light_color;
+    uvec4 cluster_grid;// clusters in x, y and z, w is the light count
+    vec4 cluster_depth;// slice is log(depth) * x + y
+    vec4 viewport;// width, height, 1 / width, 1 / height
+    vec4 cam_pos;
+    mat4 sun_view_projection;
+    vec4 sun_direction;// the sun shines along xyz
+    vec4 sun_color;// w is intensity
+} ubo;
+
+layout(std430, set=0, binding=2) readonly buffer light_buffer {
+    point_light lights[];
+};
+
+// offset and count into light_indices, cluster (z * y_count + y) * x_count + x.
+layout(std430, set=0, binding=3) readonly buffer cluster_buffer {
+    uvec2 clusters[];
+};
+
+layout(std430, set=0, binding=4) readonly buffer light_index_buffer {
+    uint light_indices[];
+};
+
+// written by vs_shadow_system each frame, compared in hardware.
+layout(set=0, binding=5) uniform sampler2DShadow sun_shadow;
+// 6 faces per shadowed point light, face f of light s is layer s * 6 + f.
+layout(set=0, binding=6) uniform sampler2DArrayShadow point_shadows;
+
+// shader_permutation in vs_pipeline.h, lights past MAX_FRAGMENT_LIGHTS of a cluster are dropped.
+layout(constant_id = 3) const bool SHADOWS = true;
+layout(constant_id = 4) const uint MAX_FRAGMENT_LIGHTS = 256;
+
+// POINT_SHADOW_NEAR of vs_shadow_system, the far plane is the light range.
+const float SHADOW_NEAR = 0.05;
+// face bases of vs_shadow_system, the map x and y run along right and up.
+const vec3 FACE_FORWARD[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 FACE_UP[6] = vec3[](vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, 1), vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 1, 0));
+const vec3 FACE_RIGHT[6] = vec3[](vec3(0, 0, 1), vec3(0, 0, -1), vec3(1, 0, 0), vec3(-1, 0, 0), vec3(-1, 0, 0), vec3(1, 0, 0));
+
+// written by gbuffer.frag in the first subpass, read per sample so msaa edges
+// keep their own lighting.
+layout(input_attachment_index=0, set=1, binding=0) uniform subpassInputMS gbuffer_albedo;
+layout(input_attachment_index=1, set=1, binding=1) uniform subpassInputMS gbuffer_normal;
+layout(input_attachment_index=2, set=1, binding=2) uniform subpassInputMS gbuffer_depth;
+
+
+layout(push_constant) uniform Push {
+    mat4 inverse_view_projection;
+} push;
+
+float sunShadow(vec3 position) {
+    if (!SHADOWS) {
+        return 1.0;
+    }
+    vec4 clip = ubo.sun_view_projection * vec4(position, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    return texture(sun_shadow, vec3(ndc.xy * 0.5 + 0.5, clamp(ndc.z, 0.0, 1.0)));
+}
+
+float pointShadow(point_light light, vec3 position) {
+    if (!SHADOWS || light.shadow_index < 0) {
+        return 1.0;
+    }
+    // the face is picked by the major axis, then projected like its perspective matrix.
+    vec3 d = position - light.position.xyz;
+    vec3 a = abs(d);
+    int face = a.x >= a.y && a.x >= a.z ? (d.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (d.y > 0.0 ? 2 : 3) : (d.z > 0.0 ? 4 : 5));
+    float depth = dot(d, FACE_FORWARD[face]);
+    vec2 uv = vec2(dot(d, FACE_RIGHT[face]), dot(d, FACE_UP[face])) / depth * 0.5 + 0.5;
+    float far = light.position.w;
+    float reference = far / (far - SHADOW_NEAR) - far * SHADOW_NEAR / ((far - SHADOW_NEAR) * depth);
+    return texture(point_shadows, vec4(uv, float(light.shadow_index * 6 + face), reference));
+}
+
+void main() {
+
+    float depth = subpassLoad(gbuffer_depth, gl_SampleID).r;
+    if (depth >= 1.0) {
+        // nothing was drawn here, keep the clear color.
+        discard;
+    }
+
+    vec3 albedo = subpassLoad(gbuffer_albedo, gl_SampleID).rgb;
+    vec3 surface_normal = normalize(subpassLoad(gbuffer_normal, gl_SampleID).xyz * 2.0 - 1.0);
+
+    vec2 ndc = gl_FragCoord.xy * ubo.viewport.zw * 2.0 - 1.0;
+    vec4 position = push.inverse_view_projection * vec4(ndc, depth, 1.0);
+    vec3 fragPosWorld = position.xyz / position.w;
+
+    vec3 diffuse_light = ubo.ambient_light_color.xyz * ubo.ambient_light_color.w;
+
+    // the sun shines along sun_direction, shadowed by its cached map.
+    float sun_incidence = max(dot(surface_normal, -ubo.sun_direction.xyz), 0.0);
+    diffuse_light += ubo.sun_color.xyz * ubo.sun_color.w * sun_incidence * sunShadow(fragPosWorld);
+
+    // same cluster lookup and falloff as simple_shader.frag.
+    float view_depth = (ubo.view * vec4(fragPosWorld, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * ubo.viewport.zw * vec2(ubo.cluster_grid.xy)), ubo.cluster_grid.xy - 1);
+    float slice = log(max(view_depth, 1e-4)) * ubo.cluster_depth.x + ubo.cluster_depth.y;
+    uint z = uint(clamp(slice, 0.0, float(ubo.cluster_grid.z - 1)));
+    uvec2 cluster = clusters[(z * ubo.cluster_grid.y + tile.y) * ubo.cluster_grid.x + tile.x];
+
+    uint light_count = min(cluster.y, MAX_FRAGMENT_LIGHTS);
+    for (uint i = 0; i < light_count; i++) {
+        point_light light = lights[light_indices[cluster.x + i]];
+
+        vec3 direction_to_light = (light.position.xyz - fragPosWorld);
+
+        float distance_squared = dot(direction_to_light, direction_to_light);
+        float falloff = clamp(1.0 - pow(distance_squared / (light.position.w * light.position.w), 2.0), 0.0, 1.0);
+        float attenuation = falloff * falloff / distance_squared;
+
+        float cos_ang_incidence = max(dot(surface_normal, normalize(direction_to_light)), 0);
+
+        vec3 intensity = light.color.xyz * light.color.w * attenuation * pointShadow(light, fragPosWorld);
+
+        diffuse_light += intensity * cos_ang_incidence;
+    }
+
+    outColor = vec4(diffuse_light * albedo, 1.0);
+
+}
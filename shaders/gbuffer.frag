@@ -0,0 +1,48 @@
+#version 450
+// built again with FIXED_TEXTURES for devices without descriptor indexing.
+#ifndef FIXED_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragPosWorld;
+layout (location = 2) in vec3 fragNormalWorld;
+layout (location=3)in vec2 fragTexCoord;
+layout (location=4) flat in uint fragMaterial;
+
+// compact enough to keep per sample with msaa, see vs_swap_chain.
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+
+struct material {
+    vec4 base_color;
+    uint albedo_texture;
+};
+
+// bindless textures and materials of vs_material_system, indexed by the material id of the draw.
+#ifdef FIXED_TEXTURES
+// every slot is written, the material id is uniform within a draw.
+layout(set=0, binding=7) uniform sampler2D textures[FIXED_TEXTURES];
+#define TEXTURE_INDEX(index) (index)
+#else
+layout(set=0, binding=7) uniform sampler2D textures[];
+#define TEXTURE_INDEX(index) nonuniformEXT(index)
+#endif
+layout(std430, set=0, binding=8) readonly buffer material_buffer {
+    material materials[];
+};
+
+// shader_permutation in vs_pipeline.h.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool ALPHA_TEST = false;
+
+
+void main() {
+    material m = materials[fragMaterial];
+    vec4 texel = TEXTURED ? texture(textures[TEXTURE_INDEX(m.albedo_texture)], fragTexCoord) * m.base_color : m.base_color;
+    if (ALPHA_TEST && texel.a < 0.5) {
+        discard;
+    }
+    outAlbedo = vec4(fragColor * texel.rgb, 1.0);
+    outNormal = vec4(normalize(fragNormalWorld) * 0.5 + 0.5, 0.0);
+}
@@ -1,28 +1,18 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
+layout (location = 1) in vec3 fragColor;
 layout (location = 0) out vec4 outColor;
 
-struct point_light {
-	vec4 position; // ignore w
-	vec4 color; // w is intensity
-};
-
-
 layout(set=0, binding=0) uniform global_ubo {
 	mat4 projection;
 	mat4 view;
 	vec4 ambient_light_color;
-	point_light point_lights[10]; // value could be dynamically but is hardcoded for now.
-	int num_lights;
+	uvec4 cluster_grid; // clusters in x, y and z, w is the light count
+	vec4 cluster_depth; // slice is log(depth) * x + y
+	vec4 viewport; // width, height, 1 / width, 1 / height
 } ubo;
 
-layout(push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-
-} push;
 
 
 void main(){
@@ -32,6 +22,6 @@ void main(){
 		discard;
 	}
 
-	outColor = vec4(push.color.xyz, 1.0);
+	outColor = vec4(fragColor, 1.0);
 
 }
\ No newline at end of file
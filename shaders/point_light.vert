@@ -11,40 +11,43 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec3 fragColor;
 
 struct point_light {
-	vec4 position; // ignore w
+	vec4 position; // w is range
 	vec4 color; // w is intensity
+	float radius;
+	int shadow_index;
 };
 
-
 layout(set=0, binding=0) uniform global_ubo {
 	mat4 projection;
 	mat4 view;
 	vec4 ambient_light_color;
-	point_light point_lights[10]; // value could be dynamically but is hardcoded for now.
-	int num_lights;
+	uvec4 cluster_grid; // clusters in x, y and z, w is the light count
+	vec4 cluster_depth; // slice is log(depth) * x + y
+	vec4 viewport; // width, height, 1 / width, 1 / height
 } ubo;
 
-layout(push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-
-} push;
+// same buffer the lighting reads, one billboard instance per light.
+layout(std430, set=0, binding=2) readonly buffer light_buffer {
+	point_light lights[];
+};
 
 
 
 void main() 
 {
 
+	point_light light = lights[gl_InstanceIndex];
 	fragOffset = OFFSETS[gl_VertexIndex];
+	fragColor = light.color.xyz;
 	vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
 	vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-	vec3 position_world = push.position.xyz
-	+ push.radius * fragOffset.x * cameraRightWorld
-	+ push.radius * fragOffset.y * cameraUpWorld;
+	vec3 position_world = light.position.xyz
+	+ light.radius * fragOffset.x * cameraRightWorld
+	+ light.radius * fragOffset.y * cameraUpWorld;
 
 	gl_Position = ubo.projection * ubo.view * vec4(position_world, 1.0);
 
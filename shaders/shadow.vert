@@ -0,0 +1,12 @@
+#version 450
+
+// position only stream of vs_model_component::bindPositions.
+layout(location = 0) in vec3 position;
+
+layout(push_constant) uniform Push {
+    mat4 model_view_projection;
+} push;
+
+void main() {
+    gl_Position = push.model_view_projection * vec4(position, 1.0);
+}
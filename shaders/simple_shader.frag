@@ -1,17 +1,27 @@
 #version 450
+// built again with FIXED_TEXTURES for devices without descriptor indexing.
+#ifndef FIXED_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
 layout (location = 2) in vec3 fragNormalWorld;
 layout (location=3)in vec2 fragTexCoord;
+layout (location=4) flat in uint fragMaterial;
 layout (location = 0) out vec4 outColor;
 
-layout (binding=1) uniform sampler2D texSampler;
+
+// shader_permutation in vs_pipeline.h.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool ALPHA_TEST = false;
 
 struct point_light {
-    vec4 position;// ignore w
+    vec4 position;// w is range
     vec4 color;// w is intensity
+    float radius;// of the billboard
+    int shadow_index;// layer group of the point shadow map, -1 for none
 };
 
 
@@ -19,33 +29,130 @@ layout(set=0, binding=0) uniform global_ubo {
     mat4 projection;
     mat4 view;
     vec4 ambient_light_color;
-    point_light point_lights[10];// value could be dynamically but is hardcoded for now.
-    int num_lights;
+    uvec4 cluster_grid;// clusters in x, y and z, w is the light count
+    vec4 cluster_depth;// slice is log(depth) * x + y
+    vec4 viewport;// width, height, 1 / width, 1 / height
+    vec4 cam_pos;
+    mat4 sun_view_projection;
+    vec4 sun_direction;// the sun shines along xyz
+    vec4 sun_color;// w is intensity
 } ubo;
 
+// clustered lights, built on the cpu every frame by vs_light_cluster_system.
+layout(std430, set=0, binding=2) readonly buffer light_buffer {
+    point_light lights[];
+};
+
+// offset and count into light_indices, cluster (z * y_count + y) * x_count + x.
+layout(std430, set=0, binding=3) readonly buffer cluster_buffer {
+    uvec2 clusters[];
+};
+
+layout(std430, set=0, binding=4) readonly buffer light_index_buffer {
+    uint light_indices[];
+};
+
+// written by vs_shadow_system each frame, compared in hardware.
+layout(set=0, binding=5) uniform sampler2DShadow sun_shadow;
+// 6 faces per shadowed point light, face f of light s is layer s * 6 + f.
+layout(set=0, binding=6) uniform sampler2DArrayShadow point_shadows;
+
+struct material {
+    vec4 base_color;
+    uint albedo_texture;
+};
+
+// bindless textures and materials of vs_material_system, indexed by the material id of the draw.
+#ifdef FIXED_TEXTURES
+// every slot is written, the material id is uniform within a draw.
+layout(set=0, binding=7) uniform sampler2D textures[FIXED_TEXTURES];
+#define TEXTURE_INDEX(index) (index)
+#else
+layout(set=0, binding=7) uniform sampler2D textures[];
+#define TEXTURE_INDEX(index) nonuniformEXT(index)
+#endif
+layout(std430, set=0, binding=8) readonly buffer material_buffer {
+    material materials[];
+};
+
+// shader_permutation in vs_pipeline.h, lights past MAX_FRAGMENT_LIGHTS of a cluster are dropped.
+layout(constant_id = 3) const bool SHADOWS = true;
+layout(constant_id = 4) const uint MAX_FRAGMENT_LIGHTS = 256;
+
+// POINT_SHADOW_NEAR of vs_shadow_system, the far plane is the light range.
+const float SHADOW_NEAR = 0.05;
+// face bases of vs_shadow_system, the map x and y run along right and up.
+const vec3 FACE_FORWARD[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 FACE_UP[6] = vec3[](vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, 1), vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 1, 0));
+const vec3 FACE_RIGHT[6] = vec3[](vec3(0, 0, 1), vec3(0, 0, -1), vec3(1, 0, 0), vec3(-1, 0, 0), vec3(-1, 0, 0), vec3(1, 0, 0));
+
 
 layout(push_constant) uniform Push {
     mat4 model_matrix;
     mat4 normal_matrix;
 } push;
 
+float sunShadow(vec3 position) {
+    if (!SHADOWS) {
+        return 1.0;
+    }
+    vec4 clip = ubo.sun_view_projection * vec4(position, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    return texture(sun_shadow, vec3(ndc.xy * 0.5 + 0.5, clamp(ndc.z, 0.0, 1.0)));
+}
+
+float pointShadow(point_light light, vec3 position) {
+    if (!SHADOWS || light.shadow_index < 0) {
+        return 1.0;
+    }
+    // the face is picked by the major axis, then projected like its perspective matrix.
+    vec3 d = position - light.position.xyz;
+    vec3 a = abs(d);
+    int face = a.x >= a.y && a.x >= a.z ? (d.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (d.y > 0.0 ? 2 : 3) : (d.z > 0.0 ? 4 : 5));
+    float depth = dot(d, FACE_FORWARD[face]);
+    vec2 uv = vec2(dot(d, FACE_RIGHT[face]), dot(d, FACE_UP[face])) / depth * 0.5 + 0.5;
+    float far = light.position.w;
+    float reference = far / (far - SHADOW_NEAR) - far * SHADOW_NEAR / ((far - SHADOW_NEAR) * depth);
+    return texture(point_shadows, vec4(uv, float(light.shadow_index * 6 + face), reference));
+}
 
 void main() {
 
+    material m = materials[fragMaterial];
+    vec4 texel = TEXTURED ? texture(textures[TEXTURE_INDEX(m.albedo_texture)], fragTexCoord) * m.base_color : m.base_color;
+    if (ALPHA_TEST && texel.a < 0.5) {
+        discard;
+    }
+
     vec3 diffuse_light = ubo.ambient_light_color.xyz * ubo.ambient_light_color.w;
     vec3 surface_normal = normalize(fragNormalWorld);
 
+    // the sun shines along sun_direction, shadowed by its cached map.
+    float sun_incidence = max(dot(surface_normal, -ubo.sun_direction.xyz), 0.0);
+    diffuse_light += ubo.sun_color.xyz * ubo.sun_color.w * sun_incidence * sunShadow(fragPosWorld);
+
+
+    // tile of the pixel and exponential depth slice of the fragment.
+    float view_depth = (ubo.view * vec4(fragPosWorld, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * ubo.viewport.zw * vec2(ubo.cluster_grid.xy)), ubo.cluster_grid.xy - 1);
+    float slice = log(max(view_depth, 1e-4)) * ubo.cluster_depth.x + ubo.cluster_depth.y;
+    uint z = uint(clamp(slice, 0.0, float(ubo.cluster_grid.z - 1)));
+    uvec2 cluster = clusters[(z * ubo.cluster_grid.y + tile.y) * ubo.cluster_grid.x + tile.x];
 
-    for (int i = 0; i < ubo.num_lights; i++) {
-        point_light light = ubo.point_lights[i];
+    uint light_count = min(cluster.y, MAX_FRAGMENT_LIGHTS);
+    for (uint i = 0; i < light_count; i++) {
+        point_light light = lights[light_indices[cluster.x + i]];
 
         vec3 direction_to_light = (light.position.xyz - fragPosWorld);
 
-        float attenuation = 1.0 / dot(direction_to_light, direction_to_light);// distance squared.
+        float distance_squared = dot(direction_to_light, direction_to_light);
+        // fades to zero at the range the light was clustered with.
+        float falloff = clamp(1.0 - pow(distance_squared / (light.position.w * light.position.w), 2.0), 0.0, 1.0);
+        float attenuation = falloff * falloff / distance_squared;
 
         float cos_ang_incidence = max(dot(surface_normal, normalize(direction_to_light)), 0);
 
-        vec3 intensity = light.color.xyz * light.color.w * attenuation;
+        vec3 intensity = light.color.xyz * light.color.w * attenuation * pointShadow(light, fragPosWorld);
 
         //spec light
 
@@ -55,6 +162,6 @@ void main() {
     };
 
 
-    outColor = vec4(diffuse_light * fragColor * texture(texSampler, fragTexCoord).rgb, 1.0);
+    outColor = vec4(diffuse_light * fragColor * texel.rgb, 1.0);
 
 }
@@ -9,18 +9,18 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location=3) out vec2 fragTexCoord;
+layout(location=4) flat out uint fragMaterial;
 
-struct point_light {
-    vec4 position;// ignore w
-    vec4 color;// w is intensity
-};
+// vertex format of shader_permutation in vs_pipeline.h, without colors the model is white.
+layout(constant_id = 2) const bool VERTEX_COLORS = true;
 
 layout(set=0, binding=0) uniform global_ubo {
     mat4 projection;
     mat4 view;
     vec4 ambient_light_color;
-    point_light point_lights[10];// value could be dynamically but is hardcoded for now.
-    int num_lights;
+    uvec4 cluster_grid;// clusters in x, y and z, w is the light count
+    vec4 cluster_depth;// slice is log(depth) * x + y
+    vec4 viewport;// width, height, 1 / width, 1 / height
 } ubo;
 
 
@@ -38,8 +38,10 @@ void main(){
 
     fragNormalWorld = normalize(mat3(push.normal_matrix) * normal);
     fragPosWorld = position_world.xyz;
-    fragColor = color;
+    fragColor = VERTEX_COLORS ? color : vec3(1.0);
     fragTexCoord = uv;
+    // the material id rides in the corner the mat3 leaves unused.
+    fragMaterial = uint(push.normal_matrix[3][3]);
 
 
 }
\ No newline at end of file
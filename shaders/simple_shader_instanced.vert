@@ -0,0 +1,54 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location=3) out vec2 fragTexCoord;
+layout(location=4) flat out uint fragMaterial;
+
+// vertex format of shader_permutation in vs_pipeline.h, without colors the model is white.
+layout(constant_id = 2) const bool VERTEX_COLORS = true;
+
+layout(set=0, binding=0) uniform global_ubo {
+    mat4 projection;
+    mat4 view;
+    vec4 ambient_light_color;
+    uvec4 cluster_grid;// clusters in x, y and z, w is the light count
+    vec4 cluster_depth;// slice is log(depth) * x + y
+    vec4 viewport;// width, height, 1 / width, 1 / height
+} ubo;
+
+struct instance_data {
+    mat4 model_matrix;
+    mat4 normal_matrix;
+};
+
+// per instance transforms, written once per frame by the render system.
+// gl_InstanceIndex includes the firstInstance of the draw.
+layout(std430, set=1, binding=0) readonly buffer instance_buffer {
+    instance_data instances[];
+};
+
+
+void main(){
+
+    instance_data instance = instances[gl_InstanceIndex];
+
+    vec4 position_world = instance.model_matrix * vec4(position, 1.0);
+
+    gl_Position = ubo.projection * ubo.view * position_world;
+
+    fragNormalWorld = normalize(mat3(instance.normal_matrix) * normal);
+    fragPosWorld = position_world.xyz;
+    fragColor = VERTEX_COLORS ? color : vec3(1.0);
+    fragTexCoord = uv;
+    // the material id rides in the corner the mat3 leaves unused.
+    fragMaterial = uint(instance.normal_matrix[3][3]);
+
+
+}
@@ -9,6 +9,7 @@
 // std
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
 
 namespace vs
 {
@@ -45,14 +46,57 @@ namespace vs
 	{
 		alignment_size_ = getAlignment(instanceSize, minOffsetAlignment);
 		buffer_size_ = alignment_size_ * instanceCount;
-		device.createBuffer(buffer_size_, usageFlags, memoryPropertyFlags, buffer_, memory_);
+
+		if (memoryPropertyFlags != VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		{
+			device.createBuffer(buffer_size_, usageFlags, memoryPropertyFlags, buffer_, memory_);
+			return;
+		}
+
+		// sub-allocate device local buffers, the transfer usages let the pool move them around
+		// when it defragments.
+		pooled_ = true;
+		usage_flags_ |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = buffer_size_;
+		bufferInfo.usage = usage_flags_;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device.device(), &bufferInfo, nullptr, &buffer_) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create device local buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device.device(), buffer_, &memRequirements);
+
+		allocation_ = device.memoryPool().allocate(memRequirements, memoryPropertyFlags, this);
+		vkBindBufferMemory(device.device(), buffer_, allocation_.memory, allocation_.offset);
 	}
 
 	vs_buffer::~vs_buffer()
 	{
 		unmap();
-		vkDestroyBuffer(device_.device(), buffer_, nullptr);
-		vkFreeMemory(device_.device(), memory_, nullptr);
+		if (pooled_)
+		{
+			device_.memoryPool().free(allocation_, buffer_);
+		}
+		else
+		{
+			vkDestroyBuffer(device_.device(), buffer_, nullptr);
+			vkFreeMemory(device_.device(), memory_, nullptr);
+		}
+	}
+
+	VkBuffer vs_buffer::relocate(VkBuffer buffer, const vs_memory_allocation& allocation)
+	{
+		assert(pooled_ && "only pooled buffers can be relocated");
+		VkBuffer old_buffer = buffer_;
+		buffer_ = buffer;
+		allocation_ = allocation;
+		return old_buffer;
 	}
 
 	/**
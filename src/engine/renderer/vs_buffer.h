@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "vs_device.h"
+#include "vs_memory_pool.h"
 
 namespace vs
 {
@@ -40,13 +41,24 @@ namespace vs
 		VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memory_property_flags_; }
 		VkDeviceSize getBufferSize() const { return buffer_size_; }
 
+		bool isPooled() const { return pooled_; }
+
 	private:
+		friend class vs_memory_pool;
+
+		// Called by the memory pool once a defragmentation copy has completed, returns the
+		// replaced buffer handle which the pool destroys when no frame uses it anymore.
+		VkBuffer relocate(VkBuffer buffer, const vs_memory_allocation& allocation);
+
 		static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
 
 		vs_device& device_;
 		void* mapped_ = nullptr;
 		VkBuffer buffer_ = VK_NULL_HANDLE;
 		VkDeviceMemory memory_ = VK_NULL_HANDLE;
+		// device local buffers live in the device's memory pool instead of their own allocation.
+		bool pooled_ = false;
+		vs_memory_allocation allocation_{};
 
 		VkDeviceSize buffer_size_;
 		uint32_t instance_count_;
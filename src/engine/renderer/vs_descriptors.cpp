@@ -10,7 +10,8 @@ namespace vs {
 vs_descriptor_set_layout::vs_builder &
 vs_descriptor_set_layout::vs_builder::addBinding(
     uint32_t binding, VkDescriptorType descriptorType,
-    VkShaderStageFlags stageFlags, uint32_t count) {
+    VkShaderStageFlags stageFlags, uint32_t count,
+    VkDescriptorBindingFlags flags) {
   assert(bindings_.count(binding) == 0 && "Binding already in use");
   VkDescriptorSetLayoutBinding layoutBinding{};
   layoutBinding.binding = binding;
@@ -18,31 +19,58 @@ vs_descriptor_set_layout::vs_builder::addBinding(
   layoutBinding.descriptorCount = count;
   layoutBinding.stageFlags = stageFlags;
   bindings_[binding] = layoutBinding;
+  if (flags != 0) {
+    binding_flags_[binding] = flags;
+  }
   return *this;
 }
 
 std::unique_ptr<vs_descriptor_set_layout>
 vs_descriptor_set_layout::vs_builder::build() const {
-  return std::make_unique<vs_descriptor_set_layout>(device_, bindings_);
+  return std::make_unique<vs_descriptor_set_layout>(device_, bindings_,
+                                                    binding_flags_);
 }
 
 // *************** Descriptor Set Layout *********************
 
 vs_descriptor_set_layout::vs_descriptor_set_layout(
     vs_device &device,
-    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &binding_flags)
     : device_{device}, bindings_{bindings} {
   std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+  // flags run parallel to the bindings.
+  std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
+  bool updateAfterBind = false;
   for (auto kv : bindings) {
     setLayoutBindings.push_back(kv.second);
+    auto flags = binding_flags.find(kv.first);
+    setLayoutBindingFlags.push_back(flags != binding_flags.end() ? flags->second
+                                                                 : 0);
+    updateAfterBind |= (setLayoutBindingFlags.back() &
+                        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
   }
 
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount =
+      static_cast<uint32_t>(setLayoutBindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
   descriptorSetLayoutInfo.sType =
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   descriptorSetLayoutInfo.bindingCount =
       static_cast<uint32_t>(setLayoutBindings.size());
   descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+  if (!binding_flags.empty()) {
+    descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+  }
+  if (updateAfterBind) {
+    descriptorSetLayoutInfo.flags =
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  }
 
   if (vkCreateDescriptorSetLayout(device.device(), &descriptorSetLayoutInfo,
                                   nullptr,
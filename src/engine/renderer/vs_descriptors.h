@@ -19,20 +19,25 @@ namespace vs
 			{
 			}
 
+			// flags are descriptor indexing binding flags, any update after bind binding makes the
+			// layout need a pool created with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT.
 			vs_builder& addBinding(
 				uint32_t binding,
 				VkDescriptorType descriptorType,
 				VkShaderStageFlags stageFlags,
-				uint32_t count = 1);
+				uint32_t count = 1,
+				VkDescriptorBindingFlags flags = 0);
 			std::unique_ptr<vs_descriptor_set_layout> build() const;
 
 		private:
 			vs_device& device_;
 			std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings_{};
+			std::unordered_map<uint32_t, VkDescriptorBindingFlags> binding_flags_{};
 		};
 
 		vs_descriptor_set_layout(
-			vs_device& lveDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+			vs_device& lveDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+			const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& binding_flags = {});
 		~vs_descriptor_set_layout();
 		vs_descriptor_set_layout(const vs_descriptor_set_layout&) = delete;
 		vs_descriptor_set_layout& operator=(const vs_descriptor_set_layout&) = delete;
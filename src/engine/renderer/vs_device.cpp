@@ -1,9 +1,15 @@
 #include "vs_device.h"
+#include "vs_memory_pool.h"
 
 // std headers
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
@@ -43,16 +49,30 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 }
 
 // class member functions
-vs_device::vs_device(vs::vs_window &window) : window(window) {
+vs_device::vs_device(vs::vs_window &window) : window(&window) {
+  initialize();
+}
+
+vs_device::vs_device() { initialize(); }
+
+void vs_device::initialize() {
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  createPipelineCache();
+  memory_pool_ = std::make_unique<vs_memory_pool>(*this);
 }
 
 vs_device::~vs_device() {
+  if (!isHeadless()) {
+    savePipelineCache();
+  }
+  vkDestroyPipelineCache(device_, pipeline_cache_, nullptr);
+  memory_pool_.reset();
+  destroyTransientPools();
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -140,17 +160,17 @@ void vs_device::pickPhysicalDevice() {
     }
   }
 
+  // integrated and software devices when there is no discrete one.
   for (const auto &device : devices) {
     if (isSuitableDevice(device)) {
-
-      if (physicalDevice == VK_NULL_HANDLE) {
-        throw std::runtime_error("failed to find a suitable GPU!");
-      }
-
+      physicalDevice = device;
       vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+      msaa_samples = getMaxUsableSampleCount();
       std::cout << "physical device: " << properties.deviceName << std::endl;
+      return;
     }
   }
+  throw std::runtime_error("failed to find a suitable GPU!");
 }
 
 void vs_device::createLogicalDevice() {
@@ -174,16 +194,69 @@ void vs_device::createLogicalDevice() {
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading
 
+  // indirect draw features, queried so older devices still get a device.
+  VkPhysicalDeviceVulkan12Features supported12Features = {};
+  supported12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 supportedFeatures = {};
+  supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  const bool isVulkan12 = properties.apiVersion >= VK_API_VERSION_1_2;
+  if (isVulkan12) {
+    supportedFeatures.pNext = &supported12Features;
+  }
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+  multi_draw_indirect_supported =
+      supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+  draw_indirect_first_instance_supported =
+      supportedFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+  draw_indirect_count_supported =
+      isVulkan12 && supported12Features.drawIndirectCount == VK_TRUE;
+  descriptor_indexing_supported =
+      isVulkan12 &&
+      supported12Features.shaderSampledImageArrayNonUniformIndexing ==
+          VK_TRUE &&
+      supported12Features.descriptorBindingSampledImageUpdateAfterBind ==
+          VK_TRUE &&
+      supported12Features.descriptorBindingPartiallyBound == VK_TRUE &&
+      supported12Features.descriptorBindingUpdateUnusedWhilePending == VK_TRUE;
+  sampled_image_dynamic_indexing_supported =
+      supportedFeatures.features.shaderSampledImageArrayDynamicIndexing ==
+      VK_TRUE;
+  deviceFeatures.multiDrawIndirect =
+      multi_draw_indirect_supported ? VK_TRUE : VK_FALSE;
+  deviceFeatures.shaderSampledImageArrayDynamicIndexing =
+      sampled_image_dynamic_indexing_supported ? VK_TRUE : VK_FALSE;
+  deviceFeatures.drawIndirectFirstInstance =
+      draw_indirect_first_instance_supported ? VK_TRUE : VK_FALSE;
+
+  VkPhysicalDeviceVulkan12Features enabled12Features = {};
+  enabled12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  enabled12Features.drawIndirectCount =
+      draw_indirect_count_supported ? VK_TRUE : VK_FALSE;
+  const VkBool32 descriptorIndexing =
+      descriptor_indexing_supported ? VK_TRUE : VK_FALSE;
+  enabled12Features.shaderSampledImageArrayNonUniformIndexing =
+      descriptorIndexing;
+  enabled12Features.descriptorBindingSampledImageUpdateAfterBind =
+      descriptorIndexing;
+  enabled12Features.descriptorBindingPartiallyBound = descriptorIndexing;
+  enabled12Features.descriptorBindingUpdateUnusedWhilePending =
+      descriptorIndexing;
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = isVulkan12 ? &enabled12Features : nullptr;
 
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
+  // headless devices never present.
   createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
+      isHeadless() ? 0 : static_cast<uint32_t>(deviceExtensions.size());
   createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
   // might not really be necessary anymore because device specific
@@ -220,13 +293,126 @@ void vs_device::createCommandPool() {
   }
 }
 
+// written in front of the driver's cache data, the driver header only names
+// the vendor and device, a new driver may reject or misuse an old blob.
+struct pipeline_cache_prefix {
+  uint32_t magic;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t cache_uuid[VK_UUID_SIZE];
+  uint64_t data_size;
+};
+static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x76737063; // "vspc"
+
+void vs_device::createPipelineCache() {
+  std::vector<char> initial_data;
+  std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+  if (file.is_open()) {
+    const size_t file_size = static_cast<size_t>(file.tellg());
+    pipeline_cache_prefix prefix{};
+    if (file_size >= sizeof(prefix)) {
+      file.seekg(0);
+      file.read(reinterpret_cast<char *>(&prefix), sizeof(prefix));
+    }
+    // a stale or foreign cache is dropped, pipelines then compile cold.
+    if (file && prefix.magic == PIPELINE_CACHE_MAGIC &&
+        prefix.vendor_id == properties.vendorID &&
+        prefix.device_id == properties.deviceID &&
+        prefix.driver_version == properties.driverVersion &&
+        std::memcmp(prefix.cache_uuid, properties.pipelineCacheUUID,
+                    VK_UUID_SIZE) == 0 &&
+        prefix.data_size == file_size - sizeof(prefix)) {
+      initial_data.resize(prefix.data_size);
+      file.read(initial_data.data(), prefix.data_size);
+      if (!file) {
+        initial_data.clear();
+      }
+    }
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = initial_data.size();
+  cacheInfo.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipeline_cache_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+  pipeline_cache_warm_ = !initial_data.empty();
+}
+
+void vs_device::savePipelineCache() {
+  size_t data_size = 0;
+  if (vkGetPipelineCacheData(device_, pipeline_cache_, &data_size, nullptr) !=
+          VK_SUCCESS ||
+      data_size == 0) {
+    return;
+  }
+  std::vector<char> data(data_size);
+  if (vkGetPipelineCacheData(device_, pipeline_cache_, &data_size,
+                             data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  pipeline_cache_prefix prefix{};
+  prefix.magic = PIPELINE_CACHE_MAGIC;
+  prefix.vendor_id = properties.vendorID;
+  prefix.device_id = properties.deviceID;
+  prefix.driver_version = properties.driverVersion;
+  std::memcpy(prefix.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  prefix.data_size = data_size;
+
+  // written next to the old cache and renamed over it, so a crash while
+  // saving never leaves a truncated cache behind.
+  const std::string temp_path = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      std::cerr << "failed to write pipeline cache: " << temp_path
+                << std::endl;
+      return;
+    }
+    file.write(reinterpret_cast<const char *>(&prefix), sizeof(prefix));
+    file.write(data.data(), data_size);
+    if (!file) {
+      std::cerr << "failed to write pipeline cache: " << temp_path
+                << std::endl;
+      return;
+    }
+  }
+  std::remove(PIPELINE_CACHE_PATH);
+  std::rename(temp_path.c_str(), PIPELINE_CACHE_PATH);
+}
+
+void vs_device::addPipelineCreationTime(double milliseconds) {
+  pipeline_creation_us_.fetch_add(
+      static_cast<uint64_t>(milliseconds * 1000.0), std::memory_order_relaxed);
+}
+
+double vs_device::getPipelineCreationTime() const {
+  return static_cast<double>(
+             pipeline_creation_us_.load(std::memory_order_relaxed)) /
+         1000.0;
+}
+
 void vs_device::createSurface() {
-  window.createWindowSurface(instance, &surface_);
+  if (isHeadless()) {
+    return;
+  }
+  window->createWindowSurface(instance, &surface_);
 }
 
 bool vs_device::isSuitableDevice(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+  if (isHeadless()) {
+    return indices.isComplete() && supportedFeatures.samplerAnisotropy &&
+           supportedFeatures.sampleRateShading;
+  }
+
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
   bool swapChainAdequate = false;
@@ -236,9 +422,6 @@ bool vs_device::isSuitableDevice(VkPhysicalDevice device) {
                         !swapChainSupport.presentModes.empty();
   }
 
-  VkPhysicalDeviceFeatures supportedFeatures;
-  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
   return indices.isComplete() && extensionsSupported && swapChainAdequate &&
          supportedFeatures.samplerAnisotropy &&
          supportedFeatures.sampleRateShading;
@@ -294,12 +477,13 @@ bool vs_device::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> vs_device::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions,
-                                       glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+  if (!isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -368,8 +552,12 @@ QueueFamilyIndices vs_device::findQueueFamilies(VkPhysicalDevice device) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    // without a surface the graphics queue stands in for presenting.
+    VkBool32 presentSupport = isHeadless() && indices.graphicsFamilyHasValue;
+    if (!isHeadless()) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_,
+                                           &presentSupport);
+    }
     if (queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
@@ -473,25 +661,107 @@ void vs_device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
   vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
 
-VkCommandBuffer vs_device::beginSingleTimeCommands() {
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
+void vs_device::destroyTransientPools() {
+  std::lock_guard<std::mutex> lock{transient_pools_mutex_};
+  for (auto &kv : transient_pools_) {
+    auto &pool = kv.second;
+    for (auto &transient : pool.command_buffers) {
+      // a buffer acquired but never submitted would never signal its fence.
+      if (transient.submitted) {
+        vkWaitForFences(device_, 1, &transient.fence, VK_TRUE,
+                        std::numeric_limits<uint64_t>::max());
+      }
+      vkDestroyFence(device_, transient.fence, nullptr);
+    }
+    // destroying the pool frees its command buffers.
+    vkDestroyCommandPool(device_, pool.command_pool, nullptr);
+  }
+  transient_pools_.clear();
+}
 
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+vs_device::transient_pool &vs_device::getTransientPool() {
+  std::lock_guard<std::mutex> lock{transient_pools_mutex_};
+  // references into the map stay valid when other threads insert their pool.
+  auto &pool = transient_pools_[std::this_thread::get_id()];
+  if (pool.command_pool != VK_NULL_HANDLE) {
+    return pool;
+  }
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = findPhysicalQueueFamilies().graphicsFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool.command_pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create transient command pool!");
+  }
+  return pool;
+}
+
+VkCommandBuffer
+vs_device::acquireTransientCommandBuffer(transient_pool &pool) {
+  // a signaled fence means the command buffer is neither recording nor
+  // executing and can be recycled.
+  transient_command_buffer *free_buffer = nullptr;
+  for (auto &transient : pool.command_buffers) {
+    if (vkGetFenceStatus(device_, transient.fence) == VK_SUCCESS) {
+      free_buffer = &transient;
+      break;
+    }
+  }
+
+  if (free_buffer == nullptr) {
+    transient_command_buffer transient{};
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool.command_pool;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device_, &allocInfo,
+                                 &transient.command_buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate transient command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    if (vkCreateFence(device_, &fenceInfo, nullptr, &transient.fence) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create transient command fence!");
+    }
+
+    pool.command_buffers.push_back(transient);
+    free_buffer = &pool.command_buffers.back();
+  }
+
+  // unsignaled until the submission completes, which marks it as in use.
+  vkResetFences(device_, 1, &free_buffer->fence);
+  free_buffer->submitted = false;
+  vkResetCommandBuffer(free_buffer->command_buffer, 0);
 
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-  return commandBuffer;
+  vkBeginCommandBuffer(free_buffer->command_buffer, &beginInfo);
+  return free_buffer->command_buffer;
 }
 
-void vs_device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+void vs_device::submitTransientCommandBuffer(transient_pool &pool,
+                                             VkCommandBuffer commandBuffer) {
+  auto transient =
+      std::find_if(pool.command_buffers.begin(), pool.command_buffers.end(),
+                   [commandBuffer](const transient_command_buffer &t) {
+                     return t.command_buffer == commandBuffer;
+                   });
+  assert(transient != pool.command_buffers.end() &&
+         "command buffer was not acquired from this thread's transient pool");
+
   vkEndCommandBuffer(commandBuffer);
 
   VkSubmitInfo submitInfo{};
@@ -499,10 +769,143 @@ void vs_device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  if (submitGraphics(submitInfo, transient->fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit single time commands!");
+  }
+  transient->submitted = true;
+  // only wait for our own work instead of idling the whole queue.
+  vkWaitForFences(device_, 1, &transient->fence, VK_TRUE,
+                  std::numeric_limits<uint64_t>::max());
+}
+
+void vs_device::discardTransientCommandBuffer(transient_pool &pool,
+                                              VkCommandBuffer commandBuffer) {
+  auto transient =
+      std::find_if(pool.command_buffers.begin(), pool.command_buffers.end(),
+                   [commandBuffer](const transient_command_buffer &t) {
+                     return t.command_buffer == commandBuffer;
+                   });
+  assert(transient != pool.command_buffers.end() &&
+         "command buffer was not acquired from this thread's transient pool");
+
+  // its fence was reset for a submission that never happens and would never
+  // signal, the next acquire allocates a fresh buffer instead.
+  vkEndCommandBuffer(commandBuffer);
+  vkFreeCommandBuffers(device_, pool.command_pool, 1, &commandBuffer);
+  vkDestroyFence(device_, transient->fence, nullptr);
+  pool.command_buffers.erase(transient);
+}
+
+VkResult vs_device::submitGraphics(const VkSubmitInfo &submitInfo,
+                                   VkFence fence) {
+  std::lock_guard<std::mutex> lock{queue_mutex_};
+  return vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+}
+
+VkCommandBuffer vs_device::beginSingleTimeCommands() {
+  auto &pool = getTransientPool();
+  if (pool.batch_depth > 0) {
+    return pool.batch_command_buffer;
+  }
+  return acquireTransientCommandBuffer(pool);
+}
+
+void vs_device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+  auto &pool = getTransientPool();
+  if (pool.batch_depth > 0 && commandBuffer == pool.batch_command_buffer) {
+    // submitted together with the rest of the batch.
+    return;
+  }
+  submitTransientCommandBuffer(pool, commandBuffer);
+}
+
+void vs_device::beginTransferBatch() {
+  auto &pool = getTransientPool();
+  if (pool.batch_depth++ == 0) {
+    pool.batch_command_buffer = acquireTransientCommandBuffer(pool);
+  }
+}
+
+void vs_device::endTransferBatch() {
+  auto &pool = getTransientPool();
+  assert(pool.batch_depth > 0 && "endTransferBatch without beginTransferBatch");
+  if (--pool.batch_depth > 0) {
+    return;
+  }
+
+  const bool discarded = pool.batch_discarded;
+  closeTransferBatch(pool);
+  if (discarded) {
+    throw std::runtime_error("transfer batch was discarded by a nested batch");
+  }
+}
+
+void vs_device::discardTransferBatch() {
+  auto &pool = getTransientPool();
+  assert(pool.batch_depth > 0 &&
+         "discardTransferBatch without beginTransferBatch");
+  // the commands of a nested batch are already in the shared command buffer.
+  pool.batch_discarded = true;
+  if (--pool.batch_depth > 0) {
+    return;
+  }
+  closeTransferBatch(pool);
+}
+
+void vs_device::closeTransferBatch(transient_pool &pool) {
+  // the batch is closed even if the submit throws, so the next one starts clean.
+  VkCommandBuffer commandBuffer = pool.batch_command_buffer;
+  auto releases = std::move(pool.batch_releases);
+  const bool discarded = pool.batch_discarded;
+  pool.batch_command_buffer = VK_NULL_HANDLE;
+  pool.batch_releases.clear();
+  pool.batch_discarded = false;
+
+  auto runReleases = [&releases] {
+    for (auto &release : releases) {
+      release();
+    }
+  };
+  try {
+    if (discarded) {
+      discardTransientCommandBuffer(pool, commandBuffer);
+    } else {
+      submitTransientCommandBuffer(pool, commandBuffer);
+    }
+  } catch (...) {
+    // a failed submit never reaches the gpu, so the releases are safe.
+    runReleases();
+    throw;
+  }
+  // a discarded batch never reached the gpu either.
+  runReleases();
+}
 
-  vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+vs_transfer_batch::~vs_transfer_batch() {
+  if (!open_)
+    return;
+  open_ = false;
+  try {
+    // the throw may have left the batch half recorded, e.g. an image without
+    // its layout transition.
+    if (std::uncaught_exceptions() > uncaught_exceptions_) {
+      device_.discardTransferBatch();
+    } else {
+      device_.endTransferBatch();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "transfer batch failed: " << e.what() << std::endl;
+  }
+}
+
+void vs_device::releaseAfterTransfer(std::function<void()> release) {
+  auto &pool = getTransientPool();
+  if (pool.batch_depth == 0) {
+    // single time commands outside of a batch have already completed.
+    release();
+    return;
+  }
+  pool.batch_releases.push_back(std::move(release));
 }
 
 void vs_device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
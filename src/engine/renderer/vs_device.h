@@ -3,9 +3,19 @@
 #include "vs_window.h"
 
 // std lib headers
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace vs {
+class vs_memory_pool;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -30,6 +40,9 @@ public:
 #endif
 
   vs_device(vs_window &window);
+  // headless, without a surface or swap chain support, for tests and tools
+  // that only use queues and memory. Leaves the pipeline cache file alone.
+  vs_device();
   ~vs_device();
 
   // Not copyable or movable
@@ -43,11 +56,28 @@ public:
   VkDevice device() { return device_; }
   VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
   VkSurfaceKHR surface() { return surface_; }
+  bool isHeadless() const { return window == nullptr; }
 
   VkQueue graphicsQueue() { return graphicsQueue_; }
 
   VkQueue presentQueue() { return presentQueue_; }
 
+  // Graphics queue submission, safe to call from any thread.
+  VkResult submitGraphics(const VkSubmitInfo &submitInfo, VkFence fence);
+
+  // Sub-allocator for device local buffers.
+  vs_memory_pool &memoryPool() { return *memory_pool_; }
+
+  // Pass to every vkCreate*Pipelines call. Loaded from PIPELINE_CACHE_PATH
+  // when the file was written by the same device and driver, saved when the
+  // device is destroyed.
+  VkPipelineCache pipelineCache() { return pipeline_cache_; }
+  bool isPipelineCacheWarm() const { return pipeline_cache_warm_; }
+  void savePipelineCache();
+  // Time spent in pipeline creation since startup, safe from any thread.
+  void addPipelineCreationTime(double milliseconds);
+  double getPipelineCreationTime() const;
+
   SwapChainSupportDetails getSwapChainSupport() {
     return querySwapChainSupport(physicalDevice);
   }
@@ -69,6 +99,18 @@ public:
                     VkDeviceMemory &bufferMemory);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+
+  // While a transfer batch is open on the calling thread, single time
+  // commands are recorded into one command buffer and submitted once, when
+  // the outermost batch ends. Prefer the vs_transfer_batch scope below.
+  void beginTransferBatch();
+  void endTransferBatch();
+  // ends the batch without submitting it, the outermost one then drops what
+  // every nested batch recorded.
+  void discardTransferBatch();
+  // Runs release once the commands recorded so far on this thread have
+  // completed; immediately if no batch is open.
+  void releaseAfterTransfer(std::function<void()> release);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
   void transitionImageLayout(VkImage image, VkFormat format,
@@ -85,14 +127,29 @@ public:
   VkSampleCountFlagBits getMaxUsableSampleCount();
   VkPhysicalDeviceProperties properties;
   VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+  // optional features used by gpu driven rendering, enabled when available.
+  bool multi_draw_indirect_supported = false;
+  // the indirect draws start at their object's instance, required by
+  // vs_indirect_render_system.
+  bool draw_indirect_first_instance_supported = false;
+  bool draw_indirect_count_supported = false;
+  // partially bound, update after bind and non uniformly indexed sampled
+  // image arrays, for the bindless textures of vs_material_system.
+  bool descriptor_indexing_supported = false;
+  // uniformly indexed sampled image arrays, the fixed texture array
+  // vs_material_system falls back to without descriptor indexing.
+  bool sampled_image_dynamic_indexing_supported = false;
 
 private:
+  void initialize();
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
+  void destroyTransientPools();
 
   // helper functions
   bool isSuitableDevice(VkPhysicalDevice device);
@@ -106,20 +163,87 @@ private:
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
+  // single time commands are recorded from a transient pool per thread, the
+  // command buffers are recycled once their fence has signaled.
+  struct transient_command_buffer {
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    // the fence only signals once submitted, unsubmitted ones are not waited on.
+    bool submitted = false;
+  };
+
+  struct transient_pool {
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    std::vector<transient_command_buffer> command_buffers;
+
+    VkCommandBuffer batch_command_buffer = VK_NULL_HANDLE;
+    uint32_t batch_depth = 0;
+    bool batch_discarded = false;
+    std::vector<std::function<void()>> batch_releases;
+  };
+
+  transient_pool &getTransientPool();
+  VkCommandBuffer acquireTransientCommandBuffer(transient_pool &pool);
+  void submitTransientCommandBuffer(transient_pool &pool,
+                                    VkCommandBuffer commandBuffer);
+  // returns a command buffer that was never submitted to the pool.
+  void discardTransientCommandBuffer(transient_pool &pool,
+                                     VkCommandBuffer commandBuffer);
+  // closes the outermost batch and submits it unless it was discarded.
+  void closeTransferBatch(transient_pool &pool);
+
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  vs_window &window;
+  vs_window *window = nullptr;
   VkCommandPool commandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
 
+  std::unique_ptr<vs_memory_pool> memory_pool_;
+
+  static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+  VkPipelineCache pipeline_cache_ = VK_NULL_HANDLE;
+  bool pipeline_cache_warm_ = false;
+  std::atomic<uint64_t> pipeline_creation_us_{0};
+
+  std::unordered_map<std::thread::id, transient_pool> transient_pools_;
+  std::mutex transient_pools_mutex_;
+  // queue submissions may come from several loading threads.
+  std::mutex queue_mutex_;
+
   const std::vector<const char *> validationLayers = {
       "VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
+
+// Scope that batches every single time command issued on this thread into a
+// single submission, e.g. the uploads, layout transitions and mip blits of one
+// texture. Call submit() to get submission errors, the destructor can't throw
+// and only logs them. A scope left by an exception discards the batch instead
+// of submitting what was recorded before the throw.
+class vs_transfer_batch {
+public:
+  explicit vs_transfer_batch(vs_device &device) : device_{device} {
+    device_.beginTransferBatch();
+  }
+  ~vs_transfer_batch();
+
+  vs_transfer_batch(const vs_transfer_batch &) = delete;
+  vs_transfer_batch &operator=(const vs_transfer_batch &) = delete;
+
+  void submit() {
+    open_ = false;
+    device_.endTransferBatch();
+  }
+
+private:
+  vs_device &device_;
+  bool open_ = true;
+  const int uncaught_exceptions_ = std::uncaught_exceptions();
+};
 } // namespace vs
@@ -0,0 +1,102 @@
+#include "vs_frame_context.h"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace vs {
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+vs_frame_context::vs_frame_context(vs_device &device, int index,
+                                   VkDeviceSize uniform_size,
+                                   VkDeviceSize transient_size)
+    : device_(device), index_(index), uniform_size_(uniform_size) {
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex =
+      device_.findPhysicalQueueFamilies().graphicsFamily;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  if (vkCreateCommandPool(device_.device(), &pool_info, nullptr,
+                          &command_pool_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create frame command pool");
+  }
+
+  VkCommandBufferAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandPool = command_pool_;
+  alloc_info.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device_.device(), &alloc_info,
+                               &command_buffer_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate frame command buffer");
+  }
+
+  // signaled, the first wait() must not block.
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  if (vkCreateFence(device_.device(), &fence_info, nullptr, &fence_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create frame fence");
+  }
+
+  // the arena starts where a uniform or storage descriptor may point.
+  const auto &limits = device_.properties.limits;
+  const VkDeviceSize descriptor_alignment =
+      std::max(limits.minUniformBufferOffsetAlignment,
+               limits.minStorageBufferOffsetAlignment);
+  transient_begin_ = alignUp(uniform_size_, descriptor_alignment);
+  transient_offset_ = transient_begin_;
+
+  buffer_ = std::make_unique<vs_buffer>(
+      device_, transient_begin_ + transient_size, 1,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (buffer_->map() != VK_SUCCESS) {
+    throw std::runtime_error("frame buffer could not be mapped");
+  }
+}
+
+vs_frame_context::~vs_frame_context() {
+  vkDestroyFence(device_.device(), fence_, nullptr);
+  // frees the command buffer as well.
+  vkDestroyCommandPool(device_.device(), command_pool_, nullptr);
+}
+
+void vs_frame_context::wait() {
+  vkWaitForFences(device_.device(), 1, &fence_, VK_TRUE,
+                  std::numeric_limits<uint64_t>::max());
+  vkResetCommandPool(device_.device(), command_pool_, 0);
+  transient_offset_ = transient_begin_;
+}
+
+void vs_frame_context::writeUniform(const void *data) {
+  std::memcpy(buffer_->getMappedMemory(), data, uniform_size_);
+}
+
+VkDescriptorBufferInfo vs_frame_context::uniformDescriptorInfo() {
+  return buffer_->descriptorInfo(uniform_size_, 0);
+}
+
+vs_frame_context::transient_allocation
+vs_frame_context::allocateTransient(VkDeviceSize size, VkDeviceSize alignment) {
+  const VkDeviceSize offset = alignUp(transient_offset_, alignment);
+  if (offset + size > buffer_->getBufferSize()) {
+    throw std::runtime_error("frame transient memory exhausted");
+  }
+  transient_offset_ = offset + size;
+
+  transient_allocation allocation{};
+  allocation.buffer = buffer_->getBuffer();
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.data = static_cast<char *>(buffer_->getMappedMemory()) + offset;
+  return allocation;
+}
+} // namespace vs
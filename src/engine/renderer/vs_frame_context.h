@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vs_buffer.h"
+#include "vs_device.h"
+
+// std
+#include <memory>
+
+namespace vs {
+// Everything one frame in flight records into or uploads from. The renderer
+// waits on the context's fence before handing it out again, after that the
+// command buffer, the uniform slice and the transient memory can be
+// rewritten without stalling the frames still on the gpu.
+//
+// All host memory of the frame lives in one mapped buffer: the uniform slice
+// at offset 0, followed by the transient arena that is rewound every frame.
+class vs_frame_context {
+public:
+  static constexpr VkDeviceSize DEFAULT_TRANSIENT_SIZE = 1024 * 1024;
+
+  struct transient_allocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *data = nullptr;
+  };
+
+  vs_frame_context(vs_device &device, int index, VkDeviceSize uniform_size,
+                   VkDeviceSize transient_size = DEFAULT_TRANSIENT_SIZE);
+  ~vs_frame_context();
+
+  vs_frame_context(const vs_frame_context &) = delete;
+  vs_frame_context &operator=(const vs_frame_context &) = delete;
+
+  // waits for the last submission of this context, then recycles its command
+  // buffer and transient memory.
+  void wait();
+
+  int getIndex() const { return index_; }
+  VkCommandBuffer getCommandBuffer() const { return command_buffer_; }
+  VkFence getFence() const { return fence_; }
+
+  // the descriptor set sourcing the uniform slice, owned by whoever created
+  // it from the context's uniformDescriptorInfo().
+  VkDescriptorSet getGlobalDescriptorSet() const {
+    return global_descriptor_set_;
+  }
+  void setGlobalDescriptorSet(VkDescriptorSet set) {
+    global_descriptor_set_ = set;
+  }
+
+  void writeUniform(const void *data);
+  VkDescriptorBufferInfo uniformDescriptorInfo();
+
+  // suballocates host visible memory valid until this context comes around
+  // again, throws when the arena is exhausted.
+  transient_allocation allocateTransient(VkDeviceSize size,
+                                         VkDeviceSize alignment = 16);
+  VkDeviceSize getTransientUsed() const {
+    return transient_offset_ - transient_begin_;
+  }
+
+private:
+  vs_device &device_;
+  int index_;
+
+  VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
+  VkFence fence_ = VK_NULL_HANDLE;
+  VkDescriptorSet global_descriptor_set_ = VK_NULL_HANDLE;
+
+  std::unique_ptr<vs_buffer> buffer_;
+  VkDeviceSize uniform_size_;
+  VkDeviceSize transient_begin_;
+  VkDeviceSize transient_offset_;
+};
+} // namespace vs
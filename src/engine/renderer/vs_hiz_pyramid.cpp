@@ -0,0 +1,343 @@
+#include "vs_hiz_pyramid.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vs {
+namespace {
+struct hiz_push_constant_data {
+  glm::ivec2 src_size;
+  glm::ivec2 dst_size;
+  int sample_count;
+};
+
+constexpr uint32_t HIZ_GROUP_SIZE = 8;
+
+uint32_t groupCount(uint32_t size) {
+  return (size + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE;
+}
+
+bool hasStencilComponent(VkFormat format) {
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+} // namespace
+
+vs_hiz_pyramid::vs_hiz_pyramid(vs_device &device) : device_{device} {
+  multisampled_ = device_.msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+  VkSamplerCreateInfo sampler_info{};
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_info.magFilter = VK_FILTER_NEAREST;
+  sampler_info.minFilter = VK_FILTER_NEAREST;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.minLod = 0.f;
+  sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+  if (vkCreateSampler(device_.device(), &sampler_info, nullptr, &sampler_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z sampler");
+  }
+
+  createPipelines();
+}
+
+vs_hiz_pyramid::~vs_hiz_pyramid() {
+  destroyImage();
+  vkDestroySampler(device_.device(), sampler_, nullptr);
+  vkDestroyPipelineLayout(device_.device(), depth_pipeline_layout_, nullptr);
+  vkDestroyPipelineLayout(device_.device(), reduce_pipeline_layout_, nullptr);
+}
+
+void vs_hiz_pyramid::createPipelines() {
+  depth_set_layout_ =
+      vs_descriptor_set_layout::vs_builder(device_)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                      VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+  reduce_set_layout_ = vs_descriptor_set_layout::vs_builder(device_)
+                           .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                       VK_SHADER_STAGE_COMPUTE_BIT)
+                           .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                       VK_SHADER_STAGE_COMPUTE_BIT)
+                           .build();
+
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(hiz_push_constant_data);
+
+  auto createLayout = [&](VkDescriptorSetLayout set_layout,
+                          VkPipelineLayout &pipeline_layout) {
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    if (vkCreatePipelineLayout(device_.device(), &layout_info, nullptr,
+                               &pipeline_layout) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create hi-z pipeline layout");
+    }
+  };
+  createLayout(depth_set_layout_->getDescriptorSetLayout(),
+               depth_pipeline_layout_);
+  createLayout(reduce_set_layout_->getDescriptorSetLayout(),
+               reduce_pipeline_layout_);
+
+  depth_pipeline_ = std::make_unique<vs_pipeline>(
+      device_,
+      multisampled_ ? "shaders/hiz_depth_msaa.comp.spv"
+                    : "shaders/hiz_depth.comp.spv",
+      depth_pipeline_layout_);
+  reduce_pipeline_ = std::make_unique<vs_pipeline>(
+      device_, "shaders/hiz_reduce.comp.spv", reduce_pipeline_layout_);
+}
+
+bool vs_hiz_pyramid::resize(vs_swap_chain &swap_chain) {
+  if (swap_chain.getId() == swap_chain_id_)
+    return false;
+
+  // previous frames may still read the old pyramid.
+  vkDeviceWaitIdle(device_.device());
+  destroyImage();
+  createImage(swap_chain);
+  createDescriptorSets(swap_chain);
+  swap_chain_id_ = swap_chain.getId();
+  view_projection_ = glm::mat4{1.f};
+  return true;
+}
+
+void vs_hiz_pyramid::createImage(vs_swap_chain &swap_chain) {
+  extent_ = swap_chain.getSwapChainExtent();
+  mip_levels_ = static_cast<uint32_t>(std::floor(std::log2(
+                    std::max(extent_.width, extent_.height)))) +
+                1;
+
+  VkImageCreateInfo image_info{};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType = VK_IMAGE_TYPE_2D;
+  image_info.extent = {extent_.width, extent_.height, 1};
+  image_info.mipLevels = mip_levels_;
+  image_info.arrayLayers = 1;
+  image_info.format = VK_FORMAT_R32_SFLOAT;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  device_.createImageWithInfo(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              image_, image_memory_);
+
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = image_;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = VK_FORMAT_R32_SFLOAT;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = mip_levels_;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+  if (vkCreateImageView(device_.device(), &view_info, nullptr,
+                        &image_view_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z image view");
+  }
+
+  level_views_.resize(mip_levels_);
+  for (uint32_t level = 0; level < mip_levels_; ++level) {
+    view_info.subresourceRange.baseMipLevel = level;
+    view_info.subresourceRange.levelCount = 1;
+    if (vkCreateImageView(device_.device(), &view_info, nullptr,
+                          &level_views_[level]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create hi-z level view");
+    }
+  }
+
+  // start at the far plane so nothing is hidden before the first build.
+  VkCommandBuffer command_buffer = device_.beginSingleTimeCommands();
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image_;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels_, 0, 1};
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkClearColorValue far_plane{{1.f, 1.f, 1.f, 1.f}};
+  vkCmdClearColorImage(command_buffer, image_, VK_IMAGE_LAYOUT_GENERAL,
+                       &far_plane, 1, &barrier.subresourceRange);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  device_.endSingleTimeCommands(command_buffer);
+}
+
+void vs_hiz_pyramid::createDescriptorSets(vs_swap_chain &swap_chain) {
+  const auto image_count = static_cast<uint32_t>(swap_chain.imageCount());
+  descriptor_pool_ =
+      vs_descriptor_pool::vs_builder(device_)
+          .setMaxSets(image_count + mip_levels_)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_count)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                       image_count + 2 * mip_levels_)
+          .build();
+
+  VkDescriptorImageInfo level_0_info{VK_NULL_HANDLE, level_views_[0],
+                                     VK_IMAGE_LAYOUT_GENERAL};
+
+  depth_descriptor_sets_.resize(image_count);
+  for (uint32_t i = 0; i < image_count; ++i) {
+    VkDescriptorImageInfo depth_info{sampler_,
+                                     swap_chain.getDepthImageView(i),
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    vs_descriptor_writer(*depth_set_layout_, *descriptor_pool_)
+        .writeImage(0, &depth_info)
+        .writeImage(1, &level_0_info)
+        .build(depth_descriptor_sets_[i]);
+  }
+
+  reduce_descriptor_sets_.resize(mip_levels_ - 1);
+  for (uint32_t level = 1; level < mip_levels_; ++level) {
+    VkDescriptorImageInfo src_info{VK_NULL_HANDLE, level_views_[level - 1],
+                                   VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo dst_info{VK_NULL_HANDLE, level_views_[level],
+                                   VK_IMAGE_LAYOUT_GENERAL};
+    vs_descriptor_writer(*reduce_set_layout_, *descriptor_pool_)
+        .writeImage(0, &src_info)
+        .writeImage(1, &dst_info)
+        .build(reduce_descriptor_sets_[level - 1]);
+  }
+}
+
+void vs_hiz_pyramid::destroyImage() {
+  descriptor_pool_.reset();
+  depth_descriptor_sets_.clear();
+  reduce_descriptor_sets_.clear();
+
+  for (auto view : level_views_) {
+    vkDestroyImageView(device_.device(), view, nullptr);
+  }
+  level_views_.clear();
+  vkDestroyImageView(device_.device(), image_view_, nullptr);
+  vkDestroyImage(device_.device(), image_, nullptr);
+  vkFreeMemory(device_.device(), image_memory_, nullptr);
+  image_view_ = VK_NULL_HANDLE;
+  image_ = VK_NULL_HANDLE;
+  image_memory_ = VK_NULL_HANDLE;
+}
+
+void vs_hiz_pyramid::build(VkCommandBuffer command_buffer,
+                           vs_swap_chain &swap_chain, uint32_t image_index,
+                           const glm::mat4 &view_projection) {
+  const VkFormat depth_format = swap_chain.getDepthFormat();
+  VkImageAspectFlags depth_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (hasStencilComponent(depth_format)) {
+    depth_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+
+  // depth attachment -> sampled, the pyramid may still be read by this
+  // frame's first culling pass.
+  VkImageMemoryBarrier depth_barrier{};
+  depth_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  depth_barrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depth_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  depth_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depth_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depth_barrier.image = swap_chain.getDepthImage(image_index);
+  depth_barrier.subresourceRange = {depth_aspect, 0, 1, 0, 1};
+  depth_barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depth_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &depth_barrier);
+
+  hiz_push_constant_data push{};
+  push.src_size = glm::ivec2(static_cast<int>(extent_.width),
+                             static_cast<int>(extent_.height));
+  push.dst_size = push.src_size;
+  push.sample_count = static_cast<int>(device_.msaa_samples);
+
+  depth_pipeline_->bind(command_buffer);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          depth_pipeline_layout_, 0, 1,
+                          &depth_descriptor_sets_[image_index], 0, nullptr);
+  vkCmdPushConstants(command_buffer, depth_pipeline_layout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(hiz_push_constant_data), &push);
+  vkCmdDispatch(command_buffer, groupCount(extent_.width),
+                groupCount(extent_.height), 1);
+
+  VkImageMemoryBarrier level_barrier{};
+  level_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  level_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  level_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  level_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  level_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  level_barrier.image = image_;
+  level_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  level_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  reduce_pipeline_->bind(command_buffer);
+  for (uint32_t level = 1; level < mip_levels_; ++level) {
+    level_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1,
+                                      0, 1};
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &level_barrier);
+
+    push.src_size = push.dst_size;
+    push.dst_size = glm::max(push.src_size / 2, glm::ivec2{1});
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            reduce_pipeline_layout_, 0, 1,
+                            &reduce_descriptor_sets_[level - 1], 0, nullptr);
+    vkCmdPushConstants(command_buffer, reduce_pipeline_layout_,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(hiz_push_constant_data), &push);
+    vkCmdDispatch(command_buffer, groupCount(push.dst_size.x),
+                  groupCount(push.dst_size.y), 1);
+  }
+
+  // last level visible to the culling pass, depth back to an attachment.
+  level_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mip_levels_ - 1,
+                                    1, 0, 1};
+  depth_barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  depth_barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depth_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depth_barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  VkImageMemoryBarrier final_barriers[] = {level_barrier, depth_barrier};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       0, 0, nullptr, 0, nullptr, 2, final_barriers);
+
+  view_projection_ = view_projection;
+}
+
+VkDescriptorImageInfo vs_hiz_pyramid::descriptorInfo() const {
+  return VkDescriptorImageInfo{sampler_, image_view_, VK_IMAGE_LAYOUT_GENERAL};
+}
+} // namespace vs
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "vs_descriptors.h"
+#include "vs_device.h"
+#include "vs_pipeline.h"
+#include "vs_swap_chain.h"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace vs {
+// Hierarchical depth of the swap chain's depth attachment. Every mip level
+// stores the farthest depth of the texels it covers, so a box whose nearest
+// depth lies behind the pyramid texels under its screen rectangle is hidden.
+// The image stays in VK_IMAGE_LAYOUT_GENERAL and starts out at the far plane,
+// which hides nothing.
+class vs_hiz_pyramid {
+public:
+  explicit vs_hiz_pyramid(vs_device &device);
+  ~vs_hiz_pyramid();
+
+  vs_hiz_pyramid(const vs_hiz_pyramid &) = delete;
+  vs_hiz_pyramid &operator=(const vs_hiz_pyramid &) = delete;
+
+  // recreates the pyramid for a new swap chain, waits for the device when it
+  // does. Returns true if descriptors referring to the pyramid must be
+  // rewritten.
+  bool resize(vs_swap_chain &swap_chain);
+
+  // reduces the depth attachment of image_index into the pyramid. Record
+  // after the render pass that wrote the depth has ended; the depth is
+  // handed back in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL.
+  void build(VkCommandBuffer command_buffer, vs_swap_chain &swap_chain,
+             uint32_t image_index, const glm::mat4 &view_projection);
+
+  VkDescriptorImageInfo descriptorInfo() const;
+  VkExtent2D getExtent() const { return extent_; }
+  uint32_t getMipLevels() const { return mip_levels_; }
+  // camera the pyramid was built with, identity until the first build.
+  const glm::mat4 &getViewProjection() const { return view_projection_; }
+
+private:
+  void createPipelines();
+  void createImage(vs_swap_chain &swap_chain);
+  void createDescriptorSets(vs_swap_chain &swap_chain);
+  void destroyImage();
+
+  vs_device &device_;
+  uint64_t swap_chain_id_ = UINT64_MAX;
+  bool multisampled_ = false;
+
+  VkImage image_ = VK_NULL_HANDLE;
+  VkDeviceMemory image_memory_ = VK_NULL_HANDLE;
+  VkImageView image_view_ = VK_NULL_HANDLE;
+  std::vector<VkImageView> level_views_;
+  VkSampler sampler_ = VK_NULL_HANDLE;
+  VkExtent2D extent_{0, 0};
+  uint32_t mip_levels_ = 0;
+  glm::mat4 view_projection_{1.f};
+
+  std::unique_ptr<vs_descriptor_set_layout> depth_set_layout_;
+  std::unique_ptr<vs_descriptor_set_layout> reduce_set_layout_;
+  std::unique_ptr<vs_descriptor_pool> descriptor_pool_;
+  // one per swap chain image, reading its depth attachment.
+  std::vector<VkDescriptorSet> depth_descriptor_sets_;
+  // one per level after the first, reading the level above.
+  std::vector<VkDescriptorSet> reduce_descriptor_sets_;
+
+  VkPipelineLayout depth_pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout reduce_pipeline_layout_ = VK_NULL_HANDLE;
+  std::unique_ptr<vs_pipeline> depth_pipeline_;
+  std::unique_ptr<vs_pipeline> reduce_pipeline_;
+};
+} // namespace vs
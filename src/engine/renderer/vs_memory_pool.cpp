@@ -0,0 +1,514 @@
+#include "vs_memory_pool.h"
+
+#include "vs_buffer.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace vs {
+namespace {
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  // vulkan alignments are always powers of two.
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+vs_memory_pool::vs_memory_pool(vs_device &device) : device_{device} {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = device_.findPhysicalQueueFamilies().graphicsFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(device_.device(), &poolInfo, nullptr,
+                          &command_pool_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create defragmentation command pool!");
+  }
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = command_pool_;
+  allocInfo.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers(device_.device(), &allocInfo,
+                               &command_buffer_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate defragmentation commands!");
+  }
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  if (vkCreateFence(device_.device(), &fenceInfo, nullptr, &fence_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create defragmentation fence!");
+  }
+}
+
+vs_memory_pool::~vs_memory_pool() {
+  vkWaitForFences(device_.device(), 1, &fence_, VK_TRUE,
+                  std::numeric_limits<uint64_t>::max());
+
+  for (auto &move : pending_moves_) {
+    vkDestroyBuffer(device_.device(), move.dst_buffer, nullptr);
+    vkDestroyBuffer(device_.device(), move.src_buffer, nullptr);
+  }
+  for (auto &retired : retired_buffers_) {
+    vkDestroyBuffer(device_.device(), retired.buffer, nullptr);
+  }
+  for (auto &b : blocks_) {
+    vkFreeMemory(device_.device(), b.memory, nullptr);
+  }
+
+  vkDestroyFence(device_.device(), fence_, nullptr);
+  vkDestroyCommandPool(device_.device(), command_pool_, nullptr);
+}
+
+vs_memory_allocation
+vs_memory_pool::allocate(const VkMemoryRequirements &requirements,
+                         VkMemoryPropertyFlags properties, vs_buffer *owner) {
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  uint32_t memory_type_index =
+      device_.findMemoryType(requirements.memoryTypeBits, properties);
+
+  for (auto &b : blocks_) {
+    if (b.memory_type_index != memory_type_index) {
+      continue;
+    }
+    VkDeviceSize offset;
+    if (findFreeRange(b, requirements.size, requirements.alignment, b.size,
+                      offset)) {
+      insertRange(b, {offset, requirements.size, requirements.alignment, owner});
+      return {b.memory, offset, requirements.size};
+    }
+  }
+
+  block b{};
+  b.size = std::max(BLOCK_SIZE, requirements.size);
+  b.memory_type_index = memory_type_index;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = b.size;
+  allocInfo.memoryTypeIndex = memory_type_index;
+
+  if (vkAllocateMemory(device_.device(), &allocInfo, nullptr, &b.memory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory block!");
+  }
+
+  b.ranges.push_back({0, requirements.size, requirements.alignment, owner});
+  blocks_.push_back(std::move(b));
+  return {blocks_.back().memory, 0, requirements.size};
+}
+
+void vs_memory_pool::free(const vs_memory_allocation &allocation,
+                          VkBuffer buffer) {
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  for (auto &move : pending_moves_) {
+    if (move.memory == allocation.memory &&
+        move.src_offset == allocation.offset) {
+      // the copy may still be reading this range, keep it reserved until the
+      // move completes and drop both ends then.
+      move.owner = nullptr;
+      move.src_buffer = buffer;
+      block *b = findBlock(allocation.memory);
+      for (auto &r : b->ranges) {
+        if (r.offset == allocation.offset) {
+          r.owner = nullptr;
+        }
+      }
+      return;
+    }
+  }
+
+  vkDestroyBuffer(device_.device(), buffer, nullptr);
+
+  block *b = findBlock(allocation.memory);
+  assert(b != nullptr && "allocation does not belong to this pool");
+  eraseRange(*b, allocation.offset);
+  releaseEmptyBlocks();
+}
+
+float vs_memory_pool::fragmentation() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return fragmentationLocked();
+}
+
+float vs_memory_pool::fragmentationLocked() const {
+  VkDeviceSize total_free = 0;
+  VkDeviceSize largest_free = 0;
+
+  for (auto &b : blocks_) {
+    VkDeviceSize cursor = 0;
+    for (auto &r : b.ranges) {
+      VkDeviceSize gap = r.offset - cursor;
+      total_free += gap;
+      largest_free = std::max(largest_free, gap);
+      cursor = r.offset + r.size;
+    }
+    VkDeviceSize tail = b.size - cursor;
+    total_free += tail;
+    largest_free = std::max(largest_free, tail);
+  }
+
+  if (total_free == 0) {
+    return 0.f;
+  }
+  return 1.f - static_cast<float>(largest_free) /
+                   static_cast<float>(total_free);
+}
+
+void vs_memory_pool::defragment(VkDeviceSize byte_budget,
+                                uint32_t frames_in_flight) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  frames_in_flight_ = frames_in_flight;
+
+  retireBuffers();
+
+  if (!pending_moves_.empty()) {
+    // patch owners once the copies of the previous call have landed, new
+    // moves are recorded on the next call.
+    completeMoves();
+    return;
+  }
+
+  float fragmentation_before = fragmentationLocked();
+  if (fragmentation_before <= 0.f) {
+    return;
+  }
+
+  last_stats_ = {};
+  last_stats_.fragmentation_before = fragmentation_before;
+  recordMoves(byte_budget);
+}
+
+bool vs_memory_pool::findFreeRange(const block &b, VkDeviceSize size,
+                                   VkDeviceSize alignment, VkDeviceSize limit,
+                                   VkDeviceSize &offset) const {
+  // first fit, the range must end at or before limit.
+  VkDeviceSize end = std::min(limit, b.size);
+  VkDeviceSize cursor = 0;
+  for (auto &r : b.ranges) {
+    VkDeviceSize aligned = alignUp(cursor, alignment);
+    if (aligned + size > end) {
+      return false;
+    }
+    if (aligned + size <= r.offset) {
+      offset = aligned;
+      return true;
+    }
+    cursor = r.offset + r.size;
+  }
+
+  VkDeviceSize aligned = alignUp(cursor, alignment);
+  if (aligned + size <= end) {
+    offset = aligned;
+    return true;
+  }
+  return false;
+}
+
+void vs_memory_pool::insertRange(block &b, const range &r) {
+  auto it = std::lower_bound(
+      b.ranges.begin(), b.ranges.end(), r.offset,
+      [](const range &lhs, VkDeviceSize offset) { return lhs.offset < offset; });
+  b.ranges.insert(it, r);
+}
+
+void vs_memory_pool::eraseRange(block &b, VkDeviceSize offset) {
+  auto it = std::lower_bound(
+      b.ranges.begin(), b.ranges.end(), offset,
+      [](const range &lhs, VkDeviceSize value) { return lhs.offset < value; });
+  assert(it != b.ranges.end() && it->offset == offset &&
+         "no allocation at offset");
+  b.ranges.erase(it);
+}
+
+vs_memory_pool::block *vs_memory_pool::findBlock(VkDeviceMemory memory) {
+  for (auto &b : blocks_) {
+    if (b.memory == memory) {
+      return &b;
+    }
+  }
+  return nullptr;
+}
+
+bool vs_memory_pool::isMovable(const vs_buffer &buffer) {
+  // descriptor sets keep their own copy of the VkBuffer handle, only buffers
+  // that are bound by handle at record time can be patched.
+  constexpr VkBufferUsageFlags descriptor_usage =
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT |
+      VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT;
+  return (buffer.getUsageFlags() & descriptor_usage) == 0 &&
+         (buffer.getUsageFlags() & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) != 0;
+}
+
+VkDeviceSize vs_memory_pool::usedBytes(const block &b) {
+  VkDeviceSize used = 0;
+  for (auto &r : b.ranges) {
+    used += r.size;
+  }
+  return used;
+}
+
+vs_memory_pool::block *vs_memory_pool::findEvacuationBlock() {
+  // the least used block whose buffers can all move and fit into the free
+  // space of the other blocks of its memory type.
+  block *victim = nullptr;
+  VkDeviceSize victim_used = 0;
+  for (auto &b : blocks_) {
+    if (b.ranges.empty() ||
+        !std::all_of(b.ranges.begin(), b.ranges.end(), [](const range &r) {
+          return r.owner != nullptr && isMovable(*r.owner);
+        })) {
+      continue;
+    }
+    const VkDeviceSize used = usedBytes(b);
+    VkDeviceSize free_elsewhere = 0;
+    for (auto &other : blocks_) {
+      if (&other != &b && other.memory_type_index == b.memory_type_index) {
+        free_elsewhere += other.size - usedBytes(other);
+      }
+    }
+    if (free_elsewhere >= used && (victim == nullptr || used < victim_used)) {
+      victim = &b;
+      victim_used = used;
+    }
+  }
+  return victim;
+}
+
+void vs_memory_pool::recordMove(block &src, const range &r, block &dst,
+                                VkDeviceSize dst_offset, bool &recording) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = r.owner->getBufferSize();
+  bufferInfo.usage = r.owner->getUsageFlags();
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer dst_buffer;
+  if (vkCreateBuffer(device_.device(), &bufferInfo, nullptr, &dst_buffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create defragmentation buffer!");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device_.device(), dst_buffer, &requirements);
+  assert(requirements.size <= r.size &&
+         requirements.alignment <= r.alignment &&
+         "relocated buffer has different memory requirements");
+
+  vkBindBufferMemory(device_.device(), dst_buffer, dst.memory, dst_offset);
+  insertRange(dst, {dst_offset, r.size, r.alignment, nullptr});
+
+  if (!recording) {
+    vkResetCommandBuffer(command_buffer_, 0);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer_, &beginInfo);
+    recording = true;
+  }
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = 0;
+  copyRegion.dstOffset = 0;
+  copyRegion.size = r.owner->getBufferSize();
+  vkCmdCopyBuffer(command_buffer_, r.owner->getBuffer(), dst_buffer, 1,
+                  &copyRegion);
+
+  pending_moves_.push_back({r.owner,
+                            src.memory,
+                            r.offset,
+                            {dst.memory, dst_offset, r.size},
+                            dst_buffer,
+                            VK_NULL_HANDLE});
+}
+
+void vs_memory_pool::recordMoves(VkDeviceSize byte_budget) {
+  bool recording = false;
+
+  // compaction alone never empties a block. move the buffers of the least
+  // used one into the others first, fullest first so the ones that receive
+  // them aren't emptied next, and release it once the copies landed.
+  block *victim = findEvacuationBlock();
+  bool evacuating = false;
+  if (victim != nullptr) {
+    std::vector<block *> targets;
+    for (auto &b : blocks_) {
+      if (&b != victim && b.memory_type_index == victim->memory_type_index) {
+        targets.push_back(&b);
+      }
+    }
+    std::sort(targets.begin(), targets.end(), [](block *a, block *b) {
+      return usedBytes(*a) > usedBytes(*b);
+    });
+
+    for (size_t i = 0; i < victim->ranges.size(); ++i) {
+      const range r = victim->ranges[i];
+      if (r.size > byte_budget) {
+        break;
+      }
+      block *dst = nullptr;
+      VkDeviceSize dst_offset = 0;
+      for (auto *target : targets) {
+        if (findFreeRange(*target, r.size, r.alignment, target->size,
+                          dst_offset)) {
+          dst = target;
+          break;
+        }
+      }
+      if (dst == nullptr) {
+        break;
+      }
+      recordMove(*victim, r, *dst, dst_offset, recording);
+      evacuating = true;
+      byte_budget -= r.size;
+    }
+  }
+
+  for (auto &b : blocks_) {
+    if (evacuating && &b == victim) {
+      continue;
+    }
+    // walk down from the top of the block so live buffers sink towards
+    // offset 0 and the free space gathers in one range at the end.
+    std::vector<range> candidates(b.ranges.rbegin(), b.ranges.rend());
+    for (auto &r : candidates) {
+      if (r.owner == nullptr || !isMovable(*r.owner) || r.size > byte_budget) {
+        continue;
+      }
+
+      VkDeviceSize dst_offset;
+      if (!findFreeRange(b, r.size, r.alignment, r.offset, dst_offset)) {
+        continue;
+      }
+      recordMove(b, r, b, dst_offset, recording);
+      byte_budget -= r.size;
+    }
+  }
+
+  if (!recording) {
+    return;
+  }
+
+  // make the copies visible to vertex input of the frames that use the
+  // patched buffers.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer_, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+  vkEndCommandBuffer(command_buffer_);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &command_buffer_;
+
+  vkResetFences(device_.device(), 1, &fence_);
+  if (device_.submitGraphics(submitInfo, fence_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit defragmentation copies!");
+  }
+}
+
+void vs_memory_pool::completeMoves() {
+  if (vkGetFenceStatus(device_.device(), fence_) != VK_SUCCESS) {
+    return;
+  }
+
+  for (auto &move : pending_moves_) {
+    block *src = findBlock(move.memory);
+    block *dst = findBlock(move.dst.memory);
+    assert(src != nullptr && dst != nullptr &&
+           "moved allocation lost its block");
+
+    if (move.owner == nullptr) {
+      // owner went away while copying, nothing to patch.
+      eraseRange(*src, move.src_offset);
+      eraseRange(*dst, move.dst.offset);
+      retired_buffers_.push_back({move.src_buffer, 0});
+      retired_buffers_.push_back({move.dst_buffer, 0});
+      continue;
+    }
+
+    VkBuffer old_buffer = move.owner->relocate(move.dst_buffer, move.dst);
+    eraseRange(*src, move.src_offset);
+    for (auto &r : dst->ranges) {
+      if (r.offset == move.dst.offset) {
+        r.owner = move.owner;
+      }
+    }
+    // frames already recorded may still bind the old handle.
+    retired_buffers_.push_back({old_buffer, frames_in_flight_});
+
+    last_stats_.bytes_moved += move.dst.size;
+    last_stats_.moves++;
+  }
+  pending_moves_.clear();
+  if (last_stats_.moves > 0) {
+    relocation_generation_++;
+  }
+
+  releaseEmptyBlocks();
+
+  last_stats_.fragmentation_after = fragmentationLocked();
+  if (last_stats_.moves > 0) {
+    std::cout << "defragmented device memory: moved " << last_stats_.moves
+              << " buffers (" << last_stats_.bytes_moved << " bytes), "
+              << "fragmentation " << last_stats_.fragmentation_before
+              << " -> " << last_stats_.fragmentation_after << std::endl;
+  }
+}
+
+void vs_memory_pool::retireBuffers() {
+  for (auto &retired : retired_buffers_) {
+    if (retired.frames_left == 0) {
+      vkDestroyBuffer(device_.device(), retired.buffer, nullptr);
+      retired.buffer = VK_NULL_HANDLE;
+    } else {
+      retired.frames_left--;
+    }
+  }
+  retired_buffers_.erase(
+      std::remove_if(retired_buffers_.begin(), retired_buffers_.end(),
+                     [](const retired_buffer &retired) {
+                       return retired.buffer == VK_NULL_HANDLE;
+                     }),
+      retired_buffers_.end());
+}
+
+void vs_memory_pool::releaseEmptyBlocks() {
+  // hand emptied blocks back to the driver, but keep the last one of a memory
+  // type so a buffer freed and created every frame doesn't reallocate it.
+  for (size_t i = 0; i < blocks_.size();) {
+    const block &b = blocks_[i];
+    const bool has_other =
+        std::any_of(blocks_.begin(), blocks_.end(), [&b](const block &other) {
+          return &other != &b && other.memory_type_index == b.memory_type_index;
+        });
+    if (b.ranges.empty() && has_other) {
+      vkFreeMemory(device_.device(), b.memory, nullptr);
+      blocks_.erase(blocks_.begin() + static_cast<std::ptrdiff_t>(i));
+    } else {
+      ++i;
+    }
+  }
+}
+
+size_t vs_memory_pool::getBlockCount() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return blocks_.size();
+}
+} // namespace vs
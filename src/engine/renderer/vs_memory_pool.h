@@ -0,0 +1,133 @@
+#pragma once
+
+#include "vs_device.h"
+
+// std
+#include <mutex>
+#include <vector>
+
+namespace vs {
+class vs_buffer;
+
+struct vs_memory_allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+};
+
+// Sub-allocates device local buffers out of large memory blocks. Over a long
+// session the blocks fragment as buffers come and go, defragment() compacts
+// them a few megabytes per frame by copying live buffers into lower free
+// ranges and patching the owning vs_buffer once the copy has completed. It
+// also moves the buffers of the least used block into the others, blocks left
+// empty are freed, except the last one of each memory type.
+class vs_memory_pool {
+public:
+  static constexpr VkDeviceSize BLOCK_SIZE = 64ull * 1024 * 1024;
+
+  struct defrag_stats {
+    float fragmentation_before = 0.f;
+    float fragmentation_after = 0.f;
+    VkDeviceSize bytes_moved = 0;
+    uint32_t moves = 0;
+  };
+
+  explicit vs_memory_pool(vs_device &device);
+  ~vs_memory_pool();
+
+  vs_memory_pool(const vs_memory_pool &) = delete;
+  vs_memory_pool &operator=(const vs_memory_pool &) = delete;
+
+  vs_memory_allocation allocate(const VkMemoryRequirements &requirements,
+                                VkMemoryPropertyFlags properties,
+                                vs_buffer *owner);
+  // Destroys buffer and returns its range to the pool, freeing the block if
+  // that emptied it. If a defragmentation copy is still reading it both are
+  // released once the copy completes.
+  void free(const vs_memory_allocation &allocation, VkBuffer buffer);
+
+  // 1 - largest free range / total free space. 0 means all free space is
+  // contiguous, values close to 1 mean allocations will start failing long
+  // before the pool is actually full.
+  float fragmentation() const;
+
+  // Call once per frame after the frame's fence has been waited on. Either
+  // patches the owners of the moves recorded by a previous call once their
+  // copies completed, or records new moves of at most byte_budget bytes.
+  // Replaced buffers are destroyed frames_in_flight calls later, when no
+  // frame can reference them anymore.
+  void defragment(VkDeviceSize byte_budget, uint32_t frames_in_flight);
+
+  const defrag_stats &getLastDefragStats() const { return last_stats_; }
+  size_t getBlockCount() const;
+  // Changes whenever buffers were relocated. Recorded command buffers that are
+  // reused across frames must be recorded again, they bind the old handles.
+  uint64_t getRelocationGeneration() const { return relocation_generation_; }
+
+private:
+  struct range {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    // nullptr while the range is reserved as the destination of a move.
+    vs_buffer *owner;
+  };
+
+  struct block {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t memory_type_index;
+    std::vector<range> ranges; // sorted by offset
+  };
+
+  struct pending_move {
+    vs_buffer *owner; // nullptr if the owner was destroyed during the move
+    VkDeviceMemory memory; // of the source, dst may be in another block
+    VkDeviceSize src_offset;
+    vs_memory_allocation dst;
+    VkBuffer dst_buffer;
+    // source handle handed back by free() when the owner died mid copy.
+    VkBuffer src_buffer;
+  };
+
+  struct retired_buffer {
+    VkBuffer buffer;
+    uint32_t frames_left;
+  };
+
+  bool findFreeRange(const block &b, VkDeviceSize size, VkDeviceSize alignment,
+                     VkDeviceSize limit, VkDeviceSize &offset) const;
+  static void insertRange(block &b, const range &r);
+  static void eraseRange(block &b, VkDeviceSize offset);
+  block *findBlock(VkDeviceMemory memory);
+  static VkDeviceSize usedBytes(const block &b);
+  // nullptr when no block can be emptied into the others.
+  block *findEvacuationBlock();
+  float fragmentationLocked() const;
+
+  static bool isMovable(const vs_buffer &buffer);
+
+  void completeMoves();
+  void recordMoves(VkDeviceSize byte_budget);
+  // copies r of src into a reserved range of dst, patched by completeMoves().
+  void recordMove(block &src, const range &r, block &dst,
+                  VkDeviceSize dst_offset, bool &recording);
+  void retireBuffers();
+  void releaseEmptyBlocks();
+
+  vs_device &device_;
+  std::vector<block> blocks_;
+
+  std::vector<pending_move> pending_moves_;
+  std::vector<retired_buffer> retired_buffers_;
+  uint32_t frames_in_flight_ = 1;
+
+  VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
+  VkFence fence_ = VK_NULL_HANDLE;
+
+  defrag_stats last_stats_{};
+  uint64_t relocation_generation_ = 0;
+  mutable std::mutex mutex_;
+};
+} // namespace vs
@@ -1,10 +1,13 @@
 ﻿#include "vs_pipeline.h"
 
 #include <cassert>
-#include <fstream>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
 #include <stdexcept>
 
 #include "vs_model_component.h"
+#include "vs_shader_registry.h"
 
 namespace vs {
 vs_pipeline::vs_pipeline(vs_device &device, const std::string &vert_path,
@@ -14,29 +17,29 @@ vs_pipeline::vs_pipeline(vs_device &device, const std::string &vert_path,
   create_graphics_pipeline(vert_path, frag_path, config);
 }
 
+vs_pipeline::vs_pipeline(vs_device &device, const std::string &comp_path,
+                         VkPipelineLayout pipeline_layout)
+    : device_{device}, bind_point_{VK_PIPELINE_BIND_POINT_COMPUTE} {
+  create_compute_pipeline(comp_path, pipeline_layout);
+}
+
 vs_pipeline::~vs_pipeline() {
   vkDestroyShaderModule(device_.device(), vert_shader_module_, nullptr);
   vkDestroyShaderModule(device_.device(), frag_shader_module_, nullptr);
+  vkDestroyShaderModule(device_.device(), comp_shader_module_, nullptr);
   vkDestroyPipeline(device_.device(), graphics_pipeline_, nullptr);
 }
 
 void vs_pipeline::bind(VkCommandBuffer command_buffer) {
-  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    graphics_pipeline_);
+  vkCmdBindPipeline(command_buffer, bind_point_, graphics_pipeline_);
 }
 
-std::vector<char> vs_pipeline::readFile(const std::string &filepath) {
-  std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-  if (!file.is_open()) {
-    throw std::runtime_error("failed to open file: " + filepath);
-  }
-  size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
-
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-  file.close();
-  return buffer;
+void vs_pipeline::dispatch(VkCommandBuffer command_buffer,
+                           uint32_t group_count_x, uint32_t group_count_y,
+                           uint32_t group_count_z) {
+  assert(bind_point_ == VK_PIPELINE_BIND_POINT_COMPUTE &&
+         "only compute pipelines can be dispatched");
+  vkCmdDispatch(command_buffer, group_count_x, group_count_y, group_count_z);
 }
 
 void vs_pipeline::create_graphics_pipeline(
@@ -49,22 +52,38 @@ void vs_pipeline::create_graphics_pipeline(
          "Cannot create graphics pipeline:: no renderPass provided in "
          "config_info");
 
-  auto vert_code = readFile(vert_path);
-  auto frag_code = readFile(frag_path);
+  create_shader_module(vs_shader_registry::get(vert_path),
+                       &vert_shader_module_);
+  // depth only pipelines have no fragment stage.
+  if (!frag_path.empty()) {
+    create_shader_module(vs_shader_registry::get(frag_path),
+                         &frag_shader_module_);
+  }
 
-  create_shader_module(vert_code, &vert_shader_module_);
-  create_shader_module(frag_code, &frag_shader_module_);
+  const uint32_t shader_stage_count = frag_path.empty() ? 1 : 2;
 
-  const int shader_stage_count = 2;
+  const VkSpecializationMapEntry specialization_entries[] = {
+      {0, offsetof(shader_permutation, textured), sizeof(VkBool32)},
+      {1, offsetof(shader_permutation, alpha_test), sizeof(VkBool32)},
+      {2, offsetof(shader_permutation, vertex_colors), sizeof(VkBool32)},
+      {3, offsetof(shader_permutation, shadows), sizeof(VkBool32)},
+      {4, offsetof(shader_permutation, max_fragment_lights), sizeof(uint32_t)},
+  };
+  VkSpecializationInfo specialization_info{};
+  specialization_info.mapEntryCount =
+      static_cast<uint32_t>(std::size(specialization_entries));
+  specialization_info.pMapEntries = specialization_entries;
+  specialization_info.dataSize = sizeof(shader_permutation);
+  specialization_info.pData = &config_info.permutation;
 
-  VkPipelineShaderStageCreateInfo shader_stages[shader_stage_count]{};
+  VkPipelineShaderStageCreateInfo shader_stages[2]{};
   shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
   shader_stages[0].module = vert_shader_module_;
   shader_stages[0].pName = "main";
   shader_stages[0].flags = 0;
   shader_stages[0].pNext = nullptr;
-  shader_stages[0].pSpecializationInfo = nullptr;
+  shader_stages[0].pSpecializationInfo = &specialization_info;
 
   shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -72,7 +91,7 @@ void vs_pipeline::create_graphics_pipeline(
   shader_stages[1].pName = "main";
   shader_stages[1].flags = 0;
   shader_stages[1].pNext = nullptr;
-  shader_stages[1].pSpecializationInfo = nullptr;
+  shader_stages[1].pSpecializationInfo = &specialization_info;
 
   auto &bindingDescription = config_info.binding_descriptions;
   auto &attributeDescription = config_info.attribute_descriptions;
@@ -107,22 +126,62 @@ void vs_pipeline::create_graphics_pipeline(
   pipeline_info.basePipelineIndex = -1;
   pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
+  const auto start = std::chrono::high_resolution_clock::now();
   VkResult result =
-      vkCreateGraphicsPipelines(device_.device(), VK_NULL_HANDLE, 1,
+      vkCreateGraphicsPipelines(device_.device(), device_.pipelineCache(), 1,
                                 &pipeline_info, nullptr, &graphics_pipeline_);
+  device_.addPipelineCreationTime(
+      std::chrono::duration<double, std::milli>(
+          std::chrono::high_resolution_clock::now() - start)
+          .count());
   if (result != VK_SUCCESS) {
     throw std::runtime_error("Failed to create graphics pipeline");
   }
 }
 
-void vs_pipeline::create_shader_module(const std::vector<char> &code,
+void vs_pipeline::create_compute_pipeline(const std::string &comp_path,
+                                          VkPipelineLayout pipeline_layout) {
+  assert(pipeline_layout != VK_NULL_HANDLE &&
+         "Cannot create compute pipeline:: no pipelineLayout provided");
+
+  create_shader_module(vs_shader_registry::get(comp_path),
+                       &comp_shader_module_);
+
+  VkPipelineShaderStageCreateInfo shader_stage{};
+  shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  shader_stage.module = comp_shader_module_;
+  shader_stage.pName = "main";
+  shader_stage.flags = 0;
+  shader_stage.pNext = nullptr;
+  shader_stage.pSpecializationInfo = nullptr;
+
+  VkComputePipelineCreateInfo pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage = shader_stage;
+  pipeline_info.layout = pipeline_layout;
+  pipeline_info.basePipelineIndex = -1;
+  pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+  const auto start = std::chrono::high_resolution_clock::now();
+  VkResult result =
+      vkCreateComputePipelines(device_.device(), device_.pipelineCache(), 1,
+                               &pipeline_info, nullptr, &graphics_pipeline_);
+  device_.addPipelineCreationTime(
+      std::chrono::duration<double, std::milli>(
+          std::chrono::high_resolution_clock::now() - start)
+          .count());
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create compute pipeline");
+  }
+}
+
+void vs_pipeline::create_shader_module(std::span<const uint32_t> code,
                                        VkShaderModule *shader_module) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  // this works because the char array is a vector with a standard allocator
-  // instead of c-style array.
-  createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+  createInfo.codeSize = code.size_bytes();
+  createInfo.pCode = code.data();
   if (vkCreateShaderModule(device_.device(), &createInfo, nullptr,
                            shader_module) != VK_SUCCESS) {
     throw std::runtime_error("failed to create shader module");
@@ -4,11 +4,31 @@
 #pragma once
 #include "vs_device.h"
 //std
+#include <span>
 #include <string>
 #include <vector>
 
 namespace vs
 {
+	// specialization constants of the model shaders, constant_id follows the member order. every
+	// permutation is its own pipeline, the driver drops the paths a permutation turns off.
+	struct shader_permutation
+	{
+		VkBool32 textured = VK_TRUE;        // 0, sample the material's texture, else its base color only
+		VkBool32 alpha_test = VK_FALSE;     // 1, discard texels below half alpha
+		VkBool32 vertex_colors = VK_TRUE;   // 2, read the color attribute, else white
+		VkBool32 shadows = VK_TRUE;         // 3, sample the shadow maps
+		uint32_t max_fragment_lights = 256; // 4, lights of a cluster shaded per fragment
+
+		// packs every constant, equal keys are the same permutation.
+		uint64_t key() const
+		{
+			return static_cast<uint64_t>(textured) | static_cast<uint64_t>(alpha_test) << 1 |
+				static_cast<uint64_t>(vertex_colors) << 2 | static_cast<uint64_t>(shadows) << 3 |
+				static_cast<uint64_t>(max_fragment_lights) << 32;
+		}
+	};
+
 	struct pipeline_config_info
 	{
 		pipeline_config_info() = default;
@@ -29,22 +49,38 @@ namespace vs
 		VkPipelineLayout pipeline_layout = nullptr;
 		VkRenderPass render_pass = nullptr;
 		uint32_t subpass = 0;
+		// given to every stage, shaders ignore the constants they don't declare.
+		shader_permutation permutation{};
 	};
 
 	class vs_pipeline
 	{
 	public:
+		// an empty frag_path makes a depth only pipeline, give it no color attachments.
 		vs_pipeline(vs_device& device,
 		            const std::string& vert_path,
 		            const std::string& frag_path,
 		            const pipeline_config_info& config);
 
+		// compute pipeline
+		vs_pipeline(vs_device& device,
+		            const std::string& comp_path,
+		            VkPipelineLayout pipeline_layout);
+
 		~vs_pipeline();
 
 		vs_pipeline(const vs_pipeline&) = delete;
 		vs_pipeline& operator=(const vs_pipeline&) = delete;
 
 		void bind(VkCommandBuffer command_buffer);
+		// compute pipelines only, bind it and its descriptor sets first.
+		void dispatch(VkCommandBuffer command_buffer, uint32_t group_count_x, uint32_t group_count_y = 1,
+		              uint32_t group_count_z = 1);
+		// work groups of group_size covering item_count items.
+		static uint32_t groupCount(uint32_t item_count, uint32_t group_size)
+		{
+			return (item_count + group_size - 1) / group_size;
+		}
 
 		static void
                 defaultPipelineConfigInfo(pipeline_config_info &config_info,
@@ -52,17 +88,19 @@ namespace vs
                                           bool enable_sample_shading);
 
 	private:
-		static std::vector<char> readFile(const std::string& path);
-
 		void create_graphics_pipeline(const std::string& vert_path,
 		                              const std::string& frag_path,
 		                              const pipeline_config_info& config_info);
 
-		void create_shader_module(const std::vector<char>& code, VkShaderModule* shader_module);
+		void create_compute_pipeline(const std::string& comp_path, VkPipelineLayout pipeline_layout);
+
+		void create_shader_module(std::span<const uint32_t> code, VkShaderModule* shader_module);
 
 		vs_device& device_;
+		VkPipelineBindPoint bind_point_ = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		VkPipeline graphics_pipeline_;
-		VkShaderModule vert_shader_module_;
-		VkShaderModule frag_shader_module_;
+		VkShaderModule vert_shader_module_ = VK_NULL_HANDLE;
+		VkShaderModule frag_shader_module_ = VK_NULL_HANDLE;
+		VkShaderModule comp_shader_module_ = VK_NULL_HANDLE;
 	};
 }
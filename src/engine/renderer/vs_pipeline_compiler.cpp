@@ -0,0 +1,148 @@
+#include "vs_pipeline_compiler.h"
+#include "vs_thread_pool.h"
+
+// std
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+
+namespace vs {
+// appends the bytes of a value, only for scalars and vulkan structs without
+// pointers or padding.
+template <typename T> static void appendBytes(std::string &key, const T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// every input of vkCreateGraphicsPipelines, the viewports and scissors only by
+// count since they are dynamic.
+static std::string variantKey(const std::string &vert_path,
+                              const std::string &frag_path,
+                              const pipeline_config_info &config) {
+  std::string key = vert_path + '|' + frag_path + '|';
+  appendBytes(key, config.render_pass);
+  appendBytes(key, config.subpass);
+  appendBytes(key, config.pipeline_layout);
+  appendBytes(key, config.permutation.key());
+
+  appendBytes(key, config.binding_descriptions.size());
+  for (const auto &binding : config.binding_descriptions) {
+    appendBytes(key, binding);
+  }
+  appendBytes(key, config.attribute_descriptions.size());
+  for (const auto &attribute : config.attribute_descriptions) {
+    appendBytes(key, attribute);
+  }
+
+  const auto &input_assembly = config.input_assembly_info;
+  appendBytes(key, input_assembly.topology);
+  appendBytes(key, input_assembly.primitiveRestartEnable);
+
+  appendBytes(key, config.viewport_info.viewportCount);
+  appendBytes(key, config.viewport_info.scissorCount);
+
+  const auto &rasterization = config.rasterization_info;
+  appendBytes(key, rasterization.depthClampEnable);
+  appendBytes(key, rasterization.rasterizerDiscardEnable);
+  appendBytes(key, rasterization.polygonMode);
+  appendBytes(key, rasterization.cullMode);
+  appendBytes(key, rasterization.frontFace);
+  appendBytes(key, rasterization.depthBiasEnable);
+  appendBytes(key, rasterization.depthBiasConstantFactor);
+  appendBytes(key, rasterization.depthBiasClamp);
+  appendBytes(key, rasterization.depthBiasSlopeFactor);
+  appendBytes(key, rasterization.lineWidth);
+
+  const auto &multisample = config.multisample_info;
+  appendBytes(key, multisample.rasterizationSamples);
+  appendBytes(key, multisample.sampleShadingEnable);
+  appendBytes(key, multisample.minSampleShading);
+  appendBytes(key, multisample.alphaToCoverageEnable);
+  appendBytes(key, multisample.alphaToOneEnable);
+  appendBytes(key, multisample.pSampleMask != nullptr);
+  if (multisample.pSampleMask != nullptr) {
+    const auto samples =
+        static_cast<uint32_t>(multisample.rasterizationSamples);
+    for (uint32_t i = 0; i < (samples + 31) / 32; ++i) {
+      appendBytes(key, multisample.pSampleMask[i]);
+    }
+  }
+
+  const auto &color_blend = config.color_blend_info;
+  appendBytes(key, color_blend.logicOpEnable);
+  appendBytes(key, color_blend.logicOp);
+  appendBytes(key, color_blend.attachmentCount);
+  for (uint32_t i = 0; i < color_blend.attachmentCount; ++i) {
+    appendBytes(key, color_blend.pAttachments[i]);
+  }
+  for (float constant : color_blend.blendConstants) {
+    appendBytes(key, constant);
+  }
+
+  const auto &depth_stencil = config.depth_stencil_info;
+  appendBytes(key, depth_stencil.depthTestEnable);
+  appendBytes(key, depth_stencil.depthWriteEnable);
+  appendBytes(key, depth_stencil.depthCompareOp);
+  appendBytes(key, depth_stencil.depthBoundsTestEnable);
+  appendBytes(key, depth_stencil.stencilTestEnable);
+  appendBytes(key, depth_stencil.front);
+  appendBytes(key, depth_stencil.back);
+  appendBytes(key, depth_stencil.minDepthBounds);
+  appendBytes(key, depth_stencil.maxDepthBounds);
+
+  const auto &dynamic_state = config.dynamic_state_info;
+  appendBytes(key, dynamic_state.dynamicStateCount);
+  for (uint32_t i = 0; i < dynamic_state.dynamicStateCount; ++i) {
+    appendBytes(key, dynamic_state.pDynamicStates[i]);
+  }
+  return key;
+}
+
+vs_pipeline *vs_pipeline_compiler::handle::get() const {
+  assert(isReady() && "pipeline used before vs_pipeline_compiler::compile");
+  return slot_->pipeline.get();
+}
+
+vs_pipeline_compiler::vs_pipeline_compiler(vs_device &device,
+                                           vs_thread_pool &thread_pool)
+    : device_(device), thread_pool_(thread_pool) {}
+
+vs_pipeline_compiler::handle
+vs_pipeline_compiler::submit(const std::string &vert_path,
+                             const std::string &frag_path,
+                             std::unique_ptr<pipeline_config_info> config) {
+  if (config == nullptr) {
+    throw std::runtime_error("pipeline submitted without a config");
+  }
+
+  const std::string variant = variantKey(vert_path, frag_path, *config);
+
+  handle result{};
+  auto it = variants_.find(variant);
+  if (it != variants_.end()) {
+    ++variant_hits_;
+    result.slot_ = it->second;
+    return result;
+  }
+
+  result.slot_ = std::make_shared<handle::slot>();
+  variants_.emplace(variant, result.slot_);
+  pending_.push_back({vert_path, frag_path, std::move(config), result.slot_});
+  return result;
+}
+
+void vs_pipeline_compiler::compile() {
+  if (pending_.empty())
+    return;
+
+  // every job writes only its own slot, nothing is shared but the device.
+  thread_pool_.parallelFor(
+      static_cast<uint32_t>(pending_.size()),
+      [this](uint32_t index, uint32_t) {
+        auto &request = pending_[index];
+        request.slot->pipeline = std::make_unique<vs_pipeline>(
+            device_, request.vert_path, request.frag_path, *request.config);
+      });
+  pending_.clear();
+}
+} // namespace vs
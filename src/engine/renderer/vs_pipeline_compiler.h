@@ -0,0 +1,75 @@
+#pragma once
+
+#include "vs_pipeline.h"
+
+// std
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vs {
+class vs_thread_pool;
+
+// Collects graphics pipelines from the render systems and creates them all at
+// once, spread over the workers of a thread pool. Render systems submit while
+// they are constructed and keep the returned handle in place of the pipeline,
+// compile() is called once every system exists. The driver side goes through
+// the pipeline cache of vs_device, which is safe to share between threads.
+// Pipelines are shared by variant: submitting the same shaders, permutation
+// and pipeline state again returns the first handle.
+class vs_pipeline_compiler {
+public:
+  // a pipeline that exists once compile() has returned.
+  class handle {
+  public:
+    handle() = default;
+
+    bool isReady() const { return slot_ && slot_->pipeline != nullptr; }
+    // only valid after compile(), safe to call from any thread then.
+    vs_pipeline *get() const;
+    vs_pipeline *operator->() const { return get(); }
+
+  private:
+    friend class vs_pipeline_compiler;
+    struct slot {
+      std::unique_ptr<vs_pipeline> pipeline;
+    };
+    std::shared_ptr<slot> slot_;
+  };
+
+  vs_pipeline_compiler(vs_device &device, vs_thread_pool &thread_pool);
+
+  vs_pipeline_compiler(const vs_pipeline_compiler &) = delete;
+  vs_pipeline_compiler &operator=(const vs_pipeline_compiler &) = delete;
+
+  // takes the config, its create infos point into itself so it stays on the
+  // heap until the pipeline is created. an empty frag_path is depth only.
+  handle submit(const std::string &vert_path, const std::string &frag_path,
+                std::unique_ptr<pipeline_config_info> config);
+
+  // creates everything submitted so far and returns when all of it exists,
+  // the first failure is rethrown here.
+  void compile();
+
+  uint32_t getPendingCount() const {
+    return static_cast<uint32_t>(pending_.size());
+  }
+  // submissions answered with an existing variant.
+  uint32_t getVariantHits() const { return variant_hits_; }
+
+private:
+  struct request {
+    std::string vert_path;
+    std::string frag_path;
+    std::unique_ptr<pipeline_config_info> config;
+    std::shared_ptr<handle::slot> slot;
+  };
+
+  vs_device &device_;
+  vs_thread_pool &thread_pool_;
+  std::vector<request> pending_;
+  std::unordered_map<std::string, std::shared_ptr<handle::slot>> variants_;
+  uint32_t variant_hits_ = 0;
+};
+} // namespace vs
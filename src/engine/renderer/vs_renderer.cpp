@@ -5,15 +5,25 @@
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 namespace vs {
-vs_renderer::vs_renderer(vs_window &window, vs_device &device)
-    : window_(window), device_(device) {
+vs_renderer::vs_renderer(vs_window &window, vs_device &device,
+                         VkDeviceSize uniform_size, int frames_in_flight)
+    : window_(window), device_(device), frames_in_flight_(frames_in_flight) {
+  if (frames_in_flight_ < 1 ||
+      frames_in_flight_ > vs_swap_chain::MAX_FRAMES_IN_FLIGHT) {
+    throw std::runtime_error("frames in flight must be 1 to " +
+                             std::to_string(vs_swap_chain::MAX_FRAMES_IN_FLIGHT));
+  }
   recreateSwapChain();
-  createCommandBuffers();
+  createFrameContexts(uniform_size);
 }
 
-vs_renderer::~vs_renderer() { freeCommandBuffers(); }
+vs_renderer::~vs_renderer() {
+  // the contexts destroy fences and command buffers the gpu may still use.
+  vkDeviceWaitIdle(device_.device());
+}
 
 void vs_renderer::recreateSwapChain() {
   auto extent = window_.getExtent();
@@ -24,11 +34,12 @@ void vs_renderer::recreateSwapChain() {
   vkDeviceWaitIdle(device_.device());
 
   if (swap_chain_ == nullptr) {
-    swap_chain_ = std::make_unique<vs_swap_chain>(device_, extent);
+    swap_chain_ =
+        std::make_unique<vs_swap_chain>(device_, extent, frames_in_flight_);
   } else {
     std::shared_ptr<vs_swap_chain> old_swap_chain = std::move(swap_chain_);
-    swap_chain_ =
-        std::make_unique<vs_swap_chain>(device_, extent, old_swap_chain);
+    swap_chain_ = std::make_unique<vs_swap_chain>(
+        device_, extent, frames_in_flight_, old_swap_chain);
 
     if (!old_swap_chain->compareSwapFormats(*swap_chain_.get())) {
       throw std::runtime_error("swapchains have non matching formats");
@@ -36,33 +47,24 @@ void vs_renderer::recreateSwapChain() {
   }
 }
 
-void vs_renderer::createCommandBuffers() {
-  command_buffers_.resize(vs_swap_chain::MAX_FRAMES_IN_FLIGHT);
-
-  VkCommandBufferAllocateInfo alloc_info{};
-  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  alloc_info.commandPool = device_.getCommandPool();
-  alloc_info.commandBufferCount =
-      static_cast<uint32_t>(command_buffers_.size());
-
-  if (vkAllocateCommandBuffers(device_.device(), &alloc_info,
-                               command_buffers_.data()) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers");
+void vs_renderer::createFrameContexts(VkDeviceSize uniform_size) {
+  frames_.resize(frames_in_flight_);
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    frames_[i] = std::make_unique<vs_frame_context>(
+        device_, static_cast<int>(i), uniform_size);
   }
 }
 
-void vs_renderer::freeCommandBuffers() {
-  vkFreeCommandBuffers(device_.device(), device_.getCommandPool(),
-                       static_cast<uint32_t>(command_buffers_.size()),
-                       command_buffers_.data());
-  command_buffers_.clear();
-}
-
 VkCommandBuffer vs_renderer::beginFrame() {
   assert(!isFrameStarted && "can't call beginFrame while already in progress");
 
-  auto result = swap_chain_->acquireNextImage(&currentImageIndex);
+  // the only place the cpu waits for the gpu, it stays
+  // frames_in_flight_ - 1 frames ahead.
+  auto &frame = *frames_[currentFrameIndex];
+  frame.wait();
+
+  auto result =
+      swap_chain_->acquireNextImage(currentFrameIndex, &currentImageIndex);
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
     recreateSwapChain();
     return nullptr;
@@ -73,9 +75,10 @@ VkCommandBuffer vs_renderer::beginFrame() {
 
   isFrameStarted = true;
 
-  auto command_buffer = getCurrentCommandBuffer();
+  auto command_buffer = frame.getCommandBuffer();
   VkCommandBufferBeginInfo begin_info{};
   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
   if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
@@ -93,8 +96,9 @@ void vs_renderer::endFrame() {
     throw std::runtime_error("failed to end recording cmd buffer");
   }
 
-  auto result =
-      swap_chain_->submitCommandBuffers(&command_buffer, &currentImageIndex);
+  auto result = swap_chain_->submitCommandBuffers(
+      &command_buffer, &currentImageIndex, currentFrameIndex,
+      frames_[currentFrameIndex]->getFence());
   if (result == VK_ERROR_OUT_OF_DATE_KHR || window_.wasFrameBufferResized() || result == VK_SUBOPTIMAL_KHR) {
     window_.resetFrameBufferResizedFlag();
     recreateSwapChain();
@@ -104,45 +108,81 @@ void vs_renderer::endFrame() {
   }
 
   isFrameStarted = false;
-  currentFrameIndex =
-      (currentFrameIndex + 1) % vs_swap_chain::MAX_FRAMES_IN_FLIGHT;
+  currentFrameIndex = (currentFrameIndex + 1) % frames_in_flight_;
 }
 
-void vs_renderer::beginSwapChainRenderPass(VkCommandBuffer cmdBuffer) {
+void vs_renderer::beginSwapChainRenderPass(VkCommandBuffer cmdBuffer,
+                                           bool load_contents) {
+  beginRenderPass(cmdBuffer, load_contents, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{
+      0.0f,
+      0.0f,
+      static_cast<float>(swap_chain_->getSwapChainExtent().width),
+      static_cast<float>(swap_chain_->getSwapChainExtent().height),
+      0.0f,
+      1.0f};
+  VkRect2D scissor{{0, 0}, swap_chain_->getSwapChainExtent()};
+  vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+}
+
+void vs_renderer::beginSwapChainRenderPass(
+    VkCommandBuffer cmdBuffer, const std::vector<VkCommandBuffer> &secondaries,
+    bool load_contents) {
+  beginRenderPass(cmdBuffer, load_contents,
+                  VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  if (!secondaries.empty()) {
+    vkCmdExecuteCommands(cmdBuffer, static_cast<uint32_t>(secondaries.size()),
+                         secondaries.data());
+  }
+}
+
+void vs_renderer::beginRenderPass(VkCommandBuffer cmdBuffer,
+                                  bool load_contents,
+                                  VkSubpassContents contents) {
   assert(isFrameStarted &&
          "Cannot begin render pass when frame is in progress");
   assert(cmdBuffer == getCurrentCommandBuffer() &&
          "can't begin render pass on command buffer from a different frame");
 
+  const bool deferred = render_path_ == render_path::deferred;
+
   VkRenderPassBeginInfo render_pass_begin_info{};
   render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  render_pass_begin_info.renderPass = swap_chain_->getRenderPass();
-  render_pass_begin_info.framebuffer =
-      swap_chain_->getFrameBuffer(currentImageIndex);
+  if (deferred) {
+    render_pass_begin_info.renderPass =
+        load_contents ? swap_chain_->getDeferredLoadRenderPass()
+                      : swap_chain_->getDeferredRenderPass();
+    render_pass_begin_info.framebuffer =
+        swap_chain_->getDeferredFrameBuffer(currentImageIndex);
+  } else {
+    render_pass_begin_info.renderPass = load_contents
+                                            ? swap_chain_->getLoadRenderPass()
+                                            : swap_chain_->getRenderPass();
+    render_pass_begin_info.framebuffer =
+        swap_chain_->getFrameBuffer(currentImageIndex);
+  }
 
   render_pass_begin_info.renderArea.offset = {0, 0};
   render_pass_begin_info.renderArea.extent = swap_chain_->getSwapChainExtent();
 
-  std::array<VkClearValue, 2> clear_values{};
+  // the g-buffer is cleared to black albedo, its depth decides what is lit.
+  std::array<VkClearValue, 5> clear_values{};
   clear_values[0].color = {{0.01f, 0.01f, 0.01f, 1.0f}};
   clear_values[1].depthStencil = {1.0f, 0};
-  render_pass_begin_info.clearValueCount =
-      static_cast<uint32_t>(clear_values.size());
+  clear_values[3].color = {{0.f, 0.f, 0.f, 0.f}};
+  clear_values[4].color = {{0.f, 0.f, 0.f, 0.f}};
+  render_pass_begin_info.clearValueCount = deferred ? 5 : 2;
   render_pass_begin_info.pClearValues = clear_values.data();
 
-  vkCmdBeginRenderPass(cmdBuffer, &render_pass_begin_info,
-                       VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(cmdBuffer, &render_pass_begin_info, contents);
+}
 
-  VkViewport viewport{
-      0.0f,
-      0.0f,
-      static_cast<float>(swap_chain_->getSwapChainExtent().width),
-      static_cast<float>(swap_chain_->getSwapChainExtent().height),
-      0.0f,
-      1.0f};
-  VkRect2D scissor{{0, 0}, swap_chain_->getSwapChainExtent()};
-  vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-  vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+void vs_renderer::nextSubpass(VkCommandBuffer cmdBuffer) {
+  assert(render_path_ == render_path::deferred &&
+         "only the deferred render pass has a second subpass");
+  vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
 }
 
 void vs_renderer::endSwapChainRenderPass(VkCommandBuffer cmdBuffer) {
@@ -5,13 +5,17 @@
 #include <vector>
 
 #include "vs_device.h"
+#include "vs_frame_context.h"
 #include "vs_swap_chain.h"
 #include "vs_window.h"
 
 namespace vs {
 class vs_renderer {
 public:
-  vs_renderer(vs_window &window, vs_device &device);
+  // uniform_size is the size of the uniform slice of every frame context,
+  // frames_in_flight 1 to vs_swap_chain::MAX_FRAMES_IN_FLIGHT.
+  vs_renderer(vs_window &window, vs_device &device, VkDeviceSize uniform_size,
+              int frames_in_flight = vs_swap_chain::DEFAULT_FRAMES_IN_FLIGHT);
   ~vs_renderer();
 
   vs_renderer(const vs_renderer &) = delete;
@@ -20,7 +24,12 @@ public:
   VkRenderPass getSwapChainRenderPass() const {
     return swap_chain_->getRenderPass();
   }
+  VkRenderPass getDeferredRenderPass() const {
+    return swap_chain_->getDeferredRenderPass();
+  }
   float getAspectRatio() const { return swap_chain_->extentAspectRatio(); }
+  // every per frame resource of the render systems is sized by this.
+  int getFramesInFlight() const { return frames_in_flight_; }
   bool isFrameInProgress() const { return isFrameStarted; }
 
   vs_swap_chain *getSwapChain() { return swap_chain_.get(); }
@@ -28,14 +37,42 @@ public:
   VkCommandBuffer getCurrentCommandBuffer() const {
     assert(isFrameStarted &&
            "Cannot get command buffer when frame not in progress");
-    return command_buffers_[currentFrameIndex];
+    return frames_[currentFrameIndex]->getCommandBuffer();
+  }
+
+  vs_frame_context &getCurrentFrame() {
+    assert(isFrameStarted && "Cannot get frame when frame not in progress");
+    return *frames_[currentFrameIndex];
   }
+  // for setting up per frame resources before the first frame.
+  vs_frame_context &getFrame(int index) { return *frames_[index]; }
 
   VkCommandBuffer beginFrame();
   void endFrame();
-  void beginSwapChainRenderPass(VkCommandBuffer cmdBuffer);
+  // load_contents continues on top of what an earlier pass of this frame
+  // drew instead of clearing.
+  void beginSwapChainRenderPass(VkCommandBuffer cmdBuffer,
+                                bool load_contents = false);
+  // begins the render pass and executes the secondaries in order, nothing
+  // else can be recorded into the pass.
+  void beginSwapChainRenderPass(VkCommandBuffer cmdBuffer,
+                                const std::vector<VkCommandBuffer> &secondaries,
+                                bool load_contents = false);
   void endSwapChainRenderPass(VkCommandBuffer cmdBuffer);
 
+  // picks the render pass the next beginSwapChainRenderPass() begins, the
+  // deferred one has a g-buffer and a lighting subpass.
+  void setRenderPath(render_path path) { render_path_ = path; }
+  render_path getRenderPath() const { return render_path_; }
+  // moves a deferred pass from the g-buffer to the lighting subpass.
+  void nextSubpass(VkCommandBuffer cmdBuffer);
+
+  uint32_t getImageIndex() const {
+    assert(isFrameStarted &&
+           "Cannot get image index when frame not in progress");
+    return currentImageIndex;
+  }
+
   int getFrameIndex() const {
     assert(isFrameStarted &&
            "Cannot get frame index when frame not in progress");
@@ -43,18 +80,21 @@ public:
   }
 
 private:
-  void createCommandBuffers();
-  void freeCommandBuffers();
+  void createFrameContexts(VkDeviceSize uniform_size);
   void recreateSwapChain();
+  void beginRenderPass(VkCommandBuffer cmdBuffer, bool load_contents,
+                       VkSubpassContents contents);
 
   vs_window &window_;
   vs_device &device_;
+  int frames_in_flight_;
   std::unique_ptr<vs_swap_chain> swap_chain_;
-  std::vector<VkCommandBuffer> command_buffers_;
+  std::vector<std::unique_ptr<vs_frame_context>> frames_;
 
   uint32_t currentImageIndex{0};
   int currentFrameIndex{0};
 
   bool isFrameStarted = false;
+  render_path render_path_ = render_path::forward;
 };
 } // namespace vs
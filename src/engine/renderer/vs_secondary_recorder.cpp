@@ -0,0 +1,117 @@
+#include "vs_secondary_recorder.h"
+#include "vs_thread_pool.h"
+
+// std
+#include <stdexcept>
+
+namespace vs {
+vs_secondary_recorder::vs_secondary_recorder(vs_device &device,
+                                             int frames_in_flight,
+                                             vs_thread_pool &thread_pool)
+    : device_(device), thread_pool_(thread_pool) {
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex =
+      device_.findPhysicalQueueFamilies().graphicsFamily;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  pools_.resize(frames_in_flight);
+  for (auto &frame_pools : pools_) {
+    frame_pools.resize(thread_pool_.getThreadCount());
+    for (auto &pool : frame_pools) {
+      if (vkCreateCommandPool(device_.device(), &pool_info, nullptr,
+                              &pool.command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create secondary command pool");
+      }
+    }
+  }
+}
+
+vs_secondary_recorder::~vs_secondary_recorder() {
+  for (auto &frame_pools : pools_) {
+    for (auto &pool : frame_pools) {
+      // frees the command buffers as well.
+      vkDestroyCommandPool(device_.device(), pool.command_pool, nullptr);
+    }
+  }
+}
+
+uint32_t vs_secondary_recorder::getThreadCount() const {
+  return thread_pool_.getThreadCount();
+}
+
+void vs_secondary_recorder::beginFrame(int frame_index) {
+  frame_index_ = frame_index;
+  for (auto &pool : pools_[frame_index_]) {
+    if (pool.used == 0)
+      continue;
+    vkResetCommandPool(device_.device(), pool.command_pool, 0);
+    pool.used = 0;
+  }
+}
+
+VkCommandBuffer vs_secondary_recorder::acquire(worker_pool &pool) {
+  if (pool.used == pool.command_buffers.size()) {
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandPool = pool.command_pool;
+    alloc_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer;
+    if (vkAllocateCommandBuffers(device_.device(), &alloc_info,
+                                 &command_buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate secondary command buffer");
+    }
+    pool.command_buffers.push_back(command_buffer);
+  }
+  return pool.command_buffers[pool.used++];
+}
+
+const std::vector<VkCommandBuffer> &
+vs_secondary_recorder::record(uint32_t job_count,
+                              const secondary_target &target,
+                              const record_function &record_job) {
+  recorded_.assign(job_count, VK_NULL_HANDLE);
+
+  thread_pool_.parallelFor(job_count, [&](uint32_t job, uint32_t worker) {
+    VkCommandBuffer command_buffer = acquire(pools_[frame_index_][worker]);
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = target.render_pass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = target.framebuffer;
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                       VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin secondary command buffer");
+    }
+
+    // dynamic state is not inherited from the primary.
+    VkViewport viewport{0.0f,
+                        0.0f,
+                        static_cast<float>(target.extent.width),
+                        static_cast<float>(target.extent.height),
+                        0.0f,
+                        1.0f};
+    VkRect2D scissor{{0, 0}, target.extent};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    record_job(command_buffer, job);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to end secondary command buffer");
+    }
+    recorded_[job] = command_buffer;
+  });
+
+  return recorded_;
+}
+} // namespace vs
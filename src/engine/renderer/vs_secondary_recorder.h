@@ -0,0 +1,64 @@
+#pragma once
+
+#include "vs_device.h"
+
+// std
+#include <functional>
+#include <vector>
+
+namespace vs {
+class vs_thread_pool;
+
+// render pass the secondaries are recorded for.
+struct secondary_target {
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  VkFramebuffer framebuffer = VK_NULL_HANDLE;
+  VkExtent2D extent{0, 0};
+};
+
+// Records secondary command buffers on the worker threads of a thread pool.
+// Every worker owns one command pool per frame in flight, so recording needs
+// no locking and a frame's buffers are recycled with a single pool reset.
+class vs_secondary_recorder {
+public:
+  using record_function =
+      std::function<void(VkCommandBuffer command_buffer, uint32_t job)>;
+
+  vs_secondary_recorder(vs_device &device, int frames_in_flight,
+                        vs_thread_pool &thread_pool);
+  ~vs_secondary_recorder();
+
+  vs_secondary_recorder(const vs_secondary_recorder &) = delete;
+  vs_secondary_recorder &operator=(const vs_secondary_recorder &) = delete;
+
+  // recycles what was recorded for frame_index last time, call once the
+  // frame's fence has been waited on.
+  void beginFrame(int frame_index);
+
+  // records one secondary per job in parallel, viewport and scissor are set
+  // to the target extent. The buffers are returned in job order and stay
+  // valid until the next call.
+  const std::vector<VkCommandBuffer> &record(uint32_t job_count,
+                                             const secondary_target &target,
+                                             const record_function &record_job);
+
+  uint32_t getThreadCount() const;
+
+private:
+  struct worker_pool {
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> command_buffers;
+    uint32_t used = 0;
+  };
+
+  VkCommandBuffer acquire(worker_pool &pool);
+
+  vs_device &device_;
+  vs_thread_pool &thread_pool_;
+
+  // [frame in flight][worker]
+  std::vector<std::vector<worker_pool>> pools_;
+  int frame_index_ = 0;
+  std::vector<VkCommandBuffer> recorded_;
+};
+} // namespace vs
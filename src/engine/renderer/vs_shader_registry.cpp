@@ -0,0 +1,55 @@
+#include "vs_shader_registry.h"
+
+#ifdef VS_SHADERS_FROM_DISK
+// std
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#else
+#include "vs_embedded_shaders.h"
+#endif
+
+// std
+#include <stdexcept>
+
+namespace vs {
+#ifdef VS_SHADERS_FROM_DISK
+std::span<const uint32_t> vs_shader_registry::get(const std::string &name) {
+  // loaded files are kept, the pipelines of one shader share its words.
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::unique_ptr<std::vector<uint32_t>>>
+      loaded;
+
+  std::lock_guard<std::mutex> lock{mutex};
+  auto it = loaded.find(name);
+  if (it == loaded.end()) {
+    std::ifstream file(name, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("failed to open file: " + name);
+    }
+    const size_t file_size = static_cast<size_t>(file.tellg());
+    if (file_size % sizeof(uint32_t) != 0) {
+      throw std::runtime_error("not a spir-v file: " + name);
+    }
+    auto words =
+        std::make_unique<std::vector<uint32_t>>(file_size / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(words->data()), file_size);
+    it = loaded.emplace(name, std::move(words)).first;
+  }
+  return *it->second;
+}
+#else
+std::span<const uint32_t> vs_shader_registry::get(const std::string &name) {
+  // a handful of shaders, a linear search costs nothing next to the driver.
+  for (const auto &entry : embedded_shaders::registry) {
+    if (entry.name == name) {
+      return {entry.words, entry.word_count};
+    }
+  }
+  throw std::runtime_error("shader not embedded: " + name);
+}
+#endif
+} // namespace vs
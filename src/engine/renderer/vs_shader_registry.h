@@ -0,0 +1,19 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace vs {
+// SPIR-V of every shader, compiled and embedded into the executable by the
+// build, looked up by the path the pipelines name, e.g.
+// "shaders/simple_shader.vert.spv". Built with VS_SHADERS_FROM_DISK the path
+// is loaded relative to the working directory instead, once per shader.
+class vs_shader_registry {
+public:
+  // the words stay valid for the lifetime of the program, throws when the
+  // shader doesn't exist. safe to call from any thread.
+  static std::span<const uint32_t> get(const std::string &name);
+};
+} // namespace vs
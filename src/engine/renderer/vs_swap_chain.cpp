@@ -1,6 +1,7 @@
 #include "vs_swap_chain.h"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <iostream>
@@ -12,21 +13,27 @@
 #include "stb_image.h"
 
 namespace vs {
-vs_swap_chain::vs_swap_chain(vs_device &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+static uint64_t next_swap_chain_id = 0;
+
+vs_swap_chain::vs_swap_chain(vs_device &deviceRef, VkExtent2D extent,
+                             int frames_in_flight)
+    : device{deviceRef}, windowExtent{extent},
+      frames_in_flight_{frames_in_flight} {
   init();
 }
 
 vs_swap_chain::vs_swap_chain(vs_device &deviceRef, VkExtent2D extent,
+                             int frames_in_flight,
                              std::shared_ptr<vs_swap_chain> previous_swap_chain)
     : device{deviceRef}, windowExtent{extent},
-      old_swap_chain(previous_swap_chain) {
+      frames_in_flight_{frames_in_flight}, old_swap_chain(previous_swap_chain) {
   init();
   // clean out old swapchain since we don't need it after init.
   old_swap_chain = nullptr;
 }
 
 void vs_swap_chain::init() {
+  id_ = next_swap_chain_id++;
   createSwapChain();
   createTextureImage("models/textures/viking_room.png");
   createTextureImageView();
@@ -35,6 +42,7 @@ void vs_swap_chain::init() {
   createRenderPass();
   createColorResources();
   createDepthResources();
+  createGBufferResources();
   createFramebuffers();
   createSyncObjects();
 }
@@ -60,6 +68,12 @@ vs_swap_chain::~vs_swap_chain() {
   vkDestroyImage(device.device(), colorImage, nullptr);
   vkFreeMemory(device.device(), colorImageMemory, nullptr);
   // end msaa
+  vkDestroyImageView(device.device(), gbufferAlbedoView, nullptr);
+  vkDestroyImage(device.device(), gbufferAlbedoImage, nullptr);
+  vkFreeMemory(device.device(), gbufferAlbedoMemory, nullptr);
+  vkDestroyImageView(device.device(), gbufferNormalView, nullptr);
+  vkDestroyImage(device.device(), gbufferNormalImage, nullptr);
+  vkFreeMemory(device.device(), gbufferNormalMemory, nullptr);
   if (swapChain != nullptr) {
     vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
     swapChain = nullptr;
@@ -74,42 +88,48 @@ vs_swap_chain::~vs_swap_chain() {
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
   }
+  for (auto framebuffer : deferredFramebuffers) {
+    vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+  }
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  vkDestroyRenderPass(device.device(), loadRenderPass, nullptr);
+  vkDestroyRenderPass(device.device(), deferredRenderPass, nullptr);
+  vkDestroyRenderPass(device.device(), deferredLoadRenderPass, nullptr);
 
   // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < renderFinishedSemaphores.size(); i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
   }
 }
 
-VkResult vs_swap_chain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE,
-                  std::numeric_limits<uint64_t>::max());
-
+VkResult vs_swap_chain::acquireNextImage(int frame_index,
+                                         uint32_t *imageIndex) {
   VkResult result = vkAcquireNextImageKHR(
       device.device(), swapChain, std::numeric_limits<uint64_t>::max(),
-      imageAvailableSemaphores[currentFrame], // must be a not signaled
-                                              // semaphore
+      imageAvailableSemaphores[frame_index], // must be a not signaled
+                                             // semaphore
       VK_NULL_HANDLE, imageIndex);
 
   return result;
 }
 
 VkResult vs_swap_chain::submitCommandBuffers(const VkCommandBuffer *buffers,
-                                             uint32_t *imageIndex) {
+                                             uint32_t *imageIndex,
+                                             int frame_index, VkFence fence) {
+  // with more images than frames in flight an image can come back while the
+  // frame that last rendered to it is still running.
   if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
     vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE,
                     UINT64_MAX);
   }
-  imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+  imagesInFlight[*imageIndex] = fence;
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[frame_index]};
   VkPipelineStageFlags waitStages[] = {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   submitInfo.waitSemaphoreCount = 1;
@@ -119,13 +139,12 @@ VkResult vs_swap_chain::submitCommandBuffers(const VkCommandBuffer *buffers,
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = buffers;
 
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[frame_index]};
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo,
-                    inFlightFences[currentFrame]) != VK_SUCCESS) {
+  vkResetFences(device.device(), 1, &fence);
+  if (device.submitGraphics(submitInfo, fence) != VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
 
@@ -141,11 +160,7 @@ VkResult vs_swap_chain::submitCommandBuffers(const VkCommandBuffer *buffers,
 
   presentInfo.pImageIndices = imageIndex;
 
-  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
-
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-
-  return result;
+  return vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 }
 
 void vs_swap_chain::createSwapChain() {
@@ -157,7 +172,9 @@ void vs_swap_chain::createSwapChain() {
       chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+  uint32_t imageCount =
+      std::max(swapChainSupport.capabilities.minImageCount + 1,
+               static_cast<uint32_t>(frames_in_flight_));
   if (swapChainSupport.capabilities.maxImageCount > 0 &&
       imageCount > swapChainSupport.capabilities.maxImageCount) {
     imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -301,6 +318,9 @@ void vs_swap_chain::createTextureImage(const std::string &path) {
   vkUnmapMemory(device.device(), stagingBufferMemory);
   stbi_image_free(pixels);
 
+  // upload, layout transitions and mip blits go out in a single submission.
+  vs_transfer_batch transfer_batch{device};
+
   createImage(texWidth, texHeight, mip_levels, VK_SAMPLE_COUNT_1_BIT,
               VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
               VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
@@ -317,12 +337,15 @@ void vs_swap_chain::createTextureImage(const std::string &path) {
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
      mip_levels);*/
-  vkDestroyBuffer(device.device(), stagingBuffer, nullptr);
-  vkFreeMemory(device.device(), stagingBufferMemory, nullptr);
+  VkDevice vk_device = device.device();
+  device.releaseAfterTransfer([vk_device, stagingBuffer, stagingBufferMemory] {
+    vkDestroyBuffer(vk_device, stagingBuffer, nullptr);
+    vkFreeMemory(vk_device, stagingBufferMemory, nullptr);
+  });
 
   generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight,
                   mip_levels);
-
+  transfer_batch.submit();
 }
 void vs_swap_chain::generateMipmaps(VkImage image, VkFormat image_format,
                                     int32_t texWidth, int32_t texHeight,
@@ -444,25 +467,38 @@ void vs_swap_chain::createImage(uint32_t width, uint32_t height,
 }
 
 void vs_swap_chain::createRenderPass() {
+  renderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR);
+  loadRenderPass = createRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+  deferredRenderPass = createDeferredRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR);
+  deferredLoadRenderPass = createDeferredRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+}
+
+VkRenderPass vs_swap_chain::createRenderPass(VkAttachmentLoadOp load_op) {
+  const bool load = load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
 
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format = getSwapChainImageFormat();
   colorAttachment.samples = device.msaa_samples;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.loadOp = load_op;
   colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.initialLayout =
+      load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+           : VK_IMAGE_LAYOUT_UNDEFINED;
   colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+  // depth is stored so it can be reduced into the hi-z pyramid.
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = findDepthFormat();
   depthAttachment.samples = device.msaa_samples;
-  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.loadOp = load_op;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.initialLayout =
+      load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+           : VK_IMAGE_LAYOUT_UNDEFINED;
   depthAttachment.finalLayout =
       VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -505,6 +541,14 @@ void vs_swap_chain::createRenderPass() {
                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
                              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  if (load) {
+    // the loaded contents were written by the previous pass.
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  }
 
   std::array<VkAttachmentDescription, 3> attachments = {
       colorAttachment, depthAttachment, colorAttachmentResolve};
@@ -517,10 +561,147 @@ void vs_swap_chain::createRenderPass() {
   renderPassInfo.dependencyCount = 1;
   renderPassInfo.pDependencies = &dependency;
 
+  VkRenderPass render_pass;
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr,
-                         &renderPass) != VK_SUCCESS) {
+                         &render_pass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
+  return render_pass;
+}
+
+VkRenderPass
+vs_swap_chain::createDeferredRenderPass(VkAttachmentLoadOp load_op) {
+  const bool load = load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+
+  // same first three attachments as the forward pass, so the depth images
+  // and the hi-z pyramid built from them are shared by both paths.
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = getSwapChainImageFormat();
+  colorAttachment.samples = device.msaa_samples;
+  colorAttachment.loadOp = load_op;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout =
+      load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+           : VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = findDepthFormat();
+  depthAttachment.samples = device.msaa_samples;
+  depthAttachment.loadOp = load_op;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout =
+      load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+           : VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription colorAttachmentResolve{};
+  colorAttachmentResolve.format = getSwapChainImageFormat();
+  colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  // stored because the gpu driven path ends the pass after the first culling
+  // phase and continues the g-buffer in a second one.
+  VkAttachmentDescription albedoAttachment = colorAttachment;
+  albedoAttachment.format = GBUFFER_ALBEDO_FORMAT;
+  VkAttachmentDescription normalAttachment = colorAttachment;
+  normalAttachment.format = GBUFFER_NORMAL_FORMAT;
+
+  std::array<VkAttachmentReference, 2> gbufferRefs{};
+  gbufferRefs[0] = {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  gbufferRefs[1] = {4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthAttachmentRef{
+      1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  std::array<VkAttachmentReference, 3> inputRefs{};
+  inputRefs[0] = {3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  inputRefs[1] = {4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  inputRefs[2] = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  VkAttachmentReference colorAttachmentRef{
+      0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference colorAttachmentResolveRef{
+      2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference readOnlyDepthRef{
+      1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+  std::array<VkSubpassDescription, 2> subpasses{};
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].colorAttachmentCount =
+      static_cast<uint32_t>(gbufferRefs.size());
+  subpasses[0].pColorAttachments = gbufferRefs.data();
+  subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+
+  // lighting, then the forward drawn billboards and transparents on top.
+  subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[1].inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+  subpasses[1].pInputAttachments = inputRefs.data();
+  subpasses[1].colorAttachmentCount = 1;
+  subpasses[1].pColorAttachments = &colorAttachmentRef;
+  subpasses[1].pResolveAttachments = &colorAttachmentResolveRef;
+  subpasses[1].pDepthStencilAttachment = &readOnlyDepthRef;
+
+  std::array<VkSubpassDependency, 2> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  if (load) {
+    // the loaded contents were written by the previous pass.
+    dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask |=
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  }
+
+  // every sample only reads its own g-buffer texel, so by region is enough.
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = 1;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  std::array<VkAttachmentDescription, 5> attachments = {
+      colorAttachment, depthAttachment, colorAttachmentResolve,
+      albedoAttachment, normalAttachment};
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  VkRenderPass render_pass;
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr,
+                         &render_pass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create deferred render pass!");
+  }
+  return render_pass;
 }
 
 void vs_swap_chain::createFramebuffers() {
@@ -544,6 +725,27 @@ void vs_swap_chain::createFramebuffers() {
       throw std::runtime_error("failed to create framebuffer!");
     }
   }
+
+  deferredFramebuffers.resize(imageCount());
+  for (size_t i = 0; i < imageCount(); i++) {
+    std::array<VkImageView, 5> attachments = {
+        colorImageView, depthImageViews[i], swapChainImageViews[i],
+        gbufferAlbedoView, gbufferNormalView};
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = deferredRenderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = width();
+    framebufferInfo.height = height();
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr,
+                            &deferredFramebuffers[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create deferred framebuffer!");
+    }
+  }
 }
 
 void vs_swap_chain::createDepthResources() {
@@ -577,7 +779,9 @@ void vs_swap_chain::createDepthResources() {
     */
     createImage(width(), height(), 1, device.msaa_samples, depthFormat,
                 VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT |
+                    VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i],
                 depthImageMemorys[i]);
 
@@ -601,25 +805,18 @@ void vs_swap_chain::createDepthResources() {
 }
 
 void vs_swap_chain::createSyncObjects() {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  imageAvailableSemaphores.resize(frames_in_flight_);
+  renderFinishedSemaphores.resize(frames_in_flight_);
   imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo = {};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr,
                           &imageAvailableSemaphores[i]) != VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr,
-                          &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(device.device(), &fenceInfo, nullptr,
-                      &inFlightFences[i]) != VK_SUCCESS) {
+                          &renderFinishedSemaphores[i]) != VK_SUCCESS) {
       throw std::runtime_error(
           "failed to create synchronization objects for a frame!");
     }
@@ -692,7 +889,9 @@ VkFormat vs_swap_chain::findDepthFormat() {
   return device.findSupportedFormat(
       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
        VK_FORMAT_D24_UNORM_S8_UINT},
-      VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 void vs_swap_chain::createColorResources() {
   VkFormat colorFormat = swapChainImageFormat;
@@ -707,4 +906,24 @@ void vs_swap_chain::createColorResources() {
       createImageView(colorImage, VK_IMAGE_ASPECT_COLOR_BIT, colorFormat, 1);
 }
 
+void vs_swap_chain::createGBufferResources() {
+  // shared by all frames like the msaa color image, the render passes of
+  // consecutive frames are ordered by their attachment dependencies.
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  createImage(width(), height(), 1, device.msaa_samples,
+              GBUFFER_ALBEDO_FORMAT, VK_IMAGE_TILING_OPTIMAL, usage,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gbufferAlbedoImage,
+              gbufferAlbedoMemory);
+  gbufferAlbedoView = createImageView(
+      gbufferAlbedoImage, VK_IMAGE_ASPECT_COLOR_BIT, GBUFFER_ALBEDO_FORMAT, 1);
+
+  createImage(width(), height(), 1, device.msaa_samples,
+              GBUFFER_NORMAL_FORMAT, VK_IMAGE_TILING_OPTIMAL, usage,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gbufferNormalImage,
+              gbufferNormalMemory);
+  gbufferNormalView = createImageView(
+      gbufferNormalImage, VK_IMAGE_ASPECT_COLOR_BIT, GBUFFER_NORMAL_FORMAT, 1);
+}
+
 } // namespace vs
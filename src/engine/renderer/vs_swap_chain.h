@@ -8,12 +8,29 @@
 #include <vector>
 
 namespace vs {
+// forward shades every fragment as it is drawn, deferred writes a g-buffer in
+// a first subpass and shades each covered sample once in a second one.
+enum class render_path : uint8_t { forward, deferred };
+
 class vs_swap_chain {
 public:
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 1;
+  // frames the cpu may record while the gpu works on earlier ones, picked when
+  // the renderer is created (1 serializes them). Every per frame resource is
+  // sized by vs_renderer::getFramesInFlight(), the fences live in the
+  // renderer's frame contexts.
+  static constexpr int DEFAULT_FRAMES_IN_FLIGHT = 2;
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+  // g-buffer of the deferred path, 8 bytes per sample so it stays affordable
+  // with msaa. normals are stored as n * 0.5 + 0.5, positions are rebuilt
+  // from depth.
+  static constexpr VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+  static constexpr VkFormat GBUFFER_NORMAL_FORMAT =
+      VK_FORMAT_A2B10G10R10_UNORM_PACK32;
 
-  vs_swap_chain(vs_device &deviceRef, VkExtent2D windowExtent);
   vs_swap_chain(vs_device &deviceRef, VkExtent2D windowExtent,
+                int frames_in_flight);
+  vs_swap_chain(vs_device &deviceRef, VkExtent2D windowExtent,
+                int frames_in_flight,
                 std::shared_ptr<vs_swap_chain> previous_swap_chain);
   ~vs_swap_chain();
 
@@ -24,6 +41,18 @@ public:
     return swapChainFramebuffers[index];
   }
   VkRenderPass getRenderPass() { return renderPass; }
+  // compatible with getRenderPass() but keeps the color and depth contents,
+  // used to continue drawing after a pass was interrupted.
+  VkRenderPass getLoadRenderPass() { return loadRenderPass; }
+  // subpass 0 writes the g-buffer and depth, subpass 1 reads both as input
+  // attachments and shades into the color attachment with depth read only.
+  VkFramebuffer getDeferredFrameBuffer(int index) {
+    return deferredFramebuffers[index];
+  }
+  VkRenderPass getDeferredRenderPass() { return deferredRenderPass; }
+  VkRenderPass getDeferredLoadRenderPass() { return deferredLoadRenderPass; }
+  VkImageView getGBufferAlbedoView() { return gbufferAlbedoView; }
+  VkImageView getGBufferNormalView() { return gbufferNormalView; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
@@ -37,10 +66,23 @@ public:
   }
 
   VkFormat findDepthFormat();
-
-  VkResult acquireNextImage(uint32_t *imageIndex);
+  VkFormat getDepthFormat() { return swapChainDepthFormat; }
+  // depth attachment of framebuffer index, left in
+  // VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL by the render pass.
+  VkImage getDepthImage(int index) { return depthImages[index]; }
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+
+  // unique per swap chain, objects holding views of its images compare this
+  // to notice that the swap chain was recreated.
+  uint64_t getId() const { return id_; }
+
+  // frame_index picks the semaphores, the caller has waited on that frame's
+  // fence so they are free again.
+  VkResult acquireNextImage(int frame_index, uint32_t *imageIndex);
+  // fence is reset and signaled when the buffers have executed.
   VkResult submitCommandBuffers(const VkCommandBuffer *buffers,
-                                uint32_t *imageIndex);
+                                uint32_t *imageIndex, int frame_index,
+                                VkFence fence);
 
   bool compareSwapFormats(const vs_swap_chain &swap_chain) const {
     return swap_chain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -54,7 +96,10 @@ private:
 
   void createColorResources(); //msaa
   void createDepthResources();
+  void createGBufferResources();
   void createRenderPass();
+  VkRenderPass createRenderPass(VkAttachmentLoadOp load_op);
+  VkRenderPass createDeferredRenderPass(VkAttachmentLoadOp load_op);
   void createFramebuffers();
   void createSyncObjects();
 
@@ -86,6 +131,10 @@ private:
   VkExtent2D swapChainExtent;
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkRenderPass renderPass;
+  VkRenderPass loadRenderPass;
+  std::vector<VkFramebuffer> deferredFramebuffers;
+  VkRenderPass deferredRenderPass;
+  VkRenderPass deferredLoadRenderPass;
 
   std::vector<VkImage> depthImages;
   std::vector<VkDeviceMemory> depthImageMemorys;
@@ -97,6 +146,13 @@ private:
   VkDeviceMemory colorImageMemory;
   VkImageView colorImageView;
 
+  VkImage gbufferAlbedoImage;
+  VkDeviceMemory gbufferAlbedoMemory;
+  VkImageView gbufferAlbedoView;
+  VkImage gbufferNormalImage;
+  VkDeviceMemory gbufferNormalMemory;
+  VkImageView gbufferNormalView;
+
 public:
   // TEXTURES//
 
@@ -113,15 +169,16 @@ public:
 private:
   vs_device &device;
   VkExtent2D windowExtent;
+  // one pair of semaphores per frame, at least as many images.
+  int frames_in_flight_;
 
   VkSwapchainKHR swapChain;
+  uint64_t id_;
   std::shared_ptr<vs_swap_chain> old_swap_chain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
   std::vector<VkFence> imagesInFlight;
-  size_t currentFrame = 0;
   void generateMipmaps(VkImage image, VkFormat image_format, int32_t texWidth,
                        int32_t texHeight, uint32_t mipLevels);
 };
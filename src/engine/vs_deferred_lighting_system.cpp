@@ -0,0 +1,195 @@
+﻿#include "vs_deferred_lighting_system.h"
+
+// libs
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vs {
+vs_deferred_lighting_system::vs_deferred_lighting_system(
+    vs_device &device, vs_pipeline_compiler &pipeline_compiler,
+    VkRenderPass deferred_render_pass, VkDescriptorSetLayout global_set_layout,
+    const shader_permutation &permutation)
+    : device_(device) {
+  gbuffer_set_layout_ =
+      vs_descriptor_set_layout::vs_builder(device_)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+  createPipelineLayout(global_set_layout);
+  createPipeline(pipeline_compiler, deferred_render_pass, permutation);
+}
+
+vs_deferred_lighting_system::~vs_deferred_lighting_system() {
+  vkDestroyPipelineLayout(device_.device(), pipeline_layout_, nullptr);
+}
+
+void vs_deferred_lighting_system::createPipelineLayout(
+    VkDescriptorSetLayout global_set_layout) {
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(lighting_push_constant_data);
+
+  std::vector<VkDescriptorSetLayout> descriptor_set_layouts{
+      global_set_layout, gbuffer_set_layout_->getDescriptorSetLayout()};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount =
+      static_cast<uint32_t>(descriptor_set_layouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptor_set_layouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &push_constant_range;
+
+  if (vkCreatePipelineLayout(device_.device(), &pipelineLayoutInfo, nullptr,
+                             &pipeline_layout_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create deferred lighting layout");
+  }
+}
+
+void vs_deferred_lighting_system::createPipeline(
+    vs_pipeline_compiler &pipeline_compiler, VkRenderPass deferred_render_pass,
+    const shader_permutation &permutation) {
+  assert(pipeline_layout_ != nullptr &&
+         "cannot create pipeline before pipeline layout");
+
+  auto pipeline_config = std::make_unique<pipeline_config_info>();
+  vs_pipeline::defaultPipelineConfigInfo(*pipeline_config, device_.msaa_samples,
+                                         true);
+  pipeline_config->attribute_descriptions.clear();
+  pipeline_config->binding_descriptions.clear();
+  // depth is read only in the lighting subpass, the triangle covers it all.
+  pipeline_config->depth_stencil_info.depthTestEnable = VK_FALSE;
+  pipeline_config->depth_stencil_info.depthWriteEnable = VK_FALSE;
+  pipeline_config->render_pass = deferred_render_pass;
+  pipeline_config->subpass = 1;
+  pipeline_config->pipeline_layout = pipeline_layout_;
+  pipeline_config->permutation = permutation;
+  pipeline_ = pipeline_compiler.submit("shaders/deferred_lighting.vert.spv",
+                                       "shaders/deferred_lighting.frag.spv",
+                                       std::move(pipeline_config));
+}
+
+void vs_deferred_lighting_system::updateDescriptorSets(
+    vs_swap_chain &swap_chain) {
+  if (swap_chain.getId() == swap_chain_id_)
+    return;
+
+  // the renderer waited for the device before it recreated the swap chain.
+  const auto image_count = static_cast<uint32_t>(swap_chain.imageCount());
+  descriptor_pool_ =
+      vs_descriptor_pool::vs_builder(device_)
+          .setMaxSets(image_count)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3 * image_count)
+          .build();
+
+  VkDescriptorImageInfo albedo_info{VK_NULL_HANDLE,
+                                    swap_chain.getGBufferAlbedoView(),
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  VkDescriptorImageInfo normal_info{VK_NULL_HANDLE,
+                                    swap_chain.getGBufferNormalView(),
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  gbuffer_descriptor_sets_.resize(image_count);
+  for (uint32_t i = 0; i < image_count; ++i) {
+    VkDescriptorImageInfo depth_info{
+        VK_NULL_HANDLE, swap_chain.getDepthImageView(static_cast<int>(i)),
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+    vs_descriptor_writer(*gbuffer_set_layout_, *descriptor_pool_)
+        .writeImage(0, &albedo_info)
+        .writeImage(1, &normal_info)
+        .writeImage(2, &depth_info)
+        .build(gbuffer_descriptor_sets_[i]);
+  }
+  swap_chain_id_ = swap_chain.getId();
+}
+
+float vs_deferred_lighting_system::estimateOverdraw(
+    const frame_info &frame_info) {
+  const glm::mat4 projection = frame_info.camera.getProjection();
+  const glm::mat4 view = frame_info.camera.getView();
+
+  // ndc area of the bounding sphere of every object, the screen is 4.
+  float area = 0.f;
+  auto add_object = [&](const vs_game_object &object) {
+    const auto &bounds = object.model_comp->getBounds();
+    const glm::mat4 &world = object.transform_comp.mat4();
+    const glm::vec3 scale{glm::length(glm::vec3(world[0])),
+                          glm::length(glm::vec3(world[1])),
+                          glm::length(glm::vec3(world[2]))};
+    const float radius = 0.5f * glm::length((bounds.max - bounds.min) * scale);
+    const glm::vec3 center = glm::vec3(
+        view * world * glm::vec4(0.5f * (bounds.min + bounds.max), 1.f));
+    if (center.z + radius <= 0.f)
+      return;
+    // the camera inside the sphere covers the whole screen.
+    const float depth = std::max(center.z, radius);
+    const float object_area = glm::pi<float>() *
+                              (radius * projection[0][0] / depth) *
+                              (radius * projection[1][1] / depth);
+    area += std::min(object_area, 4.f);
+  };
+
+  if (frame_info.visible_objects != nullptr) {
+    for (const auto *object : *frame_info.visible_objects) {
+      add_object(*object);
+    }
+  } else {
+    for (const auto &kv : frame_info.game_objects) {
+      if (kv.second.model_comp != nullptr)
+        add_object(kv.second);
+    }
+  }
+  return area / 4.f;
+}
+
+render_path vs_deferred_lighting_system::selectPath(const frame_info &frame_info,
+                                                    uint32_t light_count) {
+  overdraw_ = estimateOverdraw(frame_info);
+  if (device_.msaa_samples == VK_SAMPLE_COUNT_1_BIT) {
+    path_ = render_path::forward;
+    return path_;
+  }
+
+  const float lights = static_cast<float>(light_count);
+  const float min_lights = static_cast<float>(MIN_DEFERRED_LIGHTS);
+  if (path_ == render_path::forward) {
+    if (lights >= min_lights && overdraw_ >= MIN_DEFERRED_OVERDRAW)
+      path_ = render_path::deferred;
+  } else if (lights < min_lights * HYSTERESIS ||
+             overdraw_ < MIN_DEFERRED_OVERDRAW * HYSTERESIS) {
+    path_ = render_path::forward;
+  }
+  return path_;
+}
+
+void vs_deferred_lighting_system::render(frame_info &frame_info,
+                                         vs_swap_chain &swap_chain,
+                                         uint32_t image_index) {
+  updateDescriptorSets(swap_chain);
+
+  pipeline_->bind(frame_info.command_buffer);
+  VkDescriptorSet descriptor_sets[] = {
+      frame_info.global_descriptor_set, gbuffer_descriptor_sets_[image_index]};
+  vkCmdBindDescriptorSets(frame_info.command_buffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0,
+                          2, descriptor_sets, 0, nullptr);
+
+  lighting_push_constant_data push{};
+  push.inverse_view_projection = glm::inverse(
+      frame_info.camera.getProjection() * frame_info.camera.getView());
+  vkCmdPushConstants(frame_info.command_buffer, pipeline_layout_,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                     sizeof(lighting_push_constant_data), &push);
+
+  vkCmdDraw(frame_info.command_buffer, 3, 1, 0, 0);
+}
+} // namespace vs
@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "engine/renderer/vs_descriptors.h"
+#include "engine/renderer/vs_device.h"
+#include "engine/renderer/vs_pipeline.h"
+#include "engine/renderer/vs_pipeline_compiler.h"
+#include "engine/renderer/vs_swap_chain.h"
+#include "engine/vs_frame_info.h"
+
+
+namespace vs
+{
+	// lighting subpass of the deferred render pass, one fullscreen triangle reads the g-buffer and
+	// depth as input attachments and shades every sample with the clustered lights of the global set.
+	// also picks the path of a frame: deferred pays a fixed g-buffer cost per sample but shades each
+	// one once, forward shades every drawn fragment including the overdrawn ones, so deferred only
+	// wins with many lights and a lot of overdraw.
+	class vs_deferred_lighting_system
+	{
+	public:
+		// the path switches to deferred above both, and back to forward below HYSTERESIS of either.
+		static constexpr uint32_t MIN_DEFERRED_LIGHTS = 64;
+		static constexpr float MIN_DEFERRED_OVERDRAW = 1.5f;
+		static constexpr float HYSTERESIS = 0.75f;
+
+		vs_deferred_lighting_system(vs_device& device, vs_pipeline_compiler& pipeline_compiler,
+		                            VkRenderPass deferred_render_pass, VkDescriptorSetLayout global_set_layout,
+		                            const shader_permutation& permutation);
+		~vs_deferred_lighting_system();
+
+		vs_deferred_lighting_system(const vs_deferred_lighting_system&) = delete;
+		vs_deferred_lighting_system& operator==(const vs_deferred_lighting_system&) = delete;
+
+		// estimates the overdraw of frame_info.visible_objects (or every game object) from their
+		// projected bounds and returns the path to render the frame with. always forward without msaa,
+		// the lighting reads the g-buffer per sample.
+		render_path selectPath(const frame_info& frame_info, uint32_t light_count);
+		// records the lighting, call in subpass 1 of the deferred pass of image_index.
+		void render(frame_info& frame_info, vs_swap_chain& swap_chain, uint32_t image_index);
+
+		render_path getPath() const { return path_; }
+		// projected object area over screen area of the last selectPath.
+		float getOverdraw() const { return overdraw_; }
+
+	private:
+		struct lighting_push_constant_data
+		{
+			glm::mat4 inverse_view_projection;
+		};
+
+		void createPipelineLayout(VkDescriptorSetLayout global_set_layout);
+		void createPipeline(vs_pipeline_compiler& pipeline_compiler, VkRenderPass deferred_render_pass,
+		                    const shader_permutation& permutation);
+		// input attachment sets point at views of the swap chain, rebuilt when it is recreated.
+		void updateDescriptorSets(vs_swap_chain& swap_chain);
+		static float estimateOverdraw(const frame_info& frame_info);
+
+		vs_device& device_;
+		vs_pipeline_compiler::handle pipeline_;
+		VkPipelineLayout pipeline_layout_;
+
+		std::unique_ptr<vs_descriptor_set_layout> gbuffer_set_layout_;
+		std::unique_ptr<vs_descriptor_pool> descriptor_pool_;
+		std::vector<VkDescriptorSet> gbuffer_descriptor_sets_;
+		uint64_t swap_chain_id_ = UINT64_MAX;
+
+		render_path path_ = render_path::forward;
+		float overdraw_ = 0.f;
+	};
+}
@@ -0,0 +1,226 @@
+﻿#include "vs_draw_stream.h"
+
+#include "vs_material_system.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vs {
+// key layout from the most significant bit down.
+static constexpr uint32_t PASS_BITS = 4;
+static constexpr uint32_t PIPELINE_BITS = 12;
+static constexpr uint32_t MATERIAL_BITS = 12;
+static constexpr uint32_t MESH_BITS = 20;
+static constexpr uint32_t DEPTH_BITS = 16;
+static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS +
+                      DEPTH_BITS ==
+                  64,
+              "sort key fields must fill 64 bits");
+static_assert(vs_material_system::MAX_MATERIALS <= (1u << MATERIAL_BITS),
+              "material ids are used as the key field unchanged");
+
+static constexpr uint32_t DEPTH_SHIFT = 0;
+static constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+static constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+
+// distances at this value land in the middle of the depth range.
+static constexpr float DEPTH_SCALE = 10.f;
+
+static uint64_t keyField(uint64_t value, uint32_t bits, uint32_t shift) {
+  return (value & ((uint64_t{1} << bits) - 1)) << shift;
+}
+
+void vs_draw_stream::clear() {
+  packets_.clear();
+  payloads_.clear();
+  push_data_.clear();
+  // keys are only compared within a frame, fresh ids keep the maps from
+  // growing and from holding on to handles of destroyed objects.
+  pipeline_ids_.clear();
+  mesh_ids_.clear();
+}
+
+uint32_t vs_draw_stream::idOf(std::unordered_map<uint64_t, uint32_t> &ids,
+                              uint64_t handle) {
+  // ids past the width of a key field wrap, that only costs sort quality,
+  // replay compares the real state. a handle reused by a new object within
+  // the frame can't happen, nothing is destroyed while draws are collected.
+  return ids.try_emplace(handle, static_cast<uint32_t>(ids.size()))
+      .first->second;
+}
+
+uint64_t vs_draw_stream::makeKey(draw_pass pass, const draw_call &call,
+                                 float depth) {
+  // maps [0, inf) onto [0, 1) keeping the precision close to the camera.
+  depth = std::max(depth, 0.f);
+  auto depth_bucket = static_cast<uint64_t>(
+      depth / (depth + DEPTH_SCALE) *
+      static_cast<float>((1u << DEPTH_BITS) - 1));
+  if (pass == draw_pass::transparent) {
+    depth_bucket = ((1u << DEPTH_BITS) - 1) - depth_bucket;
+  }
+
+  return keyField(static_cast<uint64_t>(pass), PASS_BITS, PASS_SHIFT) |
+         keyField(idOf(pipeline_ids_, (uint64_t)call.pipeline), PIPELINE_BITS,
+                  PIPELINE_SHIFT) |
+         keyField(call.material_id, MATERIAL_BITS, MATERIAL_SHIFT) |
+         keyField(idOf(mesh_ids_, (uint64_t)call.model), MESH_BITS,
+                  MESH_SHIFT) |
+         keyField(depth_bucket, DEPTH_BITS, DEPTH_SHIFT);
+}
+
+void vs_draw_stream::add(draw_pass pass, const draw_call &call, float depth,
+                         const void *push_data, uint32_t push_size) {
+  draw_payload payload{call, static_cast<uint32_t>(push_data_.size()),
+                       push_size};
+  if (push_size > 0) {
+    push_data_.resize(push_data_.size() + push_size);
+    std::memcpy(push_data_.data() + payload.push_offset, push_data, push_size);
+  }
+
+  packets_.push_back({makeKey(pass, call, depth),
+                      static_cast<uint32_t>(payloads_.size())});
+  payloads_.push_back(payload);
+}
+
+void vs_draw_stream::sort() {
+  // lsd radix sort, 8 bits per pass. stable, so equal keys keep the order
+  // they were added in.
+  const size_t count = packets_.size();
+  if (count < 2)
+    return;
+  sort_scratch_.resize(count);
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    uint32_t histogram[256]{};
+    for (const auto &packet : packets_) {
+      ++histogram[(packet.key >> shift) & 0xff];
+    }
+    // every key has the same byte here, nothing to reorder.
+    if (histogram[(packets_[0].key >> shift) & 0xff] == count)
+      continue;
+
+    uint32_t offset = 0;
+    for (auto &bucket : histogram) {
+      const uint32_t bucket_count = bucket;
+      bucket = offset;
+      offset += bucket_count;
+    }
+    for (const auto &packet : packets_) {
+      sort_scratch_[histogram[(packet.key >> shift) & 0xff]++] = packet;
+    }
+    packets_.swap(sort_scratch_);
+  }
+}
+
+void vs_draw_stream::replay(VkCommandBuffer command_buffer) {
+  stats_ = replayRange(command_buffer, 0, packets_.size());
+}
+
+const std::vector<VkCommandBuffer> &
+vs_draw_stream::replayParallel(vs_secondary_recorder &recorder,
+                               const secondary_target &target) {
+  // the split only depends on the packet count, so the order of the draws
+  // is the same no matter which worker records which range.
+  const size_t count = packets_.size();
+  const auto job_count = static_cast<uint32_t>(
+      std::min<size_t>(recorder.getThreadCount(),
+                       (count + MIN_PACKETS_PER_JOB - 1) / MIN_PACKETS_PER_JOB));
+  job_stats_.assign(job_count, {});
+
+  const auto &command_buffers = recorder.record(
+      job_count, target, [&](VkCommandBuffer command_buffer, uint32_t job) {
+        job_stats_[job] = replayRange(command_buffer, count * job / job_count,
+                                      count * (job + 1) / job_count);
+      });
+
+  stats_ = {};
+  for (const auto &job : job_stats_) {
+    stats_.draws += job.draws;
+    stats_.pipeline_binds += job.pipeline_binds;
+    stats_.pipeline_binds_skipped += job.pipeline_binds_skipped;
+    stats_.descriptor_binds += job.descriptor_binds;
+    stats_.descriptor_binds_skipped += job.descriptor_binds_skipped;
+    stats_.vertex_binds += job.vertex_binds;
+    stats_.vertex_binds_skipped += job.vertex_binds_skipped;
+  }
+  return command_buffers;
+}
+
+draw_stream_stats vs_draw_stream::replayRange(VkCommandBuffer command_buffer,
+                                              size_t first,
+                                              size_t last) const {
+  draw_stream_stats stats{};
+
+  vs_pipeline *bound_pipeline = nullptr;
+  VkPipelineLayout bound_layout = VK_NULL_HANDLE;
+  VkDescriptorSet bound_sets[draw_call::MAX_DESCRIPTOR_SETS]{};
+  uint32_t bound_set_count = 0;
+  vs_model_component *bound_model = nullptr;
+
+  for (size_t i = first; i < last; ++i) {
+    const auto &payload = payloads_[packets_[i].payload];
+    const auto &call = payload.call;
+
+    if (call.pipeline != bound_pipeline) {
+      call.pipeline->bind(command_buffer);
+      bound_pipeline = call.pipeline;
+      ++stats.pipeline_binds;
+    } else {
+      ++stats.pipeline_binds_skipped;
+    }
+
+    if (call.descriptor_set_count > 0) {
+      // sets bound with another layout may have been disturbed.
+      const bool same_sets =
+          call.pipeline_layout == bound_layout &&
+          call.descriptor_set_count <= bound_set_count &&
+          std::equal(call.descriptor_sets,
+                     call.descriptor_sets + call.descriptor_set_count,
+                     bound_sets);
+      if (!same_sets) {
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                call.pipeline_layout, 0,
+                                call.descriptor_set_count, call.descriptor_sets,
+                                0, nullptr);
+        bound_layout = call.pipeline_layout;
+        std::copy(call.descriptor_sets,
+                  call.descriptor_sets + call.descriptor_set_count, bound_sets);
+        bound_set_count = call.descriptor_set_count;
+        ++stats.descriptor_binds;
+      } else {
+        ++stats.descriptor_binds_skipped;
+      }
+    }
+
+    if (payload.push_size > 0) {
+      vkCmdPushConstants(command_buffer, call.pipeline_layout,
+                         call.push_constant_stages, 0, payload.push_size,
+                         push_data_.data() + payload.push_offset);
+    }
+
+    if (call.model != nullptr) {
+      if (call.model != bound_model) {
+        call.model->bind(command_buffer);
+        bound_model = call.model;
+        ++stats.vertex_binds;
+      } else {
+        ++stats.vertex_binds_skipped;
+      }
+      call.model->draw(command_buffer, call.instance_count,
+                       call.first_instance);
+    } else if (call.indirect_buffer != VK_NULL_HANDLE) {
+      vkCmdDrawIndirect(command_buffer, call.indirect_buffer,
+                        call.indirect_offset, 1,
+                        sizeof(VkDrawIndirectCommand));
+    } else {
+      vkCmdDraw(command_buffer, call.vertex_count, call.instance_count, 0,
+                call.first_instance);
+    }
+    ++stats.draws;
+  }
+  return stats;
+}
+} // namespace vs
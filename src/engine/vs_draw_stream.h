@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "engine/renderer/vs_pipeline.h"
+#include "engine/renderer/vs_secondary_recorder.h"
+#include "vs_model_component.h"
+
+
+namespace vs
+{
+	// passes are replayed in this order.
+	enum class draw_pass : uint8_t
+	{
+		opaque = 0,
+		transparent = 1, // back to front
+	};
+
+	// everything needed to record one draw, without a model vertex_count vertices are drawn unbound.
+	struct draw_call
+	{
+		static constexpr uint32_t MAX_DESCRIPTOR_SETS = 2;
+
+		vs_pipeline* pipeline = nullptr;
+		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		// bound from set 0.
+		VkDescriptorSet descriptor_sets[MAX_DESCRIPTOR_SETS]{};
+		uint32_t descriptor_set_count = 0;
+		// vs_material_system id shared by every instance of the draw, only used for the sort key.
+		uint32_t material_id = 0;
+		vs_model_component* model = nullptr;
+		uint32_t vertex_count = 0;
+		uint32_t instance_count = 1;
+		uint32_t first_instance = 0;
+		// without a model, the counts come from a VkDrawIndirectCommand at indirect_offset instead,
+		// for draws sized on the gpu.
+		VkBuffer indirect_buffer = VK_NULL_HANDLE;
+		VkDeviceSize indirect_offset = 0;
+		VkShaderStageFlags push_constant_stages = 0;
+	};
+
+	// binds skipped because the sorted stream already had the state bound.
+	struct draw_stream_stats
+	{
+		uint32_t draws = 0;
+		uint32_t pipeline_binds = 0;
+		uint32_t pipeline_binds_skipped = 0;
+		uint32_t descriptor_binds = 0;
+		uint32_t descriptor_binds_skipped = 0;
+		uint32_t vertex_binds = 0;
+		uint32_t vertex_binds_skipped = 0;
+	};
+
+	// render systems add draw packets instead of recording commands. every packet gets a 64 bit sort key
+	// (pass, pipeline, material, mesh, depth bucket from the most significant bits down), the stream
+	// is radix sorted and replayed into the command buffer skipping binds of state that is already bound.
+	class vs_draw_stream
+	{
+	public:
+		vs_draw_stream() = default;
+
+		vs_draw_stream(const vs_draw_stream&) = delete;
+		vs_draw_stream& operator==(const vs_draw_stream&) = delete;
+
+		// drops the packets and the key ids of the last frame.
+		void clear();
+		// depth is the view space distance of the draw, push_data is copied into the stream.
+		void add(draw_pass pass, const draw_call& call, float depth, const void* push_data = nullptr,
+		         uint32_t push_size = 0);
+
+		void sort();
+		// records the sorted packets, call inside the render pass.
+		void replay(VkCommandBuffer command_buffer);
+		// records the sorted packets into secondaries, split into contiguous ranges recorded in parallel.
+		// execute the returned buffers in order.
+		const std::vector<VkCommandBuffer>& replayParallel(vs_secondary_recorder& recorder,
+		                                                   const secondary_target& target);
+
+		size_t size() const { return packets_.size(); }
+		const draw_stream_stats& getStats() const { return stats_; }
+
+	private:
+		// fewer packets than this aren't worth a secondary of their own.
+		static constexpr size_t MIN_PACKETS_PER_JOB = 256;
+
+		struct draw_packet
+		{
+			uint64_t key;
+			uint32_t payload;
+		};
+
+		struct draw_payload
+		{
+			draw_call call;
+			uint32_t push_offset;
+			uint32_t push_size;
+		};
+
+		uint64_t makeKey(draw_pass pass, const draw_call& call, float depth);
+		// packets [first, last) recorded from an empty binding state.
+		draw_stream_stats replayRange(VkCommandBuffer command_buffer, size_t first, size_t last) const;
+		// small ids for the key fields, assigned on first use and dropped by clear().
+		static uint32_t idOf(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle);
+
+		std::vector<draw_packet> packets_;
+		std::vector<draw_packet> sort_scratch_;
+		std::vector<draw_payload> payloads_;
+		std::vector<uint8_t> push_data_;
+
+		std::unordered_map<uint64_t, uint32_t> pipeline_ids_;
+		std::unordered_map<uint64_t, uint32_t> mesh_ids_;
+
+		draw_stream_stats stats_{};
+		std::vector<draw_stream_stats> job_stats_;
+	};
+}
@@ -3,21 +3,31 @@
 #include "vs_game_object.h"
 #include <vulkan/vulkan.h>
 
-namespace vs {
-#define MAX_LIGHTS 10
+// std
+#include <vector>
 
+namespace vs {
+// element of the light storage buffer, see vs_light_cluster_system. read by
+// the lighting and by the billboards of the point light render system.
 struct point_light {
-  glm::vec4 position; // ignore w
+  glm::vec4 position; // w is range
   glm::vec4 color;    // w is intensity
+  float radius;       // of the billboard
+  int32_t shadow_index; // layer group of the point shadow map, -1 for none
+  float padding[2];
 };
 
 struct global_ubo {
   glm::mat4 projection{1.f};
   glm::mat4 view{1.f};
   glm::vec4 ambient_light_color{1.f, 1.f, 1.f, 0.1f}; // w is intensity
-  point_light point_lights[MAX_LIGHTS];
-  int num_lights;
+  glm::uvec4 cluster_grid{0};  // clusters in x, y and z, w is the light count
+  glm::vec4 cluster_depth{0.f}; // slice is log(depth) * x + y
+  glm::vec4 viewport{0.f};      // width, height, 1 / width, 1 / height
   glm::vec4 cam_pos;
+  glm::mat4 sun_view_projection{1.f};
+  glm::vec4 sun_direction{0.f}; // the sun shines along xyz
+  glm::vec4 sun_color{0.f};     // w is intensity, 0 is no sun
 };
 
 struct frame_info {
@@ -32,5 +42,8 @@ struct frame_info {
 
   vs_game_object::map &game_objects;
   vs_game_object::map &lights;
+
+  // model objects left after culling, nullptr draws every game object.
+  const std::vector<vs_game_object *> *visible_objects = nullptr;
 };
 } // namespace vs
@@ -0,0 +1,225 @@
+﻿#include "vs_frustum_culler.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VS_CULL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VS_CULL_SSE
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace vs {
+vs_frustum_culler::handle vs_frustum_culler::add(const glm::vec3 &min,
+                                                 const glm::vec3 &max,
+                                                 const glm::mat4 &world_matrix) {
+  handle box;
+  if (!free_handles_.empty()) {
+    box = free_handles_.back();
+    free_handles_.pop_back();
+  } else {
+    box = static_cast<handle>(slots_.size());
+    slots_.push_back(0);
+  }
+
+  const auto slot = static_cast<uint32_t>(handles_.size());
+  slots_[box] = slot;
+  handles_.push_back(box);
+  local_centers_.push_back(0.5f * (min + max));
+  local_extents_.push_back(0.5f * (max - min));
+  center_x_.push_back(0.f);
+  center_y_.push_back(0.f);
+  center_z_.push_back(0.f);
+  extent_x_.push_back(0.f);
+  extent_y_.push_back(0.f);
+  extent_z_.push_back(0.f);
+  writeWorldBox(slot, world_matrix);
+  return box;
+}
+
+void vs_frustum_culler::setWorldMatrix(handle box,
+                                       const glm::mat4 &world_matrix) {
+  assert(box < slots_.size() && slots_[box] != INVALID_HANDLE &&
+         "box was removed");
+  writeWorldBox(slots_[box], world_matrix);
+}
+
+void vs_frustum_culler::remove(handle box) {
+  assert(box < slots_.size() && slots_[box] != INVALID_HANDLE &&
+         "box was removed");
+  const uint32_t slot = slots_[box];
+  const auto last = static_cast<uint32_t>(handles_.size() - 1);
+
+  // the last box fills the hole, the arrays stay dense.
+  local_centers_[slot] = local_centers_[last];
+  local_extents_[slot] = local_extents_[last];
+  center_x_[slot] = center_x_[last];
+  center_y_[slot] = center_y_[last];
+  center_z_[slot] = center_z_[last];
+  extent_x_[slot] = extent_x_[last];
+  extent_y_[slot] = extent_y_[last];
+  extent_z_[slot] = extent_z_[last];
+  handles_[slot] = handles_[last];
+  slots_[handles_[slot]] = slot;
+
+  local_centers_.pop_back();
+  local_extents_.pop_back();
+  center_x_.pop_back();
+  center_y_.pop_back();
+  center_z_.pop_back();
+  extent_x_.pop_back();
+  extent_y_.pop_back();
+  extent_z_.pop_back();
+  handles_.pop_back();
+
+  slots_[box] = INVALID_HANDLE;
+  free_handles_.push_back(box);
+}
+
+void vs_frustum_culler::writeWorldBox(uint32_t slot,
+                                      const glm::mat4 &world_matrix) {
+  // box around the transformed model space box.
+  const glm::vec3 world_center =
+      glm::vec3(world_matrix * glm::vec4(local_centers_[slot], 1.f));
+  const glm::mat3 abs_m{glm::abs(glm::vec3(world_matrix[0])),
+                        glm::abs(glm::vec3(world_matrix[1])),
+                        glm::abs(glm::vec3(world_matrix[2]))};
+  const glm::vec3 world_extents = abs_m * local_extents_[slot];
+
+  center_x_[slot] = world_center.x;
+  center_y_[slot] = world_center.y;
+  center_z_[slot] = world_center.z;
+  extent_x_[slot] = world_extents.x;
+  extent_y_[slot] = world_extents.y;
+  extent_z_[slot] = world_extents.z;
+}
+
+float vs_frustum_culler::visibilityMargin(
+    handle box, const std::array<glm::vec4, 6> &planes) const {
+  return slotMargin(slots_[box], planes);
+}
+
+float vs_frustum_culler::slotMargin(
+    uint32_t slot, const std::array<glm::vec4, 6> &planes) const {
+  float margin = std::numeric_limits<float>::max();
+  for (const auto &plane : planes) {
+    const float distance = plane.x * center_x_[slot] +
+                           plane.y * center_y_[slot] +
+                           plane.z * center_z_[slot] + plane.w;
+    const float radius = std::abs(plane.x) * extent_x_[slot] +
+                         std::abs(plane.y) * extent_y_[slot] +
+                         std::abs(plane.z) * extent_z_[slot];
+    margin = std::min(margin, distance + radius);
+  }
+  return margin;
+}
+
+void vs_frustum_culler::cullScalar(const std::array<glm::vec4, 6> &planes,
+                                   std::vector<handle> &visible) const {
+  visible.clear();
+  for (uint32_t slot = 0; slot < handles_.size(); ++slot) {
+    if (slotMargin(slot, planes) >= 0.f)
+      visible.push_back(handles_[slot]);
+  }
+}
+
+void vs_frustum_culler::cull(const std::array<glm::vec4, 6> &planes,
+                             std::vector<handle> &visible) const {
+  visible.clear();
+  const size_t count = handles_.size();
+  size_t i = 0;
+#if defined(VS_CULL_AVX2)
+  __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+  __m256 abs_x[6], abs_y[6], abs_z[6];
+  for (int p = 0; p < 6; ++p) {
+    plane_x[p] = _mm256_set1_ps(planes[p].x);
+    plane_y[p] = _mm256_set1_ps(planes[p].y);
+    plane_z[p] = _mm256_set1_ps(planes[p].z);
+    plane_w[p] = _mm256_set1_ps(planes[p].w);
+    abs_x[p] = _mm256_set1_ps(std::abs(planes[p].x));
+    abs_y[p] = _mm256_set1_ps(std::abs(planes[p].y));
+    abs_z[p] = _mm256_set1_ps(std::abs(planes[p].z));
+  }
+  const __m256 zero = _mm256_setzero_ps();
+
+  for (; i + 8 <= count; i += 8) {
+    const __m256 cx = _mm256_loadu_ps(&center_x_[i]);
+    const __m256 cy = _mm256_loadu_ps(&center_y_[i]);
+    const __m256 cz = _mm256_loadu_ps(&center_z_[i]);
+    const __m256 ex = _mm256_loadu_ps(&extent_x_[i]);
+    const __m256 ey = _mm256_loadu_ps(&extent_y_[i]);
+    const __m256 ez = _mm256_loadu_ps(&extent_z_[i]);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m256 distance = _mm256_fmadd_ps(
+          plane_x[p], cx,
+          _mm256_fmadd_ps(plane_y[p], cy,
+                          _mm256_fmadd_ps(plane_z[p], cz, plane_w[p])));
+      __m256 radius = _mm256_fmadd_ps(
+          abs_x[p], ex,
+          _mm256_fmadd_ps(abs_y[p], ey, _mm256_mul_ps(abs_z[p], ez)));
+      inside = _mm256_and_ps(
+          inside,
+          _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+    }
+
+    const int mask = _mm256_movemask_ps(inside);
+    for (int lane = 0; lane < 8; ++lane) {
+      if (mask & (1 << lane))
+        visible.push_back(handles_[i + lane]);
+    }
+  }
+#elif defined(VS_CULL_SSE)
+  __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+  __m128 abs_x[6], abs_y[6], abs_z[6];
+  for (int p = 0; p < 6; ++p) {
+    plane_x[p] = _mm_set1_ps(planes[p].x);
+    plane_y[p] = _mm_set1_ps(planes[p].y);
+    plane_z[p] = _mm_set1_ps(planes[p].z);
+    plane_w[p] = _mm_set1_ps(planes[p].w);
+    abs_x[p] = _mm_set1_ps(std::abs(planes[p].x));
+    abs_y[p] = _mm_set1_ps(std::abs(planes[p].y));
+    abs_z[p] = _mm_set1_ps(std::abs(planes[p].z));
+  }
+  const __m128 zero = _mm_setzero_ps();
+
+  for (; i + 4 <= count; i += 4) {
+    const __m128 cx = _mm_loadu_ps(&center_x_[i]);
+    const __m128 cy = _mm_loadu_ps(&center_y_[i]);
+    const __m128 cz = _mm_loadu_ps(&center_z_[i]);
+    const __m128 ex = _mm_loadu_ps(&extent_x_[i]);
+    const __m128 ey = _mm_loadu_ps(&extent_y_[i]);
+    const __m128 ez = _mm_loadu_ps(&extent_z_[i]);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(plane_x[p], cx), _mm_mul_ps(plane_y[p], cy)),
+          _mm_add_ps(_mm_mul_ps(plane_z[p], cz), plane_w[p]));
+      __m128 radius = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(abs_x[p], ex), _mm_mul_ps(abs_y[p], ey)),
+          _mm_mul_ps(abs_z[p], ez));
+      inside = _mm_and_ps(inside,
+                          _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+    }
+
+    const int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; lane < 4; ++lane) {
+      if (mask & (1 << lane))
+        visible.push_back(handles_[i + lane]);
+    }
+  }
+#endif
+
+  for (; i < count; ++i) {
+    if (slotMargin(static_cast<uint32_t>(i), planes) >= 0.f)
+      visible.push_back(handles_[i]);
+  }
+}
+} // namespace vs
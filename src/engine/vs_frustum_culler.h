@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+
+namespace vs
+{
+	// world space boxes kept as structure of arrays, culled against a frustum 8 (avx2) or 4 (sse)
+	// boxes per iteration, build with VS_ENABLE_AVX2 for the wide path. no vulkan involved.
+	// the arrays are maintained, a box is only recomputed when its world matrix changes, removing
+	// one moves the last box into its slot. handles stay valid until the box is removed.
+	class vs_frustum_culler
+	{
+	public:
+		using handle = uint32_t;
+		static constexpr handle INVALID_HANDLE = UINT32_MAX;
+
+		vs_frustum_culler() = default;
+
+		vs_frustum_culler(const vs_frustum_culler&) = delete;
+		vs_frustum_culler& operator==(const vs_frustum_culler&) = delete;
+
+		// model space box placed by world_matrix.
+		handle add(const glm::vec3& min, const glm::vec3& max, const glm::mat4& world_matrix);
+		void setWorldMatrix(handle box, const glm::mat4& world_matrix);
+		void remove(handle box);
+		size_t size() const { return handles_.size(); }
+
+		// handles of the boxes inside or touching the planes, replaces the contents of visible.
+		void cull(const std::array<glm::vec4, 6>& planes, std::vector<handle>& visible) const;
+		// scalar reference of cull(), same order. boxes touching a plane may go either way
+		// between the two because of fma rounding.
+		void cullScalar(const std::array<glm::vec4, 6>& planes, std::vector<handle>& visible) const;
+		// smallest signed distance of the box to any plane, negative when the box is outside.
+		float visibilityMargin(handle box, const std::array<glm::vec4, 6>& planes) const;
+
+	private:
+		void writeWorldBox(uint32_t slot, const glm::mat4& world_matrix);
+		float slotMargin(uint32_t slot, const std::array<glm::vec4, 6>& planes) const;
+
+		// by slot, the model space boxes only change on add.
+		std::vector<glm::vec3> local_centers_;
+		std::vector<glm::vec3> local_extents_;
+		std::vector<float> center_x_;
+		std::vector<float> center_y_;
+		std::vector<float> center_z_;
+		std::vector<float> extent_x_;
+		std::vector<float> extent_y_;
+		std::vector<float> extent_z_;
+		std::vector<handle> handles_;
+
+		// by handle.
+		std::vector<uint32_t> slots_;
+		std::vector<handle> free_handles_;
+	};
+}
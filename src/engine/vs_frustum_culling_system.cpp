@@ -0,0 +1,46 @@
+﻿#include "vs_frustum_culling_system.h"
+
+namespace vs {
+void vs_frustum_culling_system::cull(
+    frame_info &frame_info,
+    const std::vector<vs_game_object *> &changed_objects) {
+  updateBounds(changed_objects);
+  culler_.cull(frame_info.camera.getFrustumPlanes(), visible_handles_);
+
+  visible_objects_.clear();
+  for (auto box : visible_handles_) {
+    visible_objects_.push_back(objects_[box]);
+  }
+  frame_info.visible_objects = &visible_objects_;
+}
+
+void vs_frustum_culling_system::remove(vs_game_object::id_t id) {
+  auto it = handles_.find(id);
+  if (it == handles_.end())
+    return;
+  culler_.remove(it->second);
+  objects_[it->second] = nullptr;
+  handles_.erase(it);
+}
+
+void vs_frustum_culling_system::updateBounds(
+    const std::vector<vs_game_object *> &changed_objects) {
+  for (auto *object : changed_objects) {
+    if (object->model_comp == nullptr)
+      continue;
+
+    const glm::mat4 &world_matrix = object->transform_comp.mat4();
+    auto [it, inserted] = handles_.try_emplace(object->getId());
+    if (!inserted) {
+      culler_.setWorldMatrix(it->second, world_matrix);
+      continue;
+    }
+
+    const auto &bounds = object->model_comp->getBounds();
+    it->second = culler_.add(bounds.min, bounds.max, world_matrix);
+    if (it->second >= objects_.size())
+      objects_.resize(it->second + 1);
+    objects_[it->second] = object;
+  }
+}
+} // namespace vs
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "engine/vs_frame_info.h"
+#include "engine/vs_frustum_culler.h"
+
+
+namespace vs
+{
+	// culls the model objects against the camera frustum with a vs_frustum_culler. the boxes are
+	// maintained, only the objects vs_transform_system recomputed are updated each frame. every
+	// object starts out dirty, so new ones show up there on their first frame.
+	class vs_frustum_culling_system
+	{
+	public:
+		vs_frustum_culling_system() = default;
+
+		vs_frustum_culling_system(const vs_frustum_culling_system&) = delete;
+		vs_frustum_culling_system& operator==(const vs_frustum_culling_system&) = delete;
+
+		// adds or moves the boxes of changed_objects, culls and points frame_info.visible_objects at
+		// the result.
+		void cull(frame_info& frame_info, const std::vector<vs_game_object*>& changed_objects);
+		// objects have to be removed here before they are erased from their map, the culler keeps
+		// pointers to them.
+		void remove(vs_game_object::id_t id);
+
+		const std::vector<vs_game_object*>& getVisibleObjects() const { return visible_objects_; }
+		size_t getCulledCount() const { return culler_.size() - visible_objects_.size(); }
+
+	private:
+		void updateBounds(const std::vector<vs_game_object*>& changed_objects);
+
+		vs_frustum_culler culler_;
+		std::unordered_map<vs_game_object::id_t, vs_frustum_culler::handle> handles_;
+		// by handle.
+		std::vector<vs_game_object*> objects_;
+
+		std::vector<vs_frustum_culler::handle> visible_handles_;
+		std::vector<vs_game_object*> visible_objects_;
+	};
+}
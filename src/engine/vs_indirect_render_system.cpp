@@ -0,0 +1,504 @@
+﻿#include "vs_indirect_render_system.h"
+
+#include "engine/renderer/vs_swap_chain.h"
+#include "engine/vs_material_system.h"
+#include "engine/vs_simple_render_system.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace vs {
+struct cull_push_constant_data {
+  uint32_t object_count;
+  uint32_t compact;
+  uint32_t phase;
+  uint32_t draw_base;
+  uint32_t count_base;
+};
+
+static constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+vs_indirect_render_system::vs_indirect_render_system(
+    vs_device &device, int frames_in_flight, VkRenderPass render_pass,
+    VkRenderPass deferred_render_pass, VkDescriptorSetLayout global_set_layout,
+    const shader_permutation &permutation)
+    : device_(device), hiz_pyramid_(device),
+      compact_draws_(device.draw_indirect_count_supported) {
+  createFrameResources(frames_in_flight);
+  createPipelineLayouts(global_set_layout);
+  createPipelines(render_pass, deferred_render_pass, permutation);
+}
+
+vs_indirect_render_system::~vs_indirect_render_system() {
+  vkDestroyPipelineLayout(device_.device(), pipeline_layout_, nullptr);
+  vkDestroyPipelineLayout(device_.device(), cull_pipeline_layout_, nullptr);
+}
+
+void vs_indirect_render_system::createFrameResources(int frames_in_flight) {
+  instance_set_layout_ =
+      vs_descriptor_set_layout::vs_builder(device_)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_VERTEX_BIT)
+          .build();
+
+  cull_set_layout_ = vs_descriptor_set_layout::vs_builder(device_)
+                         .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .addBinding(8,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_COMPUTE_BIT)
+                         .build();
+
+  descriptor_pool_ =
+      vs_descriptor_pool::vs_builder(device_)
+          .setMaxSets(2 * frames_in_flight)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       8 * frames_in_flight)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                       frames_in_flight)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                       frames_in_flight)
+          .build();
+
+  // object data is written by the cpu every frame, draw commands and counts
+  // only ever live on the gpu. draws and counts hold both culling phases.
+  frames_.resize(frames_in_flight);
+  for (auto &frame : frames_) {
+    frame.instance_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(instance_data), MAX_OBJECTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.bounds_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(object_bounds), MAX_OBJECTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.mesh_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(mesh_data), MAX_MESHES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.draw_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(VkDrawIndexedIndirectCommand), 2 * MAX_OBJECTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.count_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(uint32_t), 2 * MAX_MESHES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.cull_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(cull_ubo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.retest_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(uint32_t), MAX_OBJECTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.stats_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(cull_stats), 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (frame.instance_buffer->map() != VK_SUCCESS ||
+        frame.bounds_buffer->map() != VK_SUCCESS ||
+        frame.mesh_buffer->map() != VK_SUCCESS ||
+        frame.cull_buffer->map() != VK_SUCCESS ||
+        frame.stats_buffer->map() != VK_SUCCESS) {
+      throw std::runtime_error("object buffers could not be mapped");
+    }
+    cull_stats empty_stats{};
+    frame.stats_buffer->writeToBuffer(&empty_stats);
+
+    auto instance_info = frame.instance_buffer->descriptorInfo();
+    auto bounds_info = frame.bounds_buffer->descriptorInfo();
+    auto mesh_info = frame.mesh_buffer->descriptorInfo();
+    auto draw_info = frame.draw_buffer->descriptorInfo();
+    auto count_info = frame.count_buffer->descriptorInfo();
+    auto cull_info = frame.cull_buffer->descriptorInfo();
+    auto retest_info = frame.retest_buffer->descriptorInfo();
+    auto stats_info = frame.stats_buffer->descriptorInfo();
+
+    vs_descriptor_writer(*instance_set_layout_, *descriptor_pool_)
+        .writeBuffer(0, &instance_info)
+        .build(frame.instance_descriptor_set);
+    vs_descriptor_writer(*cull_set_layout_, *descriptor_pool_)
+        .writeBuffer(0, &instance_info)
+        .writeBuffer(1, &bounds_info)
+        .writeBuffer(2, &mesh_info)
+        .writeBuffer(3, &draw_info)
+        .writeBuffer(4, &count_info)
+        .writeBuffer(5, &cull_info)
+        .writeBuffer(6, &retest_info)
+        .writeBuffer(7, &stats_info)
+        .build(frame.cull_descriptor_set);
+  }
+}
+
+void vs_indirect_render_system::createPipelineLayouts(
+    VkDescriptorSetLayout global_set_layout) {
+  // graphics, same shape as the simple render system so the instanced
+  // shaders can be shared.
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(instance_data);
+
+  std::vector<VkDescriptorSetLayout> descriptor_set_layouts{
+      global_set_layout, instance_set_layout_->getDescriptorSetLayout()};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount =
+      static_cast<uint32_t>(descriptor_set_layouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptor_set_layouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &push_constant_range;
+
+  if (vkCreatePipelineLayout(device_.device(), &pipelineLayoutInfo, nullptr,
+                             &pipeline_layout_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+
+  // culling
+  VkPushConstantRange cull_push_constant_range{};
+  cull_push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  cull_push_constant_range.offset = 0;
+  cull_push_constant_range.size = sizeof(cull_push_constant_data);
+
+  VkDescriptorSetLayout cull_set_layout =
+      cull_set_layout_->getDescriptorSetLayout();
+
+  VkPipelineLayoutCreateInfo cullLayoutInfo{};
+  cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  cullLayoutInfo.setLayoutCount = 1;
+  cullLayoutInfo.pSetLayouts = &cull_set_layout;
+  cullLayoutInfo.pushConstantRangeCount = 1;
+  cullLayoutInfo.pPushConstantRanges = &cull_push_constant_range;
+
+  if (vkCreatePipelineLayout(device_.device(), &cullLayoutInfo, nullptr,
+                             &cull_pipeline_layout_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create cull pipeline layout");
+  }
+}
+
+void vs_indirect_render_system::createPipelines(
+    VkRenderPass render_pass, VkRenderPass deferred_render_pass,
+    const shader_permutation &permutation) {
+  assert(pipeline_layout_ != nullptr &&
+         "cannont create pipeline before pipeline layout");
+
+  pipeline_config_info pipeline_config{};
+
+  vs_pipeline::defaultPipelineConfigInfo(pipeline_config, device_.msaa_samples,
+                                         true);
+  pipeline_config.render_pass = render_pass;
+  pipeline_config.pipeline_layout = pipeline_layout_;
+  pipeline_config.permutation = permutation;
+  pipeline_ = std::make_unique<vs_pipeline>(
+      device_, "shaders/simple_shader_instanced.vert.spv",
+      vs_material_system::fragmentShader(device_, "shaders/simple_shader"),
+      pipeline_config);
+
+  // same vertex stage, the fragment stage only fills the g-buffer.
+  std::array<VkPipelineColorBlendAttachmentState, 2> gbuffer_blend_attachments{
+      pipeline_config.color_blend_attachment,
+      pipeline_config.color_blend_attachment};
+  pipeline_config.color_blend_info.attachmentCount =
+      static_cast<uint32_t>(gbuffer_blend_attachments.size());
+  pipeline_config.color_blend_info.pAttachments =
+      gbuffer_blend_attachments.data();
+  pipeline_config.render_pass = deferred_render_pass;
+  pipeline_config.subpass = 0;
+  gbuffer_pipeline_ = std::make_unique<vs_pipeline>(
+      device_, "shaders/simple_shader_instanced.vert.spv",
+      vs_material_system::fragmentShader(device_, "shaders/gbuffer"),
+      pipeline_config);
+
+  cull_pipeline_ = std::make_unique<vs_pipeline>(
+      device_, "shaders/cull_objects.comp.spv", cull_pipeline_layout_);
+}
+
+void vs_indirect_render_system::cull(frame_info &frame_info,
+                                     vs_swap_chain &swap_chain) {
+  // cull_objects.comp writes first_instance = object index.
+  assert(device_.draw_indirect_first_instance_supported &&
+         "indirect draws need drawIndirectFirstInstance");
+  auto &frame = frames_[frame_info.frame_index];
+
+  // the frame that last used these buffers has completed.
+  auto *stats = static_cast<cull_stats *>(frame.stats_buffer->getMappedMemory());
+  last_stats_ = *stats;
+  last_stats_.occlusion_culled -= last_stats_.disoccluded;
+  *stats = cull_stats{};
+
+  if (hiz_pyramid_.resize(swap_chain)) {
+    auto hiz_info = hiz_pyramid_.descriptorInfo();
+    for (auto &f : frames_) {
+      vs_descriptor_writer(*cull_set_layout_, *descriptor_pool_)
+          .writeImage(8, &hiz_info)
+          .overwrite(f.cull_descriptor_set);
+    }
+  }
+
+  draws_.clear();
+  batches_.clear();
+  if (frame_info.visible_objects != nullptr) {
+    for (auto *object : *frame_info.visible_objects) {
+      draws_.emplace_back(object->model_comp.get(), object);
+    }
+  } else {
+    for (auto &kv : frame_info.game_objects) {
+      auto &object = kv.second;
+      if (object.model_comp == nullptr)
+        continue;
+      draws_.emplace_back(object.model_comp.get(), &object);
+    }
+  }
+
+  // indexed models first, grouped by model so every model owns one
+  // contiguous segment of draw commands. models without indices are rare and
+  // drawn directly after the indirect draws.
+  std::sort(draws_.begin(), draws_.end(),
+            [](const model_draw &a, const model_draw &b) {
+              if (a.first->hasIndexBuffer() != b.first->hasIndexBuffer())
+                return a.first->hasIndexBuffer();
+              return a.first < b.first;
+            });
+  if (draws_.size() > MAX_OBJECTS) {
+    draws_.resize(MAX_OBJECTS);
+  }
+
+  auto *instances =
+      static_cast<instance_data *>(frame.instance_buffer->getMappedMemory());
+  auto *bounds =
+      static_cast<object_bounds *>(frame.bounds_buffer->getMappedMemory());
+  auto *meshes = static_cast<mesh_data *>(frame.mesh_buffer->getMappedMemory());
+
+  culled_object_count_ = 0;
+  for (uint32_t i = 0; i < draws_.size(); ++i) {
+    auto *model = draws_[i].first;
+    auto &transform = draws_[i].second->transform_comp;
+    instances[i].model_matrix = transform.mat4();
+    instances[i].normal_matrix = transform.normal_matrix();
+    // material id in the spare corner, see vs_simple_render_system.
+    instances[i].normal_matrix[3][3] =
+        static_cast<float>(draws_[i].second->material_id);
+
+    if (!model->hasIndexBuffer())
+      continue;
+
+    if (batches_.empty() || batches_.back().model != model) {
+      if (batches_.size() == MAX_MESHES) {
+        draws_.resize(i);
+        break;
+      }
+      batches_.push_back({model, i, 0});
+    }
+    auto &batch = batches_.back();
+    ++batch.max_draws;
+
+    bounds[i].bounds_min = glm::vec4(model->getBounds().min, 0.f);
+    bounds[i].bounds_max = glm::vec4(model->getBounds().max, 0.f);
+    bounds[i].mesh =
+        glm::uvec4(static_cast<uint32_t>(batches_.size() - 1), 0, 0, 0);
+    culled_object_count_ = i + 1;
+  }
+
+  for (uint32_t i = 0; i < batches_.size(); ++i) {
+    meshes[i] = {batches_[i].model->getIndexCount(), batches_[i].draw_offset,
+                 batches_[i].max_draws, 0};
+  }
+
+  cull_ubo ubo{};
+  auto planes = frame_info.camera.getFrustumPlanes();
+  std::copy(planes.begin(), planes.end(), ubo.frustum_planes);
+  // the first phase uses the pyramid of the last frame, the second phase the
+  // one built from this frame's depth.
+  ubo.hiz_view_projection[0] = hiz_pyramid_.getViewProjection();
+  ubo.hiz_view_projection[1] =
+      frame_info.camera.getProjection() * frame_info.camera.getView();
+  ubo.hiz_size = {static_cast<float>(hiz_pyramid_.getExtent().width),
+                  static_cast<float>(hiz_pyramid_.getExtent().height),
+                  static_cast<float>(hiz_pyramid_.getMipLevels()), 0.f};
+  frame.cull_buffer->writeToBuffer(&ubo);
+
+  if (culled_object_count_ == 0)
+    return;
+
+  if (compact_draws_) {
+    vkCmdFillBuffer(frame_info.command_buffer, frame.count_buffer->getBuffer(),
+                    0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier clear_barrier{};
+    clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clear_barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(frame_info.command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &clear_barrier, 0, nullptr, 0, nullptr);
+  }
+
+  dispatchCull(frame_info, 0);
+}
+
+void vs_indirect_render_system::cullDisoccluded(frame_info &frame_info,
+                                                vs_swap_chain &swap_chain,
+                                                uint32_t image_index) {
+  hiz_pyramid_.build(frame_info.command_buffer, swap_chain, image_index,
+                     frame_info.camera.getProjection() *
+                         frame_info.camera.getView());
+
+  if (culled_object_count_ == 0)
+    return;
+
+  // retest flags written by the first phase.
+  VkMemoryBarrier retest_barrier{};
+  retest_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  retest_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  retest_barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(frame_info.command_buffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &retest_barrier, 0, nullptr, 0, nullptr);
+
+  dispatchCull(frame_info, 1);
+
+  // counters are read back by the cpu once the frame has completed.
+  VkMemoryBarrier stats_barrier{};
+  stats_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  stats_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  stats_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(frame_info.command_buffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &stats_barrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+void vs_indirect_render_system::dispatchCull(frame_info &frame_info,
+                                             uint32_t phase) {
+  auto &frame = frames_[frame_info.frame_index];
+
+  cull_pipeline_->bind(frame_info.command_buffer);
+  vkCmdBindDescriptorSets(frame_info.command_buffer,
+                          VK_PIPELINE_BIND_POINT_COMPUTE,
+                          cull_pipeline_layout_, 0, 1,
+                          &frame.cull_descriptor_set, 0, nullptr);
+
+  cull_push_constant_data push{};
+  push.object_count = culled_object_count_;
+  push.compact = compact_draws_ ? 1 : 0;
+  push.phase = phase;
+  push.draw_base = phase * MAX_OBJECTS;
+  push.count_base = phase * MAX_MESHES;
+  vkCmdPushConstants(frame_info.command_buffer, cull_pipeline_layout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(cull_push_constant_data), &push);
+
+  vkCmdDispatch(frame_info.command_buffer,
+                (culled_object_count_ + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE,
+                1, 1);
+
+  VkMemoryBarrier draw_barrier{};
+  draw_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  draw_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  draw_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(frame_info.command_buffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+                       &draw_barrier, 0, nullptr, 0, nullptr);
+}
+
+void vs_indirect_render_system::renderGameObjects(frame_info &frame_info,
+                                                  render_path path) {
+  recordDraws(frame_info, 0, path);
+}
+
+void vs_indirect_render_system::renderDisoccluded(frame_info &frame_info,
+                                                  render_path path) {
+  recordDraws(frame_info, 1, path);
+}
+
+void vs_indirect_render_system::recordDraws(frame_info &frame_info,
+                                            uint32_t phase, render_path path) {
+  if (draws_.empty())
+    return;
+
+  auto &frame = frames_[frame_info.frame_index];
+
+  if (path == render_path::deferred) {
+    gbuffer_pipeline_->bind(frame_info.command_buffer);
+  } else {
+    pipeline_->bind(frame_info.command_buffer);
+  }
+
+  VkDescriptorSet descriptor_sets[] = {frame_info.global_descriptor_set,
+                                       frame.instance_descriptor_set};
+  vkCmdBindDescriptorSets(frame_info.command_buffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0,
+                          2, descriptor_sets, 0, nullptr);
+
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  VkBuffer draw_buffer = frame.draw_buffer->getBuffer();
+
+  for (uint32_t i = 0; i < batches_.size(); ++i) {
+    auto &batch = batches_[i];
+    VkDeviceSize offset =
+        static_cast<VkDeviceSize>(phase * MAX_OBJECTS + batch.draw_offset) *
+        stride;
+
+    batch.model->bind(frame_info.command_buffer);
+    if (compact_draws_) {
+      vkCmdDrawIndexedIndirectCount(
+          frame_info.command_buffer, draw_buffer, offset,
+          frame.count_buffer->getBuffer(),
+          (phase * MAX_MESHES + i) * sizeof(uint32_t), batch.max_draws,
+          stride);
+    } else if (device_.multi_draw_indirect_supported) {
+      vkCmdDrawIndexedIndirect(frame_info.command_buffer, draw_buffer, offset,
+                               batch.max_draws, stride);
+    } else {
+      for (uint32_t draw = 0; draw < batch.max_draws; ++draw) {
+        vkCmdDrawIndexedIndirect(frame_info.command_buffer, draw_buffer,
+                                 offset + draw * stride, 1, stride);
+      }
+    }
+  }
+
+  if (phase != 0)
+    return;
+
+  // models without indices, not culled.
+  for (uint32_t i = culled_object_count_; i < draws_.size(); ++i) {
+    draws_[i].first->bind(frame_info.command_buffer);
+    draws_[i].first->draw(frame_info.command_buffer, 1, i);
+  }
+}
+} // namespace vs
@@ -0,0 +1,142 @@
+﻿#pragma once
+
+
+#include <memory>
+
+#include <utility>
+#include <vector>
+
+#include "engine/renderer/vs_buffer.h"
+#include "engine/renderer/vs_descriptors.h"
+#include "engine/renderer/vs_device.h"
+#include "engine/renderer/vs_hiz_pyramid.h"
+#include "engine/renderer/vs_pipeline.h"
+#include "engine/renderer/vs_swap_chain.h"
+#include "engine/vs_frame_info.h"
+
+
+namespace vs
+{
+	// gpu driven renderer, a compute pass culls every object against the camera frustum and writes
+	// the indirect draw commands, the cpu only records one indirect draw per model.
+	// occlusion culling runs in two phases against a hi-z pyramid of the depth buffer:
+	// the first phase tests against last frame's pyramid and draws what passes, the pyramid is
+	// then rebuilt from that depth and the second phase retests the objects the first one rejected.
+	class vs_indirect_render_system
+	{
+	public:
+		static constexpr uint32_t MAX_OBJECTS = 65536;
+		static constexpr uint32_t MAX_MESHES = 1024;
+
+		// results of the last completed frame.
+		struct cull_stats
+		{
+			uint32_t frustum_culled = 0;
+			uint32_t occlusion_culled = 0; // hidden after both phases
+			uint32_t visible = 0; // drawn by the first phase
+			uint32_t disoccluded = 0; // drawn by the second phase
+		};
+
+		// deferred_render_pass gets a second pipeline writing the g-buffer in its first subpass.
+		vs_indirect_render_system(vs_device& device, int frames_in_flight, VkRenderPass render_pass,
+		                          VkRenderPass deferred_render_pass, VkDescriptorSetLayout global_set_layout,
+		                          const shader_permutation& permutation);
+		~vs_indirect_render_system();
+
+
+		vs_indirect_render_system(const vs_indirect_render_system&) = delete;
+		vs_indirect_render_system& operator==(const vs_indirect_render_system&) = delete;
+
+		// uploads the object list and records the first culling phase, call before the render pass begins.
+		void cull(frame_info& frame_info, vs_swap_chain& swap_chain);
+		// draws what the first phase found visible, call inside the render pass of path.
+		void renderGameObjects(frame_info& frame_info, render_path path = render_path::forward);
+		// builds the hi-z pyramid from the depth of image_index and records the second culling phase,
+		// call after the render pass has ended.
+		void cullDisoccluded(frame_info& frame_info, vs_swap_chain& swap_chain, uint32_t image_index);
+		// draws what the second phase found visible, call inside a render pass that loads the first one's contents.
+		void renderDisoccluded(frame_info& frame_info, render_path path = render_path::forward);
+
+		const cull_stats& getCullStats() const { return last_stats_; }
+
+
+	private:
+		using model_draw = std::pair<vs_model_component*, vs_game_object*>;
+
+		// layouts match cull_objects.comp
+		struct object_bounds
+		{
+			glm::vec4 bounds_min{0.f};
+			glm::vec4 bounds_max{0.f};
+			glm::uvec4 mesh{0};
+		};
+
+		struct mesh_data
+		{
+			uint32_t index_count;
+			uint32_t draw_offset;
+			uint32_t max_draws;
+			uint32_t padding;
+		};
+
+		struct cull_ubo
+		{
+			glm::vec4 frustum_planes[6];
+			glm::mat4 hiz_view_projection[2];
+			glm::vec4 hiz_size{0.f};
+		};
+
+		struct mesh_batch
+		{
+			vs_model_component* model;
+			uint32_t draw_offset;
+			uint32_t max_draws;
+		};
+
+		struct frame_resources
+		{
+			std::unique_ptr<vs_buffer> instance_buffer;
+			std::unique_ptr<vs_buffer> bounds_buffer;
+			std::unique_ptr<vs_buffer> mesh_buffer;
+			std::unique_ptr<vs_buffer> draw_buffer;
+			std::unique_ptr<vs_buffer> count_buffer;
+			std::unique_ptr<vs_buffer> cull_buffer;
+			std::unique_ptr<vs_buffer> retest_buffer;
+			std::unique_ptr<vs_buffer> stats_buffer;
+			VkDescriptorSet instance_descriptor_set;
+			VkDescriptorSet cull_descriptor_set;
+		};
+
+		void createFrameResources(int frames_in_flight);
+		void createPipelineLayouts(VkDescriptorSetLayout global_set_layout);
+		void createPipelines(VkRenderPass render_pass, VkRenderPass deferred_render_pass,
+		                     const shader_permutation& permutation);
+
+		void dispatchCull(frame_info& frame_info, uint32_t phase);
+		void recordDraws(frame_info& frame_info, uint32_t phase, render_path path);
+
+
+		vs_device& device_;
+		std::unique_ptr<vs_pipeline> pipeline_;
+		std::unique_ptr<vs_pipeline> gbuffer_pipeline_;
+		std::unique_ptr<vs_pipeline> cull_pipeline_;
+		VkPipelineLayout pipeline_layout_;
+		VkPipelineLayout cull_pipeline_layout_;
+
+		std::unique_ptr<vs_descriptor_set_layout> instance_set_layout_;
+		std::unique_ptr<vs_descriptor_set_layout> cull_set_layout_;
+		std::unique_ptr<vs_descriptor_pool> descriptor_pool_;
+		std::vector<frame_resources> frames_;
+
+		vs_hiz_pyramid hiz_pyramid_;
+		cull_stats last_stats_{};
+
+		// when the count buffer can't be used every object keeps its slot and culled ones get zero instances.
+		bool compact_draws_ = false;
+
+		// filled by cull() and consumed by renderGameObjects() in the same frame.
+		std::vector<model_draw> draws_;
+		std::vector<mesh_batch> batches_;
+		uint32_t culled_object_count_ = 0;
+	};
+}
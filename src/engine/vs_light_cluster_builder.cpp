@@ -0,0 +1,334 @@
+﻿#include "vs_light_cluster_builder.h"
+#include "vs_thread_pool.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VS_CLUSTER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VS_CLUSTER_SSE
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace vs {
+static_assert(vs_light_cluster_builder::GRID_X <= 32,
+              "rows of clusters are tested into 32 bit masks");
+
+// tiles covered by the ndc range [ndc_min, ndc_max], false when it misses the
+// screen.
+static bool tileRange(float ndc_min, float ndc_max, uint32_t tile_count,
+                      uint32_t &min_tile, uint32_t &max_tile) {
+  if (ndc_max < -1.f || ndc_min > 1.f)
+    return false;
+  const float scale = 0.5f * static_cast<float>(tile_count);
+  const float last = static_cast<float>(tile_count - 1);
+  min_tile = static_cast<uint32_t>(
+      std::clamp(std::floor((ndc_min + 1.f) * scale), 0.f, last));
+  max_tile = static_cast<uint32_t>(
+      std::clamp(std::floor((ndc_max + 1.f) * scale), 0.f, last));
+  return true;
+}
+
+vs_light_cluster_builder::vs_light_cluster_builder(
+    uint32_t max_light_indices, vs_thread_pool *thread_pool)
+    : max_light_indices_(max_light_indices), thread_pool_(thread_pool) {
+  box_min_x_.resize(CLUSTER_COUNT);
+  box_min_y_.resize(CLUSTER_COUNT);
+  box_min_z_.resize(CLUSTER_COUNT);
+  box_max_x_.resize(CLUSTER_COUNT);
+  box_max_y_.resize(CLUSTER_COUNT);
+  box_max_z_.resize(CLUSTER_COUNT);
+  slices_.resize(GRID_Z);
+  clusters_.assign(CLUSTER_COUNT, cluster{0, 0});
+  light_indices_.reserve(max_light_indices_);
+}
+
+void vs_light_cluster_builder::setProjection(const glm::mat4 &projection) {
+  if (projection == projection_)
+    return;
+  projection_ = projection;
+
+  // inverse of the depth terms of vs_camera::setPerspectiveProjection.
+  near_ = -projection[3][2] / projection[2][2];
+  far_ = projection[3][2] / (1.f - projection[2][2]);
+
+  const float slices = static_cast<float>(GRID_Z);
+  const float log_depth_range = std::log(far_ / near_);
+  depth_scale_bias_ = {slices / log_depth_range,
+                       -slices * std::log(near_) / log_depth_range};
+  updateClusterBoxes();
+}
+
+void vs_light_cluster_builder::updateClusterBoxes() {
+  // view space x / z and y / z of the ndc tile borders.
+  float ratio_x[GRID_X + 1];
+  float ratio_y[GRID_Y + 1];
+  for (uint32_t x = 0; x <= GRID_X; ++x) {
+    const float ndc = -1.f + 2.f * static_cast<float>(x) / GRID_X;
+    ratio_x[x] = (ndc - projection_[2][0]) / projection_[0][0];
+  }
+  for (uint32_t y = 0; y <= GRID_Y; ++y) {
+    const float ndc = -1.f + 2.f * static_cast<float>(y) / GRID_Y;
+    ratio_y[y] = (ndc - projection_[2][1]) / projection_[1][1];
+  }
+
+  for (uint32_t z = 0; z < GRID_Z; ++z) {
+    const float depth_near =
+        near_ * std::pow(far_ / near_, static_cast<float>(z) / GRID_Z);
+    const float depth_far =
+        near_ * std::pow(far_ / near_, static_cast<float>(z + 1) / GRID_Z);
+    for (uint32_t y = 0; y < GRID_Y; ++y) {
+      for (uint32_t x = 0; x < GRID_X; ++x) {
+        const uint32_t index = clusterIndex(x, y, z);
+        const float corners_x[4] = {
+            ratio_x[x] * depth_near, ratio_x[x] * depth_far,
+            ratio_x[x + 1] * depth_near, ratio_x[x + 1] * depth_far};
+        const float corners_y[4] = {
+            ratio_y[y] * depth_near, ratio_y[y] * depth_far,
+            ratio_y[y + 1] * depth_near, ratio_y[y + 1] * depth_far};
+        box_min_x_[index] = *std::min_element(corners_x, corners_x + 4);
+        box_max_x_[index] = *std::max_element(corners_x, corners_x + 4);
+        box_min_y_[index] = *std::min_element(corners_y, corners_y + 4);
+        box_max_y_[index] = *std::max_element(corners_y, corners_y + 4);
+        box_min_z_[index] = depth_near;
+        box_max_z_[index] = depth_far;
+      }
+    }
+  }
+}
+
+void vs_light_cluster_builder::clear() {
+  light_x_.clear();
+  light_y_.clear();
+  light_z_.clear();
+  light_range_.clear();
+}
+
+void vs_light_cluster_builder::addLight(const glm::vec3 &view_position,
+                                        float range) {
+  light_x_.push_back(view_position.x);
+  light_y_.push_back(view_position.y);
+  light_z_.push_back(view_position.z);
+  light_range_.push_back(range);
+}
+
+uint32_t vs_light_cluster_builder::sliceOfDepth(float depth) const {
+  if (depth <= near_)
+    return 0;
+  const float slice =
+      std::floor(std::log(depth) * depth_scale_bias_.x + depth_scale_bias_.y);
+  return static_cast<uint32_t>(
+      std::clamp(slice, 0.f, static_cast<float>(GRID_Z - 1)));
+}
+
+bool vs_light_cluster_builder::computeLightBounds(
+    uint32_t light, light_bounds &bounds) const {
+  const float x = light_x_[light];
+  const float y = light_y_[light];
+  const float z = light_z_[light];
+  const float range = light_range_[light];
+  if (z + range < near_ || z - range > far_)
+    return false;
+
+  // the box around the sphere cut at the near plane, its projection is
+  // spanned by the corners since x / z is monotonic in both.
+  const float depth_min = std::max(z - range, near_);
+  const float depth_max = z + range;
+  const float ratio_min_x =
+      std::min((x - range) / depth_min, (x - range) / depth_max);
+  const float ratio_max_x =
+      std::max((x + range) / depth_min, (x + range) / depth_max);
+  const float ratio_min_y =
+      std::min((y - range) / depth_min, (y - range) / depth_max);
+  const float ratio_max_y =
+      std::max((y + range) / depth_min, (y + range) / depth_max);
+
+  const float ndc_x[2] = {
+      projection_[0][0] * ratio_min_x + projection_[2][0],
+      projection_[0][0] * ratio_max_x + projection_[2][0]};
+  const float ndc_y[2] = {
+      projection_[1][1] * ratio_min_y + projection_[2][1],
+      projection_[1][1] * ratio_max_y + projection_[2][1]};
+  if (!tileRange(std::min(ndc_x[0], ndc_x[1]), std::max(ndc_x[0], ndc_x[1]),
+                 GRID_X, bounds.min_x, bounds.max_x) ||
+      !tileRange(std::min(ndc_y[0], ndc_y[1]), std::max(ndc_y[0], ndc_y[1]),
+                 GRID_Y, bounds.min_y, bounds.max_y)) {
+    return false;
+  }
+  bounds.min_z = sliceOfDepth(depth_min);
+  bounds.max_z = sliceOfDepth(depth_max);
+  return true;
+}
+
+void vs_light_cluster_builder::build() {
+  const uint32_t light_count = getLightCount();
+  light_bounds_.resize(light_count);
+  for (auto &slice : slices_) {
+    slice.lights.clear();
+  }
+  // lights go to the slices in ascending order, which keeps every cluster's
+  // list sorted.
+  for (uint32_t light = 0; light < light_count; ++light) {
+    auto &bounds = light_bounds_[light];
+    if (!computeLightBounds(light, bounds))
+      continue;
+    for (uint32_t z = bounds.min_z; z <= bounds.max_z; ++z) {
+      slices_[z].lights.push_back(light);
+    }
+  }
+
+  if (thread_pool_ != nullptr) {
+    thread_pool_->parallelFor(GRID_Z,
+                              [this](uint32_t z, uint32_t) { buildSlice(z); });
+  } else {
+    for (uint32_t z = 0; z < GRID_Z; ++z) {
+      buildSlice(z);
+    }
+  }
+
+  // slices are appended in cluster order, whatever doesn't fit is dropped.
+  light_indices_.clear();
+  dropped_count_ = 0;
+  for (uint32_t z = 0; z < GRID_Z; ++z) {
+    const auto &slice = slices_[z];
+    uint32_t slice_offset = 0;
+    for (uint32_t c = 0; c < GRID_X * GRID_Y; ++c) {
+      const uint32_t count = slice.counts[c];
+      const uint32_t offset = static_cast<uint32_t>(light_indices_.size());
+      const uint32_t kept = std::min(count, max_light_indices_ - offset);
+      light_indices_.insert(light_indices_.end(),
+                            slice.indices.begin() + slice_offset,
+                            slice.indices.begin() + slice_offset + kept);
+      clusters_[z * GRID_X * GRID_Y + c] = {offset, kept};
+      dropped_count_ += count - kept;
+      slice_offset += count;
+    }
+  }
+}
+
+void vs_light_cluster_builder::buildSlice(uint32_t z) {
+  auto &slice = slices_[z];
+  slice.hits.clear();
+  slice.counts.assign(GRID_X * GRID_Y, 0);
+
+  for (uint32_t light : slice.lights) {
+    const auto &bounds = light_bounds_[light];
+    for (uint32_t y = bounds.min_y; y <= bounds.max_y; ++y) {
+      const uint32_t mask =
+          testRow(light, z * GRID_Y + y, bounds.min_x, bounds.max_x);
+      if (mask == 0)
+        continue;
+      slice.hits.push_back({light, y, mask});
+      for (uint32_t x = bounds.min_x; x <= bounds.max_x; ++x) {
+        if (mask & (1u << x))
+          ++slice.counts[y * GRID_X + x];
+      }
+    }
+  }
+
+  // exclusive prefix sum gives every cluster its write cursor.
+  auto &cursors = slice.cursors;
+  cursors.resize(GRID_X * GRID_Y);
+  uint32_t total = 0;
+  for (uint32_t c = 0; c < GRID_X * GRID_Y; ++c) {
+    cursors[c] = total;
+    total += slice.counts[c];
+  }
+  slice.indices.resize(total);
+  for (const auto &hit : slice.hits) {
+    for (uint32_t x = 0; x < GRID_X; ++x) {
+      if (hit.mask & (1u << x))
+        slice.indices[cursors[hit.y * GRID_X + x]++] = hit.light;
+    }
+  }
+}
+
+uint32_t vs_light_cluster_builder::testRow(uint32_t light, uint32_t row,
+                                           uint32_t min_x,
+                                           uint32_t max_x) const {
+  const float *min_x_row = &box_min_x_[row * GRID_X];
+  const float *min_y_row = &box_min_y_[row * GRID_X];
+  const float *min_z_row = &box_min_z_[row * GRID_X];
+  const float *max_x_row = &box_max_x_[row * GRID_X];
+  const float *max_y_row = &box_max_y_[row * GRID_X];
+  const float *max_z_row = &box_max_z_[row * GRID_X];
+  const float range_squared = light_range_[light] * light_range_[light];
+  uint32_t mask = 0;
+  uint32_t x = 0;
+
+  // distance from the sphere center to the box, per axis the larger of the
+  // two plane distances clamped to zero.
+#if defined(VS_CLUSTER_AVX2)
+  const __m256 cx = _mm256_set1_ps(light_x_[light]);
+  const __m256 cy = _mm256_set1_ps(light_y_[light]);
+  const __m256 cz = _mm256_set1_ps(light_z_[light]);
+  const __m256 r2 = _mm256_set1_ps(range_squared);
+  const __m256 zero = _mm256_setzero_ps();
+  for (x = min_x & ~7u; x + 8 <= GRID_X && x <= max_x; x += 8) {
+    const __m256 dx = _mm256_max_ps(
+        _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(min_x_row + x), cx),
+                      _mm256_sub_ps(cx, _mm256_loadu_ps(max_x_row + x))),
+        zero);
+    const __m256 dy = _mm256_max_ps(
+        _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(min_y_row + x), cy),
+                      _mm256_sub_ps(cy, _mm256_loadu_ps(max_y_row + x))),
+        zero);
+    const __m256 dz = _mm256_max_ps(
+        _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(min_z_row + x), cz),
+                      _mm256_sub_ps(cz, _mm256_loadu_ps(max_z_row + x))),
+        zero);
+    const __m256 distance_squared = _mm256_fmadd_ps(
+        dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+    mask |= static_cast<uint32_t>(_mm256_movemask_ps(
+                _mm256_cmp_ps(distance_squared, r2, _CMP_LE_OQ)))
+            << x;
+  }
+#elif defined(VS_CLUSTER_SSE)
+  const __m128 cx = _mm_set1_ps(light_x_[light]);
+  const __m128 cy = _mm_set1_ps(light_y_[light]);
+  const __m128 cz = _mm_set1_ps(light_z_[light]);
+  const __m128 r2 = _mm_set1_ps(range_squared);
+  const __m128 zero = _mm_setzero_ps();
+  for (x = min_x & ~3u; x + 4 <= GRID_X && x <= max_x; x += 4) {
+    const __m128 dx =
+        _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_x_row + x), cx),
+                              _mm_sub_ps(cx, _mm_loadu_ps(max_x_row + x))),
+                   zero);
+    const __m128 dy =
+        _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_y_row + x), cy),
+                              _mm_sub_ps(cy, _mm_loadu_ps(max_y_row + x))),
+                   zero);
+    const __m128 dz =
+        _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_z_row + x), cz),
+                              _mm_sub_ps(cz, _mm_loadu_ps(max_z_row + x))),
+                   zero);
+    const __m128 distance_squared =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                   _mm_mul_ps(dz, dz));
+    mask |= static_cast<uint32_t>(
+                _mm_movemask_ps(_mm_cmple_ps(distance_squared, r2)))
+            << x;
+  }
+#endif
+
+  // scalar reference, also used for the tail that doesn't fill a simd
+  // register.
+  for (x = std::max(x, min_x); x <= max_x; ++x) {
+    const float dx = std::max(
+        {min_x_row[x] - light_x_[light], light_x_[light] - max_x_row[x], 0.f});
+    const float dy = std::max(
+        {min_y_row[x] - light_y_[light], light_y_[light] - max_y_row[x], 0.f});
+    const float dz = std::max(
+        {min_z_row[x] - light_z_[light], light_z_[light] - max_z_row[x], 0.f});
+    if (dx * dx + dy * dy + dz * dz <= range_squared)
+      mask |= 1u << x;
+  }
+
+  // the simd loops test whole registers, keep the tiles of the light's bounds.
+  const uint32_t high = max_x + 1 >= 32 ? ~0u : (1u << (max_x + 1)) - 1u;
+  return mask & high & ~((1u << min_x) - 1u);
+}
+} // namespace vs
@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+
+namespace vs
+{
+	class vs_thread_pool;
+
+	// assigns point lights to the froxels of the view frustum for clustered shading, no vulkan involved.
+	// the screen is split into GRID_X * GRID_Y tiles and the depth into GRID_Z slices growing
+	// exponentially from the near to the far plane. every slice is built by one worker, lights are
+	// tested against 8 (avx2) or 4 (sse) cluster boxes of a row at a time.
+	// clusters are indexed (z * GRID_Y + y) * GRID_X + x, tile 0 is the top left of the screen.
+	class vs_light_cluster_builder
+	{
+	public:
+		static constexpr uint32_t GRID_X = 16;
+		static constexpr uint32_t GRID_Y = 9;
+		static constexpr uint32_t GRID_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+		// range into getLightIndices(), matches the uvec2 of the shaders.
+		struct cluster
+		{
+			uint32_t offset;
+			uint32_t count;
+		};
+
+		// lists longer than max_light_indices in total are cut off. without a thread pool every slice
+		// runs on the calling thread.
+		explicit vs_light_cluster_builder(uint32_t max_light_indices, vs_thread_pool* thread_pool = nullptr);
+
+		vs_light_cluster_builder(const vs_light_cluster_builder&) = delete;
+		vs_light_cluster_builder& operator==(const vs_light_cluster_builder&) = delete;
+
+		// perspective projection as set by vs_camera::setPerspectiveProjection, the cluster boxes are
+		// only rebuilt when it changed.
+		void setProjection(const glm::mat4& projection);
+
+		// drops the lights of the last frame.
+		void clear();
+		// view space sphere, the light's index in the lists is the order it was added in.
+		void addLight(const glm::vec3& view_position, float range);
+		void build();
+
+		const std::vector<cluster>& getClusters() const { return clusters_; }
+		const std::vector<uint32_t>& getLightIndices() const { return light_indices_; }
+		// slice of a view space depth is floor(log(depth) * x + y).
+		glm::vec2 getDepthScaleBias() const { return depth_scale_bias_; }
+		float getNear() const { return near_; }
+		float getFar() const { return far_; }
+		uint32_t getLightCount() const { return static_cast<uint32_t>(light_x_.size()); }
+		// light references lost to the max_light_indices limit in the last build.
+		uint32_t getDroppedCount() const { return dropped_count_; }
+
+		static uint32_t clusterIndex(uint32_t x, uint32_t y, uint32_t z) { return (z * GRID_Y + y) * GRID_X + x; }
+
+	private:
+		// clusters of a row the light touches, bit x for tile x.
+		struct row_hit
+		{
+			uint32_t light;
+			uint32_t y;
+			uint32_t mask;
+		};
+
+		struct slice_lists
+		{
+			std::vector<uint32_t> lights;
+			std::vector<row_hit> hits;
+			std::vector<uint32_t> counts;
+			std::vector<uint32_t> cursors;
+			std::vector<uint32_t> indices;
+		};
+
+		struct light_bounds
+		{
+			uint32_t min_x, max_x, min_y, max_y, min_z, max_z;
+		};
+
+		void updateClusterBoxes();
+		// false when the sphere misses the frustum.
+		bool computeLightBounds(uint32_t light, light_bounds& bounds) const;
+		uint32_t sliceOfDepth(float depth) const;
+		void buildSlice(uint32_t z);
+		uint32_t testRow(uint32_t light, uint32_t row, uint32_t min_x, uint32_t max_x) const;
+
+		uint32_t max_light_indices_;
+		vs_thread_pool* thread_pool_;
+
+		glm::mat4 projection_{0.f};
+		float near_ = 0.f;
+		float far_ = 0.f;
+		glm::vec2 depth_scale_bias_{0.f};
+
+		// view space boxes of the clusters, structure of arrays in cluster order.
+		std::vector<float> box_min_x_;
+		std::vector<float> box_min_y_;
+		std::vector<float> box_min_z_;
+		std::vector<float> box_max_x_;
+		std::vector<float> box_max_y_;
+		std::vector<float> box_max_z_;
+
+		std::vector<float> light_x_;
+		std::vector<float> light_y_;
+		std::vector<float> light_z_;
+		std::vector<float> light_range_;
+		std::vector<light_bounds> light_bounds_;
+
+		std::vector<slice_lists> slices_;
+		std::vector<cluster> clusters_;
+		std::vector<uint32_t> light_indices_;
+		uint32_t dropped_count_ = 0;
+	};
+}
@@ -0,0 +1,133 @@
+﻿#include "vs_light_cluster_system.h"
+#include "vs_thread_pool.h"
+
+// std
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace vs {
+vs_light_cluster_system::vs_light_cluster_system(vs_device &device,
+                                                 int frames_in_flight,
+                                                 vs_thread_pool &thread_pool)
+    : device_(device), builder_(MAX_LIGHT_INDICES, &thread_pool) {
+  // written by the cpu every frame, one set per frame in flight.
+  frames_.resize(frames_in_flight);
+  for (auto &frame : frames_) {
+    frame.light_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(point_light), MAX_LIGHTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.cluster_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(vs_light_cluster_builder::cluster),
+        vs_light_cluster_builder::CLUSTER_COUNT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.light_index_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(uint32_t), MAX_LIGHT_INDICES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (frame.light_buffer->map() != VK_SUCCESS ||
+        frame.cluster_buffer->map() != VK_SUCCESS ||
+        frame.light_index_buffer->map() != VK_SUCCESS) {
+      throw std::runtime_error("light cluster buffers could not be mapped");
+    }
+    // empty clusters until the first update.
+    std::memset(frame.cluster_buffer->getMappedMemory(), 0,
+                frame.cluster_buffer->getBufferSize());
+  }
+  lights_.reserve(MAX_LIGHTS);
+}
+
+float vs_light_cluster_system::lightRange(float intensity) {
+  return std::sqrt(intensity / LIGHT_CUTOFF);
+}
+
+void vs_light_cluster_system::update(const frame_info &frame_info,
+                                     VkExtent2D extent, global_ubo &ubo) {
+  const glm::mat4 view = frame_info.camera.getView();
+  const auto planes = frame_info.camera.getFrustumPlanes();
+  builder_.setProjection(frame_info.camera.getProjection());
+  builder_.clear();
+  lights_.clear();
+  culled_count_ = 0;
+
+  for (auto &kv : frame_info.lights) {
+    auto &obj = kv.second;
+    if (lights_.size() == MAX_LIGHTS)
+      break;
+
+    const float intensity = obj.point_light_comp->light_intensity;
+    const glm::vec3 &position = obj.transform_comp.getTranslation();
+    // the billboard lies within the range, so one sphere test covers both.
+    const float range = glm::max(lightRange(intensity),
+                                 obj.transform_comp.getScale().x);
+    bool visible = true;
+    for (const auto &plane : planes) {
+      if (glm::dot(glm::vec3(plane), position) + plane.w < -range)
+        visible = false;
+    }
+    if (!visible) {
+      ++culled_count_;
+      continue;
+    }
+
+    point_light light{};
+    light.position = glm::vec4(position, range);
+    light.color = glm::vec4(obj.color, intensity);
+    light.radius = obj.transform_comp.getScale().x;
+    light.shadow_index = obj.point_light_comp->shadow_index;
+    lights_.push_back(light);
+    builder_.addLight(glm::vec3(view * glm::vec4(position, 1.f)), range);
+  }
+  builder_.build();
+
+  auto &frame = frames_[frame_info.frame_index];
+  const auto &clusters = builder_.getClusters();
+  const auto &indices = builder_.getLightIndices();
+  std::memcpy(frame.light_buffer->getMappedMemory(), lights_.data(),
+              lights_.size() * sizeof(point_light));
+  std::memcpy(frame.cluster_buffer->getMappedMemory(), clusters.data(),
+              clusters.size() * sizeof(vs_light_cluster_builder::cluster));
+  std::memcpy(frame.light_index_buffer->getMappedMemory(), indices.data(),
+              indices.size() * sizeof(uint32_t));
+
+  updateParameters(frame_info, extent, static_cast<uint32_t>(lights_.size()),
+                   ubo);
+}
+
+void vs_light_cluster_system::updateParameters(const frame_info &frame_info,
+                                               VkExtent2D extent,
+                                               uint32_t light_count,
+                                               global_ubo &ubo) {
+  builder_.setProjection(frame_info.camera.getProjection());
+  ubo.cluster_grid = {vs_light_cluster_builder::GRID_X,
+                      vs_light_cluster_builder::GRID_Y,
+                      vs_light_cluster_builder::GRID_Z, light_count};
+  const glm::vec2 depth_scale_bias = builder_.getDepthScaleBias();
+  ubo.cluster_depth = {depth_scale_bias.x, depth_scale_bias.y, 0.f, 0.f};
+  ubo.viewport = {static_cast<float>(extent.width),
+                  static_cast<float>(extent.height),
+                  1.f / static_cast<float>(extent.width),
+                  1.f / static_cast<float>(extent.height)};
+}
+
+VkDescriptorBufferInfo
+vs_light_cluster_system::lightsDescriptorInfo(int frame_index) {
+  return frames_[frame_index].light_buffer->descriptorInfo();
+}
+
+VkDescriptorBufferInfo
+vs_light_cluster_system::clustersDescriptorInfo(int frame_index) {
+  return frames_[frame_index].cluster_buffer->descriptorInfo();
+}
+
+VkDescriptorBufferInfo
+vs_light_cluster_system::lightIndicesDescriptorInfo(int frame_index) {
+  return frames_[frame_index].light_index_buffer->descriptorInfo();
+}
+} // namespace vs
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "engine/renderer/vs_buffer.h"
+#include "engine/renderer/vs_device.h"
+#include "engine/vs_frame_info.h"
+#include "engine/vs_light_cluster_builder.h"
+
+
+namespace vs
+{
+	class vs_thread_pool;
+
+	// clustered forward lighting, every frame the point lights are assigned to the froxels of the
+	// camera on the worker threads and uploaded to storage buffers of the frame in flight. the
+	// fragment shader finds its cluster from gl_FragCoord and the view depth and only shades the
+	// lights listed there, so the cost per pixel stays flat with thousands of lights.
+	// lights whose range misses the camera frustum are dropped before the upload.
+	class vs_light_cluster_system
+	{
+	public:
+		static constexpr uint32_t MAX_LIGHTS = 4096;
+		static constexpr uint32_t MAX_LIGHT_INDICES = 256 * 1024;
+		// lights are cut off where 1 / d^2 falls below this fraction of their intensity.
+		static constexpr float LIGHT_CUTOFF = 0.01f;
+
+		vs_light_cluster_system(vs_device& device, int frames_in_flight, vs_thread_pool& thread_pool);
+
+		vs_light_cluster_system(const vs_light_cluster_system&) = delete;
+		vs_light_cluster_system& operator==(const vs_light_cluster_system&) = delete;
+
+		// culls and clusters frame_info.lights and uploads them to the buffers of frame_info.frame_index,
+		// the cluster parameters and light count are written to ubo.
+		void update(const frame_info& frame_info, VkExtent2D extent, global_ubo& ubo);
+		// only writes the cluster parameters to ubo, for when the buffers are filled on the gpu.
+		void updateParameters(const frame_info& frame_info, VkExtent2D extent, uint32_t light_count,
+		                      global_ubo& ubo);
+
+		// bindings 2, 3 and 4 of the global set.
+		VkDescriptorBufferInfo lightsDescriptorInfo(int frame_index);
+		VkDescriptorBufferInfo clustersDescriptorInfo(int frame_index);
+		VkDescriptorBufferInfo lightIndicesDescriptorInfo(int frame_index);
+
+		const vs_light_cluster_builder& getBuilder() const { return builder_; }
+		// lights uploaded by the last update, the first ones of the light buffer.
+		uint32_t getLightCount() const { return static_cast<uint32_t>(lights_.size()); }
+		uint32_t getCulledCount() const { return culled_count_; }
+
+		static float lightRange(float intensity);
+
+	private:
+		struct frame_resources
+		{
+			std::unique_ptr<vs_buffer> light_buffer;
+			std::unique_ptr<vs_buffer> cluster_buffer;
+			std::unique_ptr<vs_buffer> light_index_buffer;
+		};
+
+		vs_device& device_;
+		vs_light_cluster_builder builder_;
+		std::vector<frame_resources> frames_;
+		std::vector<point_light> lights_;
+		uint32_t culled_count_ = 0;
+	};
+}
@@ -0,0 +1,245 @@
+﻿#include "vs_light_compute_system.h"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace vs {
+vs_light_compute_system::vs_light_compute_system(
+    vs_device &device, int frames_in_flight,
+    vs_light_cluster_system &light_cluster_system)
+    : device_(device), light_cluster_system_(light_cluster_system) {
+  createFrameResources(frames_in_flight);
+  createPipelineLayout();
+  createPipelines();
+}
+
+vs_light_compute_system::~vs_light_compute_system() {
+  vkDestroyPipelineLayout(device_.device(), pipeline_layout_, nullptr);
+}
+
+void vs_light_compute_system::createFrameResources(int frames_in_flight) {
+  set_layout_ = vs_descriptor_set_layout::vs_builder(device_)
+                    .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)
+                    .build();
+
+  descriptor_pool_ =
+      vs_descriptor_pool::vs_builder(device_)
+          .setMaxSets(frames_in_flight)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       7 * frames_in_flight)
+          .build();
+
+  // the animated state only ever lives on the gpu, it is shared by all frames
+  // since they run in submission order.
+  state_buffer_ = std::make_unique<vs_buffer>(
+      device_, sizeof(point_light), vs_light_cluster_system::MAX_LIGHTS,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  auto state_info = state_buffer_->descriptorInfo();
+  // rewritten by the update dispatch of every frame before it is clustered.
+  view_sphere_buffer_ = std::make_unique<vs_buffer>(
+      device_, sizeof(glm::vec4), vs_light_cluster_system::MAX_LIGHTS,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  auto view_sphere_info = view_sphere_buffer_->descriptorInfo();
+
+  frames_.resize(frames_in_flight);
+  for (int i = 0; i < frames_in_flight; ++i) {
+    auto &frame = frames_[i];
+    frame.counter_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(uint32_t), 1,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    frame.draw_buffer = std::make_unique<vs_buffer>(
+        device_, sizeof(VkDrawIndirectCommand), 1,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    auto lights_info = light_cluster_system_.lightsDescriptorInfo(i);
+    auto clusters_info = light_cluster_system_.clustersDescriptorInfo(i);
+    auto light_indices_info =
+        light_cluster_system_.lightIndicesDescriptorInfo(i);
+    auto counter_info = frame.counter_buffer->descriptorInfo();
+    auto draw_info = frame.draw_buffer->descriptorInfo();
+    vs_descriptor_writer(*set_layout_, *descriptor_pool_)
+        .writeBuffer(0, &state_info)
+        .writeBuffer(1, &lights_info)
+        .writeBuffer(2, &clusters_info)
+        .writeBuffer(3, &light_indices_info)
+        .writeBuffer(4, &counter_info)
+        .writeBuffer(5, &view_sphere_info)
+        .writeBuffer(6, &draw_info)
+        .build(frame.descriptor_set);
+  }
+}
+
+void vs_light_compute_system::createPipelineLayout() {
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(light_push_constant_data);
+
+  VkDescriptorSetLayout set_layout = set_layout_->getDescriptorSetLayout();
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &set_layout;
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges = &push_constant_range;
+
+  if (vkCreatePipelineLayout(device_.device(), &layoutInfo, nullptr,
+                             &pipeline_layout_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create light pipeline layout");
+  }
+}
+
+void vs_light_compute_system::createPipelines() {
+  assert(pipeline_layout_ != nullptr &&
+         "cannot create pipeline before pipeline layout");
+
+  update_pipeline_ = std::make_unique<vs_pipeline>(
+      device_, "shaders/light_update.comp.spv", pipeline_layout_);
+  cluster_pipeline_ = std::make_unique<vs_pipeline>(
+      device_, "shaders/light_cluster.comp.spv", pipeline_layout_);
+}
+
+void vs_light_compute_system::upload(const vs_game_object::map &lights) {
+  std::vector<point_light> state;
+  state.reserve(lights.size());
+  for (auto &kv : lights) {
+    auto &obj = kv.second;
+    if (state.size() == vs_light_cluster_system::MAX_LIGHTS)
+      break;
+
+    const float intensity = obj.point_light_comp->light_intensity;
+    point_light light{};
+    light.position = glm::vec4(
+        obj.transform_comp.getTranslation(),
+        glm::max(vs_light_cluster_system::lightRange(intensity),
+                 obj.transform_comp.getScale().x));
+    light.color = glm::vec4(obj.color, intensity);
+    light.radius = obj.transform_comp.getScale().x;
+    light.shadow_index = obj.point_light_comp->shadow_index;
+    state.push_back(light);
+  }
+  light_count_ = static_cast<uint32_t>(state.size());
+  if (light_count_ == 0)
+    return;
+
+  auto staging_buffer = std::make_shared<vs_buffer>(
+      device_, sizeof(point_light), light_count_,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  staging_buffer->map();
+  staging_buffer->writeToBuffer(state.data());
+
+  device_.copyBuffer(staging_buffer->getBuffer(), state_buffer_->getBuffer(),
+                     sizeof(point_light) * light_count_);
+  // keep the staging memory alive until the batched copy has executed.
+  device_.releaseAfterTransfer(
+      [staging_buffer]() mutable { staging_buffer.reset(); });
+}
+
+void vs_light_compute_system::update(const frame_info &frame_info,
+                                     VkExtent2D extent, global_ubo &ubo) {
+  light_cluster_system_.updateParameters(frame_info, extent, light_count_,
+                                         ubo);
+
+  auto &frame = frames_[frame_info.frame_index];
+  VkCommandBuffer command_buffer = frame_info.command_buffer;
+
+  const auto &builder = light_cluster_system_.getBuilder();
+  const glm::mat4 projection = frame_info.camera.getProjection();
+  light_push_constant_data push{};
+  push.view = frame_info.camera.getView();
+  push.projection = {projection[0][0], projection[1][1], projection[2][0],
+                     projection[2][1]};
+  // same rotation as the cpu path, around -y.
+  push.depth = {builder.getNear(), builder.getFar(),
+                frame_info.frame_time * glm::half_pi<float>(), 0.f};
+  push.counts = {light_count_, vs_light_cluster_system::MAX_LIGHT_INDICES, 0,
+                 0};
+
+  vkCmdFillBuffer(command_buffer, frame.counter_buffer->getBuffer(), 0,
+                  VK_WHOLE_SIZE, 0);
+  // the six vertices of a billboard, see point_light.vert. the update
+  // dispatch counts the visible lights into instanceCount.
+  const VkDrawIndirectCommand draw{6, 0, 0, 0};
+  vkCmdUpdateBuffer(command_buffer, frame.draw_buffer->getBuffer(), 0,
+                    sizeof(draw), &draw);
+
+  // the state written by the last frame and the cleared counters.
+  VkMemoryBarrier start_barrier{};
+  start_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  start_barrier.srcAccessMask =
+      VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  start_barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &start_barrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipeline_layout_, 0, 1, &frame.descriptor_set, 0,
+                          nullptr);
+  vkCmdPushConstants(command_buffer, pipeline_layout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(light_push_constant_data), &push);
+
+  if (light_count_ > 0) {
+    update_pipeline_->bind(command_buffer);
+    update_pipeline_->dispatch(
+        command_buffer, vs_pipeline::groupCount(light_count_, GROUP_SIZE));
+
+    // the view space spheres and the visible count are read by the
+    // clustering.
+    VkMemoryBarrier light_barrier{};
+    light_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    light_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    light_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &light_barrier, 0, nullptr, 0, nullptr);
+  }
+
+  // runs without lights too, it clears the clusters of the last use.
+  cluster_pipeline_->bind(command_buffer);
+  cluster_pipeline_->dispatch(
+      command_buffer, vs_pipeline::groupCount(
+                          vs_light_cluster_builder::CLUSTER_COUNT, GROUP_SIZE));
+
+  // the billboard draw reads its instance count from the draw buffer.
+  VkMemoryBarrier draw_barrier{};
+  draw_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  draw_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  draw_barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 1, &draw_barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace vs
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "engine/renderer/vs_buffer.h"
+#include "engine/renderer/vs_descriptors.h"
+#include "engine/renderer/vs_device.h"
+#include "engine/renderer/vs_pipeline.h"
+#include "engine/vs_frame_info.h"
+#include "engine/vs_light_cluster_system.h"
+
+
+namespace vs
+{
+	// gpu path of vs_point_light_render_system::update and vs_light_cluster_system::update. the lights
+	// are uploaded once into a device local buffer, every frame one dispatch spins them in place, drops
+	// the ones outside the frustum and packs the rest into the light buffer of the frame along with
+	// their view space spheres, a second one lists the visible lights of every cluster. the visible
+	// count is the instance count of an indirect billboard draw, see getDrawBuffer().
+	// the clusters reserve their range of the light index buffer with an atomic counter.
+	// records compute work, call before the render pass begins.
+	class vs_light_compute_system
+	{
+	public:
+		static constexpr uint32_t GROUP_SIZE = 64;
+
+		vs_light_compute_system(vs_device& device, int frames_in_flight, vs_light_cluster_system& light_cluster_system);
+		~vs_light_compute_system();
+
+		vs_light_compute_system(const vs_light_compute_system&) = delete;
+		vs_light_compute_system& operator==(const vs_light_compute_system&) = delete;
+
+		// replaces the lights on the gpu with frame_info.lights, their transforms aren't read again.
+		void upload(const vs_game_object::map& lights);
+		// animates and clusters the uploaded lights into the buffers of frame_info.frame_index,
+		// the cluster parameters and light count are written to ubo.
+		void update(const frame_info& frame_info, VkExtent2D extent, global_ubo& ubo);
+
+		// lights uploaded, the visible ones are only counted on the gpu.
+		uint32_t getLightCount() const { return light_count_; }
+		// VkDrawIndirectCommand of the billboards of the visible lights of a frame, written by update().
+		VkBuffer getDrawBuffer(int frame_index) const { return frames_[frame_index].draw_buffer->getBuffer(); }
+
+	private:
+		// layout matches light_update.comp and light_cluster.comp
+		struct light_push_constant_data
+		{
+			glm::mat4 view;
+			glm::vec4 projection; // x and y scale, z and w offset of the ndc
+			glm::vec4 depth; // near, far, rotation angle
+			glm::uvec4 counts; // lights, light index capacity
+		};
+
+		struct frame_resources
+		{
+			std::unique_ptr<vs_buffer> counter_buffer;
+			std::unique_ptr<vs_buffer> draw_buffer;
+			VkDescriptorSet descriptor_set;
+		};
+
+		void createFrameResources(int frames_in_flight);
+		void createPipelineLayout();
+		void createPipelines();
+
+		vs_device& device_;
+		vs_light_cluster_system& light_cluster_system_;
+
+		std::unique_ptr<vs_pipeline> update_pipeline_;
+		std::unique_ptr<vs_pipeline> cluster_pipeline_;
+		VkPipelineLayout pipeline_layout_;
+
+		std::unique_ptr<vs_descriptor_set_layout> set_layout_;
+		std::unique_ptr<vs_descriptor_pool> descriptor_pool_;
+		std::unique_ptr<vs_buffer> state_buffer_;
+		std::unique_ptr<vs_buffer> view_sphere_buffer_;
+		std::vector<frame_resources> frames_;
+		uint32_t light_count_ = 0;
+	};
+}
@@ -0,0 +1,109 @@
+﻿#include "vs_material_system.h"
+
+// std
+#include <stdexcept>
+
+namespace vs {
+std::string vs_material_system::fragmentShader(const vs_device &device,
+                                               const std::string &path) {
+  return path + (device.descriptor_indexing_supported ? ".frag.spv"
+                                                      : "_fixed.frag.spv");
+}
+
+vs_material_system::vs_material_system(vs_device &device)
+    : device_(device), bindless_(device.descriptor_indexing_supported) {
+  if (!bindless_ && !device_.sampled_image_dynamic_indexing_supported) {
+    throw std::runtime_error(
+        "materials need descriptor indexing or dynamically indexed sampler "
+        "arrays");
+  }
+
+  // materials are small and rarely added, so they are written straight into
+  // mapped memory. a shader only reads materials that existed when its frame
+  // was recorded, so one buffer serves every frame in flight.
+  material_buffer_ = std::make_unique<vs_buffer>(
+      device_, sizeof(material), MAX_MATERIALS,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (material_buffer_->map() != VK_SUCCESS) {
+    throw std::runtime_error("material buffer could not be mapped");
+  }
+  textures_.reserve(getTextureCapacity());
+}
+
+void vs_material_system::registerSet(VkDescriptorSet set) {
+  if (!bindless_ && textures_.empty()) {
+    throw std::runtime_error(
+        "the fixed texture array needs a texture before a set is registered");
+  }
+
+  auto bufferInfo = materialsDescriptorInfo();
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstBinding = MATERIALS_BINDING;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.descriptorCount = 1;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device_.device(), 1, &write, 0, nullptr);
+
+  // without partially bound descriptors every slot has to be valid, unused
+  // ones get texture 0.
+  const auto count =
+      bindless_ ? static_cast<uint32_t>(textures_.size()) : FIXED_TEXTURES;
+  for (uint32_t i = 0; i < count; ++i) {
+    writeTexture(set, i);
+  }
+  sets_.push_back(set);
+}
+
+uint32_t vs_material_system::addTexture(VkImageView image_view,
+                                        VkSampler sampler) {
+  if (textures_.size() == getTextureCapacity()) {
+    throw std::runtime_error("texture array is full");
+  }
+  // without update after bind a set can't be written once it may be in use.
+  if (!bindless_ && !sets_.empty()) {
+    throw std::runtime_error(
+        "the fixed texture array is written when its sets are registered");
+  }
+
+  const auto index = static_cast<uint32_t>(textures_.size());
+  textures_.emplace_back(image_view, sampler);
+  // the slot is unused by frames in flight, so it can be written while they
+  // are pending.
+  for (auto set : sets_) {
+    writeTexture(set, index);
+  }
+  return index;
+}
+
+uint32_t vs_material_system::addMaterial(const material &material) {
+  if (material_count_ == MAX_MATERIALS) {
+    throw std::runtime_error("material buffer is full");
+  }
+
+  auto value = material;
+  material_buffer_->writeToIndex(&value, static_cast<int>(material_count_));
+  return material_count_++;
+}
+
+void vs_material_system::writeTexture(VkDescriptorSet set, uint32_t index) {
+  const auto &texture = textures_[index < textures_.size() ? index : 0];
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = texture.second;
+  imageInfo.imageView = texture.first;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstBinding = TEXTURES_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.descriptorCount = 1;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(device_.device(), 1, &write, 0, nullptr);
+}
+} // namespace vs
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "engine/renderer/vs_buffer.h"
+#include "engine/renderer/vs_device.h"
+
+// libs
+#include <glm/glm.hpp>
+
+namespace vs
+{
+	// std430 layout of the material buffer.
+	struct material
+	{
+		glm::vec4 base_color{1.f};
+		uint32_t albedo_texture = 0;
+		uint32_t padding[3];
+	};
+
+	// bindless textures and materials, bindings 7 and 8 of the global set. textures go into one
+	// partially bound sampler array and materials into one storage buffer, the fragment shaders
+	// index both with the material id of the draw, so no set is bound per material. the array is
+	// update after bind, new textures can be written while earlier frames are still in flight.
+	// without descriptor indexing the array has FIXED_TEXTURES slots, every one written, and the
+	// _fixed builds of the fragment shaders index it uniformly per draw. textures then have to be
+	// added before the first set is registered.
+	class vs_material_system
+	{
+	public:
+		static constexpr uint32_t MAX_TEXTURES = 1024;
+		// FIXED_TEXTURES the _fixed shaders are built with in CMakeLists.txt.
+		static constexpr uint32_t FIXED_TEXTURES = 16;
+		static constexpr uint32_t MAX_MATERIALS = 4096;
+		static constexpr uint32_t TEXTURES_BINDING = 7;
+		static constexpr uint32_t MATERIALS_BINDING = 8;
+		// flags of the texture array binding of the global set layout with descriptor indexing.
+		static constexpr VkDescriptorBindingFlags TEXTURE_BINDING_FLAGS =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+		// the build of a fragment shader that matches the texture array of device, path without .frag.spv.
+		static std::string fragmentShader(const vs_device& device, const std::string& path);
+
+		explicit vs_material_system(vs_device& device);
+
+		vs_material_system(const vs_material_system&) = delete;
+		vs_material_system& operator==(const vs_material_system&) = delete;
+
+		// writes the material buffer and every texture added so far into set, later textures
+		// are written into it as they are added.
+		void registerSet(VkDescriptorSet set);
+
+		// returns the index of the texture in the array.
+		uint32_t addTexture(VkImageView image_view, VkSampler sampler);
+		// returns the material id to put on game objects.
+		uint32_t addMaterial(const material& material);
+
+		VkDescriptorBufferInfo materialsDescriptorInfo() { return material_buffer_->descriptorInfo(); }
+		// descriptor count and flags of the texture array binding, and the flags of its pool.
+		uint32_t getTextureCapacity() const { return bindless_ ? MAX_TEXTURES : FIXED_TEXTURES; }
+		VkDescriptorBindingFlags getTextureBindingFlags() const { return bindless_ ? TEXTURE_BINDING_FLAGS : 0; }
+		VkDescriptorPoolCreateFlags getPoolFlags() const
+		{
+			return bindless_ ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+		}
+		bool isBindless() const { return bindless_; }
+		uint32_t getTextureCount() const { return static_cast<uint32_t>(textures_.size()); }
+		uint32_t getMaterialCount() const { return material_count_; }
+
+	private:
+		void writeTexture(VkDescriptorSet set, uint32_t index);
+
+		vs_device& device_;
+		const bool bindless_;
+		std::unique_ptr<vs_buffer> material_buffer_;
+		uint32_t material_count_ = 0;
+		std::vector<std::pair<VkImageView, VkSampler>> textures_;
+		std::vector<VkDescriptorSet> sets_;
+	};
+}
@@ -0,0 +1,74 @@
+﻿#include "vs_occlusion_culling_system.h"
+#include "vs_thread_pool.h"
+
+#include <algorithm>
+
+namespace vs {
+vs_occlusion_culling_system::vs_occlusion_culling_system(
+    vs_thread_pool &thread_pool, uint32_t width, uint32_t height)
+    : thread_pool_(thread_pool), rasterizer_(width, height, &thread_pool) {}
+
+void vs_occlusion_culling_system::cull(frame_info &frame_info) {
+  rasterizer_.beginFrame(frame_info.camera.getProjection() *
+                         frame_info.camera.getView());
+
+  candidates_.clear();
+  if (frame_info.visible_objects != nullptr) {
+    candidates_.assign(frame_info.visible_objects->begin(),
+                       frame_info.visible_objects->end());
+  } else {
+    for (auto &kv : frame_info.game_objects) {
+      if (kv.second.model_comp != nullptr)
+        candidates_.push_back(&kv.second);
+    }
+  }
+
+  // occluders outside the frustum can still hide objects inside it.
+  for (auto &kv : frame_info.game_objects) {
+    auto &object = kv.second;
+    if (object.occluder_comp == nullptr)
+      continue;
+    rasterizer_.addOccluder(object.transform_comp.mat4(),
+                            object.occluder_comp->vertices,
+                            object.occluder_comp->indices);
+  }
+  rasterizer_.rasterize();
+
+  candidate_visible_.assign(candidates_.size(), 1);
+  if (rasterizer_.getTriangleCount() > 0) {
+    const auto batch_count = static_cast<uint32_t>(
+        (candidates_.size() + TEST_BATCH_SIZE - 1) / TEST_BATCH_SIZE);
+    thread_pool_.parallelFor(batch_count, [this](uint32_t batch, uint32_t) {
+      const size_t end =
+          std::min<size_t>((batch + 1) * TEST_BATCH_SIZE, candidates_.size());
+      for (size_t i = batch * TEST_BATCH_SIZE; i < end; ++i) {
+        auto *object = candidates_[i];
+        // occluders would only ever test against themselves.
+        if (object->occluder_comp != nullptr)
+          continue;
+
+        const auto &bounds = object->model_comp->getBounds();
+        const glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+        const glm::vec3 extents = 0.5f * (bounds.max - bounds.min);
+
+        // box around the transformed model space box.
+        const glm::mat4 m = object->transform_comp.mat4();
+        const glm::vec3 world_center = glm::vec3(m * glm::vec4(center, 1.f));
+        const glm::mat3 abs_m{glm::abs(glm::vec3(m[0])),
+                              glm::abs(glm::vec3(m[1])),
+                              glm::abs(glm::vec3(m[2]))};
+
+        candidate_visible_[i] =
+            rasterizer_.isVisible(world_center, abs_m * extents) ? 1 : 0;
+      }
+    });
+  }
+
+  visible_objects_.clear();
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (candidate_visible_[i])
+      visible_objects_.push_back(candidates_[i]);
+  }
+  frame_info.visible_objects = &visible_objects_;
+}
+} // namespace vs
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "engine/vs_frame_info.h"
+#include "engine/vs_occlusion_rasterizer.h"
+
+
+namespace vs
+{
+	class vs_thread_pool;
+
+	// cpu occlusion culling for when the gpu can't spare the time for hi-z. rasterizes the objects tagged
+	// with an occluder_component into a small depth buffer and tests the boxes of the other model objects
+	// against it before any command is recorded.
+	class vs_occlusion_culling_system
+	{
+	public:
+		static constexpr uint32_t DEFAULT_WIDTH = 256;
+		static constexpr uint32_t DEFAULT_HEIGHT = 144;
+
+		explicit vs_occlusion_culling_system(vs_thread_pool& thread_pool, uint32_t width = DEFAULT_WIDTH,
+		                                     uint32_t height = DEFAULT_HEIGHT);
+
+		vs_occlusion_culling_system(const vs_occlusion_culling_system&) = delete;
+		vs_occlusion_culling_system& operator==(const vs_occlusion_culling_system&) = delete;
+
+		// filters frame_info.visible_objects (or every model object when it is null) and points it at the result.
+		void cull(frame_info& frame_info);
+
+		const vs_occlusion_rasterizer& getRasterizer() const { return rasterizer_; }
+		const std::vector<vs_game_object*>& getVisibleObjects() const { return visible_objects_; }
+		size_t getCulledCount() const { return candidates_.size() - visible_objects_.size(); }
+
+	private:
+		static constexpr uint32_t TEST_BATCH_SIZE = 64;
+
+		vs_thread_pool& thread_pool_;
+		vs_occlusion_rasterizer rasterizer_;
+
+		std::vector<vs_game_object*> candidates_;
+		std::vector<uint8_t> candidate_visible_;
+		std::vector<vs_game_object*> visible_objects_;
+	};
+}
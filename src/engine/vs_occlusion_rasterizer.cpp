@@ -0,0 +1,288 @@
+﻿#include "vs_occlusion_rasterizer.h"
+#include "vs_thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VS_RASTER_SSE
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vs {
+// clip space w below this counts as crossing the near plane.
+static constexpr float MIN_CLIP_W = 1e-5f;
+
+// a * x + b * y + c, positive on the inner side of the edge from a to b of a
+// counter clockwise triangle.
+static glm::vec3 edgeFunction(const glm::vec2 &a, const glm::vec2 &b) {
+  return {a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x};
+}
+
+vs_occlusion_rasterizer::vs_occlusion_rasterizer(uint32_t width,
+                                                 uint32_t height,
+                                                 vs_thread_pool *thread_pool)
+    : tiles_x_((std::max(width, 1u) + TILE_WIDTH - 1) / TILE_WIDTH),
+      tiles_y_((std::max(height, 1u) + TILE_HEIGHT - 1) / TILE_HEIGHT),
+      thread_pool_(thread_pool) {
+  width_ = tiles_x_ * TILE_WIDTH;
+  height_ = tiles_y_ * TILE_HEIGHT;
+  depth_.assign(width_ * height_, 1.f);
+  tile_max_depth_.assign(tiles_x_ * tiles_y_, 1.f);
+  tile_bins_.resize(tiles_x_ * tiles_y_);
+}
+
+void vs_occlusion_rasterizer::beginFrame(const glm::mat4 &view_projection) {
+  view_projection_ = view_projection;
+  std::fill(depth_.begin(), depth_.end(), 1.f);
+  std::fill(tile_max_depth_.begin(), tile_max_depth_.end(), 1.f);
+  triangles_.clear();
+  for (auto &bin : tile_bins_) {
+    bin.clear();
+  }
+}
+
+void vs_occlusion_rasterizer::addOccluder(const glm::mat4 &model_matrix,
+                                          const std::vector<glm::vec3> &vertices,
+                                          const std::vector<uint32_t> &indices) {
+  const glm::mat4 model_view_projection = view_projection_ * model_matrix;
+  clip_vertices_.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    clip_vertices_[i] = model_view_projection * glm::vec4(vertices[i], 1.f);
+  }
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    glm::vec2 screen[3];
+    float depth[3];
+    bool clipped = false;
+    for (int v = 0; v < 3; ++v) {
+      const glm::vec4 &clip = clip_vertices_[indices[i + v]];
+      // skipping a triangle only ever hides less, no clipping needed.
+      if (clip.w < MIN_CLIP_W || clip.z < 0.f) {
+        clipped = true;
+        break;
+      }
+      const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+      screen[v] = {(ndc.x * 0.5f + 0.5f) * static_cast<float>(width_),
+                   (ndc.y * 0.5f + 0.5f) * static_cast<float>(height_)};
+      depth[v] = ndc.z;
+    }
+    if (clipped)
+      continue;
+
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                 (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+    if (std::abs(area) < 1e-6f)
+      continue;
+    // occluders are rasterized two sided.
+    if (area < 0.f) {
+      std::swap(screen[1], screen[2]);
+      std::swap(depth[1], depth[2]);
+      area = -area;
+    }
+
+    // pixels whose center lies inside the bounds.
+    const glm::vec2 lower = glm::min(screen[0], glm::min(screen[1], screen[2]));
+    const glm::vec2 upper = glm::max(screen[0], glm::max(screen[1], screen[2]));
+    screen_triangle triangle{};
+    triangle.min_x = std::max(static_cast<int32_t>(std::ceil(lower.x - 0.5f)), 0);
+    triangle.min_y = std::max(static_cast<int32_t>(std::ceil(lower.y - 0.5f)), 0);
+    triangle.max_x = std::min(static_cast<int32_t>(std::floor(upper.x - 0.5f)),
+                              static_cast<int32_t>(width_) - 1);
+    triangle.max_y = std::min(static_cast<int32_t>(std::floor(upper.y - 0.5f)),
+                              static_cast<int32_t>(height_) - 1);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+      continue;
+
+    triangle.edges[0] = edgeFunction(screen[1], screen[2]);
+    triangle.edges[1] = edgeFunction(screen[2], screen[0]);
+    triangle.edges[2] = edgeFunction(screen[0], screen[1]);
+    // the edge functions divided by the area are the barycentric weights.
+    triangle.depth = (triangle.edges[0] * depth[0] +
+                      triangle.edges[1] * depth[1] +
+                      triangle.edges[2] * depth[2]) /
+                     area;
+
+    const auto index = static_cast<uint32_t>(triangles_.size());
+    triangles_.push_back(triangle);
+    for (int32_t ty = triangle.min_y / static_cast<int32_t>(TILE_HEIGHT);
+         ty <= triangle.max_y / static_cast<int32_t>(TILE_HEIGHT); ++ty) {
+      for (int32_t tx = triangle.min_x / static_cast<int32_t>(TILE_WIDTH);
+           tx <= triangle.max_x / static_cast<int32_t>(TILE_WIDTH); ++tx) {
+        tile_bins_[ty * tiles_x_ + tx].push_back(index);
+      }
+    }
+  }
+}
+
+void vs_occlusion_rasterizer::rasterize() {
+  const uint32_t tile_count = tiles_x_ * tiles_y_;
+  if (thread_pool_ != nullptr) {
+    thread_pool_->parallelFor(
+        tile_count, [this](uint32_t tile, uint32_t) { rasterizeTile(tile); });
+  } else {
+    for (uint32_t tile = 0; tile < tile_count; ++tile) {
+      rasterizeTile(tile);
+    }
+  }
+}
+
+void vs_occlusion_rasterizer::rasterizeTile(uint32_t tile) {
+  const auto &bin = tile_bins_[tile];
+  if (bin.empty())
+    return;
+
+  const int32_t tile_min_x = (tile % tiles_x_) * TILE_WIDTH;
+  const int32_t tile_min_y = (tile / tiles_x_) * TILE_HEIGHT;
+  const int32_t tile_max_x = tile_min_x + TILE_WIDTH - 1;
+  const int32_t tile_max_y = tile_min_y + TILE_HEIGHT - 1;
+
+  for (uint32_t index : bin) {
+    const auto &triangle = triangles_[index];
+    int32_t min_x = std::max(triangle.min_x, tile_min_x);
+    const int32_t min_y = std::max(triangle.min_y, tile_min_y);
+    const int32_t max_x = std::min(triangle.max_x, tile_max_x);
+    const int32_t max_y = std::min(triangle.max_y, tile_max_y);
+
+#if defined(VS_RASTER_SSE)
+    // tiles are a multiple of 4 wide, so aligned groups never leave the tile.
+    min_x &= ~3;
+    const __m128 lane_offset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 a0 = _mm_set1_ps(triangle.edges[0].x);
+    const __m128 a1 = _mm_set1_ps(triangle.edges[1].x);
+    const __m128 a2 = _mm_set1_ps(triangle.edges[2].x);
+    const __m128 depth_a = _mm_set1_ps(triangle.depth.x);
+
+    for (int32_t y = min_y; y <= max_y; ++y) {
+      const float py = static_cast<float>(y) + 0.5f;
+      const __m128 row0 =
+          _mm_set1_ps(triangle.edges[0].y * py + triangle.edges[0].z);
+      const __m128 row1 =
+          _mm_set1_ps(triangle.edges[1].y * py + triangle.edges[1].z);
+      const __m128 row2 =
+          _mm_set1_ps(triangle.edges[2].y * py + triangle.edges[2].z);
+      const __m128 depth_row =
+          _mm_set1_ps(triangle.depth.y * py + triangle.depth.z);
+      float *row = &depth_[y * width_];
+
+      for (int32_t x = min_x; x <= max_x; x += 4) {
+        const __m128 px =
+            _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offset);
+        const __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+        const __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+        const __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+        const __m128 inside =
+            _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                       _mm_cmpge_ps(w2, zero));
+        if (_mm_movemask_ps(inside) == 0)
+          continue;
+
+        const __m128 depth = _mm_add_ps(_mm_mul_ps(depth_a, px), depth_row);
+        const __m128 stored = _mm_loadu_ps(row + x);
+        const __m128 nearest = _mm_min_ps(stored, depth);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                         _mm_andnot_ps(inside, stored)));
+      }
+    }
+#else
+    for (int32_t y = min_y; y <= max_y; ++y) {
+      const float py = static_cast<float>(y) + 0.5f;
+      float *row = &depth_[y * width_];
+      for (int32_t x = min_x; x <= max_x; ++x) {
+        const glm::vec3 p{static_cast<float>(x) + 0.5f, py, 1.f};
+        if (glm::dot(triangle.edges[0], p) < 0.f ||
+            glm::dot(triangle.edges[1], p) < 0.f ||
+            glm::dot(triangle.edges[2], p) < 0.f)
+          continue;
+        row[x] = std::min(row[x], glm::dot(triangle.depth, p));
+      }
+    }
+#endif
+  }
+
+  float max_depth = 0.f;
+  for (int32_t y = tile_min_y; y <= tile_max_y; ++y) {
+    const float *row = &depth_[y * width_];
+    max_depth = std::max(max_depth,
+                         *std::max_element(row + tile_min_x, row + tile_max_x + 1));
+  }
+  tile_max_depth_[tile] = max_depth;
+}
+
+bool vs_occlusion_rasterizer::isVisible(const glm::vec3 &world_center,
+                                        const glm::vec3 &world_extents) const {
+  glm::vec2 lower{std::numeric_limits<float>::max()};
+  glm::vec2 upper{std::numeric_limits<float>::lowest()};
+  float nearest_depth = 1.f;
+  for (int i = 0; i < 8; ++i) {
+    const glm::vec3 corner_sign{(i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f,
+                                (i & 4) ? 1.f : -1.f};
+    const glm::vec4 clip =
+        view_projection_ * glm::vec4(world_center + world_extents * corner_sign, 1.f);
+    if (clip.w < MIN_CLIP_W || clip.z < 0.f)
+      return true;
+
+    const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    const glm::vec2 screen{(ndc.x * 0.5f + 0.5f) * static_cast<float>(width_),
+                           (ndc.y * 0.5f + 0.5f) * static_cast<float>(height_)};
+    lower = glm::min(lower, screen);
+    upper = glm::max(upper, screen);
+    nearest_depth = std::min(nearest_depth, ndc.z);
+  }
+
+  // occluders only cover the pixel centers they touch, one pixel of margin
+  // keeps boxes peeking past an occluder edge visible.
+  const int32_t min_x = std::max(static_cast<int32_t>(std::floor(lower.x)) - 1, 0);
+  const int32_t min_y = std::max(static_cast<int32_t>(std::floor(lower.y)) - 1, 0);
+  const int32_t max_x = std::min(static_cast<int32_t>(std::floor(upper.x)) + 1,
+                                 static_cast<int32_t>(width_) - 1);
+  const int32_t max_y = std::min(static_cast<int32_t>(std::floor(upper.y)) + 1,
+                                 static_cast<int32_t>(height_) - 1);
+  // off screen.
+  if (min_x > max_x || min_y > max_y)
+    return false;
+
+  return isRectVisible(min_x, min_y, max_x, max_y, nearest_depth);
+}
+
+bool vs_occlusion_rasterizer::isRectVisible(int32_t min_x, int32_t min_y,
+                                            int32_t max_x, int32_t max_y,
+                                            float nearest_depth) const {
+  for (int32_t ty = min_y / static_cast<int32_t>(TILE_HEIGHT);
+       ty <= max_y / static_cast<int32_t>(TILE_HEIGHT); ++ty) {
+    for (int32_t tx = min_x / static_cast<int32_t>(TILE_WIDTH);
+         tx <= max_x / static_cast<int32_t>(TILE_WIDTH); ++tx) {
+      // every pixel of the tile is in front of the box.
+      if (nearest_depth > tile_max_depth_[ty * tiles_x_ + tx])
+        continue;
+
+      const int32_t x0 = std::max(min_x, tx * static_cast<int32_t>(TILE_WIDTH));
+      const int32_t x1 =
+          std::min(max_x, (tx + 1) * static_cast<int32_t>(TILE_WIDTH) - 1);
+      const int32_t y0 = std::max(min_y, ty * static_cast<int32_t>(TILE_HEIGHT));
+      const int32_t y1 =
+          std::min(max_y, (ty + 1) * static_cast<int32_t>(TILE_HEIGHT) - 1);
+
+      for (int32_t y = y0; y <= y1; ++y) {
+        const float *row = &depth_[y * width_];
+        int32_t x = x0;
+#if defined(VS_RASTER_SSE)
+        const __m128 nearest = _mm_set1_ps(nearest_depth);
+        for (; x + 3 <= x1; x += 4) {
+          if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), nearest)) != 0)
+            return true;
+        }
+#endif
+        for (; x <= x1; ++x) {
+          if (row[x] >= nearest_depth)
+            return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+} // namespace vs
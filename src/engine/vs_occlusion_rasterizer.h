@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+
+namespace vs
+{
+	class vs_thread_pool;
+
+	// low resolution software depth buffer for occlusion culling on the cpu, no vulkan involved.
+	// occluder triangles are binned into tiles and every tile is rasterized by one worker, 4 pixels
+	// at a time with sse. depth is 0 at the near plane and 1 at the far plane like the gpu depth buffer,
+	// every pixel keeps the nearest occluder depth at its center.
+	class vs_occlusion_rasterizer
+	{
+	public:
+		static constexpr uint32_t TILE_WIDTH = 32;
+		static constexpr uint32_t TILE_HEIGHT = 16;
+
+		// the size is rounded up to whole tiles. without a thread pool every tile runs on the calling thread.
+		vs_occlusion_rasterizer(uint32_t width, uint32_t height, vs_thread_pool* thread_pool = nullptr);
+
+		vs_occlusion_rasterizer(const vs_occlusion_rasterizer&) = delete;
+		vs_occlusion_rasterizer& operator==(const vs_occlusion_rasterizer&) = delete;
+
+		// clears the depth buffer and drops the occluders of the last frame.
+		void beginFrame(const glm::mat4& view_projection);
+		// bins the triangles of a model space mesh, triangles crossing the near plane are skipped.
+		void addOccluder(const glm::mat4& model_matrix, const std::vector<glm::vec3>& vertices,
+		                 const std::vector<uint32_t>& indices);
+		// rasterizes everything added since beginFrame.
+		void rasterize();
+
+		// false when the world space box is hidden behind the occluders. boxes crossing the near plane
+		// are always visible.
+		bool isVisible(const glm::vec3& world_center, const glm::vec3& world_extents) const;
+
+		uint32_t getWidth() const { return width_; }
+		uint32_t getHeight() const { return height_; }
+		// row major, width * height.
+		const std::vector<float>& getDepthBuffer() const { return depth_; }
+		uint32_t getTriangleCount() const { return static_cast<uint32_t>(triangles_.size()); }
+
+	private:
+		// edge functions and the depth plane in pixel coordinates, a * x + b * y + c.
+		struct screen_triangle
+		{
+			glm::vec3 edges[3];
+			glm::vec3 depth;
+			int32_t min_x, min_y, max_x, max_y;
+		};
+
+		void rasterizeTile(uint32_t tile);
+		bool isRectVisible(int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, float nearest_depth) const;
+
+		uint32_t width_;
+		uint32_t height_;
+		uint32_t tiles_x_;
+		uint32_t tiles_y_;
+		vs_thread_pool* thread_pool_;
+
+		glm::mat4 view_projection_{1.f};
+		std::vector<float> depth_;
+		// farthest depth in every tile, lets tests skip the pixels of tiles that are fully covered.
+		std::vector<float> tile_max_depth_;
+		std::vector<screen_triangle> triangles_;
+		std::vector<std::vector<uint32_t>> tile_bins_;
+		std::vector<glm::vec4> clip_vertices_;
+	};
+}
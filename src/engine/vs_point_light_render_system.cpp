@@ -12,18 +12,14 @@
 
 namespace vs
 {
-	struct point_light_push_constants
-	{
-		glm::vec4 position{}; // ignore w
-		glm::vec4 color{}; // w is intensity
-		float radius;
-	};
-
-        vs_point_light_render_system::vs_point_light_render_system(vs_device& device, VkRenderPass render_pass,
+        vs_point_light_render_system::vs_point_light_render_system(vs_device& device,
+	                                             vs_pipeline_compiler& pipeline_compiler,
+	                                             VkRenderPass render_pass,
+	                                             VkRenderPass deferred_render_pass,
 	                                             VkDescriptorSetLayout global_set_layout) : device_(device)
 	{
 		createPipelineLayout(global_set_layout);
-		createPipeline(render_pass);
+		createPipelines(pipeline_compiler, render_pass, deferred_render_pass);
 	}
 
         vs_point_light_render_system::~vs_point_light_render_system()
@@ -33,11 +29,7 @@ namespace vs
 
 	void vs_point_light_render_system::createPipelineLayout(VkDescriptorSetLayout global_set_layout)
 	{
-		VkPushConstantRange push_constant_range{};
-		push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		push_constant_range.offset = 0;
-		push_constant_range.size = sizeof(point_light_push_constants);
-
+		// the billboards read the light buffer of the global set, no push constants.
 		std::vector<VkDescriptorSetLayout> descriptor_set_layouts{global_set_layout};
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
@@ -45,8 +37,8 @@ namespace vs
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptor_set_layouts.data();
 
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &push_constant_range;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
 		if (vkCreatePipelineLayout(device_.device(), &pipelineLayoutInfo, nullptr, &pipeline_layout_) != VK_SUCCESS)
 		{
@@ -55,28 +47,41 @@ namespace vs
 	}
 
 	void
-        vs_point_light_render_system::createPipeline(VkRenderPass render_pass)
+        vs_point_light_render_system::createPipelines(vs_pipeline_compiler& pipeline_compiler, VkRenderPass render_pass,
+	                                              VkRenderPass deferred_render_pass)
 	{
 		assert(pipeline_layout_ != nullptr && "cannot create pipeline before pipeline layout");
 
-		pipeline_config_info pipeline_config{};
+		auto makeConfig = [&]()
+		{
+			auto pipeline_config = std::make_unique<pipeline_config_info>();
+			vs_pipeline::defaultPipelineConfigInfo(*pipeline_config, device_.msaa_samples, true);
+			pipeline_config->attribute_descriptions.clear();
+			pipeline_config->binding_descriptions.clear();
+			pipeline_config->render_pass = render_pass;
+			pipeline_config->pipeline_layout = pipeline_layout_;
+			return pipeline_config;
+		};
+		pipeline = pipeline_compiler.submit(
+			"shaders/point_light.vert.spv",
+			"shaders/point_light.frag.spv",
+			makeConfig()
+		);
 
-                vs_pipeline::defaultPipelineConfigInfo(
-                    pipeline_config, device_.msaa_samples, true);
-		pipeline_config.attribute_descriptions.clear();
-		pipeline_config.binding_descriptions.clear();
-		pipeline_config.render_pass = render_pass;
-		pipeline_config.pipeline_layout = pipeline_layout_;
-		pipeline = std::make_unique<vs_pipeline>(
-			device_,
+		// the lighting subpass only reads depth.
+		auto deferred_config = makeConfig();
+		deferred_config->depth_stencil_info.depthWriteEnable = VK_FALSE;
+		deferred_config->render_pass = deferred_render_pass;
+		deferred_config->subpass = 1;
+		deferred_pipeline_ = pipeline_compiler.submit(
 			"shaders/point_light.vert.spv",
 			"shaders/point_light.frag.spv",
-			pipeline_config
+			std::move(deferred_config)
 		);
 	}
 
 
-	void vs_point_light_render_system::update(const frame_info& frame_info, global_ubo& ubo)
+	void vs_point_light_render_system::update(const frame_info& frame_info)
 	{
 		auto rotate_light = glm::rotate(
 			glm::mat4(1.f),
@@ -84,52 +89,52 @@ namespace vs
 			{0.f, -1.f, .0f}
 		);
 
-
-		int light_index = 0;
-
+		// the light buffers are filled by vs_light_cluster_system. shadowed lights stay
+		// put, moving them would re-render their static shadow pages every frame.
 		for (auto& kv: frame_info.lights)
 		{
 			auto& obj = kv.second;
+			if (obj.point_light_comp->shadow_index >= 0)
+			{
+				continue;
+			}
+			obj.transform_comp.setTranslation(glm::vec3(
+				rotate_light * glm::vec4(obj.transform_comp.getTranslation(), 1.f)));
+		}
+	}
 
-			assert(light_index <= MAX_LIGHTS && "reached max number of lights");
-			//update position
-			obj.transform_comp.translation = glm::vec3(
-				rotate_light * glm::vec4(obj.transform_comp.translation, 1.f));
-
+	void vs_point_light_render_system::render(frame_info& frame_info, vs_draw_stream& draw_stream,
+	                                          uint32_t light_count, render_path path)
+	{
+		if (light_count == 0)
+		{
+			return;
+		}
 
-			//copy light to ubo
-			ubo.point_lights[light_index].position = glm::vec4(obj.transform_comp.translation, 1.f);
-			ubo.point_lights[light_index].color = glm::vec4(obj.color, obj.point_light_comp->light_intensity);
+		draw_call call = makeDrawCall(frame_info, path);
+		call.instance_count = light_count;
 
-			light_index++;
-		}
-		ubo.num_lights = light_index;
+		// the billboards are opaque with discarded corners, one instanced draw covers every light.
+		draw_stream.add(draw_pass::transparent, call, 0.f);
 	}
 
-	void vs_point_light_render_system::render(frame_info& frame_info)
+	void vs_point_light_render_system::renderIndirect(frame_info& frame_info, vs_draw_stream& draw_stream,
+	                                                  VkBuffer draw_buffer, render_path path)
 	{
-		pipeline->bind(frame_info.command_buffer);
+		draw_call call = makeDrawCall(frame_info, path);
+		call.indirect_buffer = draw_buffer;
 
-		vkCmdBindDescriptorSets(frame_info.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1,
-		                        &frame_info.global_descriptor_set, 0, nullptr);
+		draw_stream.add(draw_pass::transparent, call, 0.f);
+	}
 
-		//check for lights and render
-		for (auto& kv : frame_info.lights)
-		{
-			auto& obj = kv.second;
-			point_light_push_constants push{};
-			push.position = glm::vec4(obj.transform_comp.translation, 1.f);
-			push.color = glm::vec4(obj.color, obj.point_light_comp->light_intensity);
-			push.radius = obj.transform_comp.scale.x;
-
-			vkCmdPushConstants(frame_info.command_buffer,
-			                   pipeline_layout_,
-			                   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-			                   0,
-			                   sizeof(point_light_push_constants),
-			                   &push
-			);
-			vkCmdDraw(frame_info.command_buffer, 6, 1, 0, 0);
-		}
+	draw_call vs_point_light_render_system::makeDrawCall(const frame_info& frame_info, render_path path) const
+	{
+		draw_call call{};
+		call.pipeline = path == render_path::deferred ? deferred_pipeline_.get() : pipeline.get();
+		call.pipeline_layout = pipeline_layout_;
+		call.descriptor_sets[0] = frame_info.global_descriptor_set;
+		call.descriptor_set_count = 1;
+		call.vertex_count = 6;
+		return call;
 	}
 }
@@ -4,6 +4,9 @@
 
 #include "engine/renderer/vs_device.h"
 #include "engine/renderer/vs_pipeline.h"
+#include "engine/renderer/vs_pipeline_compiler.h"
+#include "engine/renderer/vs_swap_chain.h"
+#include "engine/vs_draw_stream.h"
 #include "engine/vs_frame_info.h"
 
 
@@ -11,24 +14,38 @@ namespace vs
 {
 	class vs_point_light_render_system {
 	public:
-          vs_point_light_render_system(vs_device& device, VkRenderPass render_pass, VkDescriptorSetLayout global_set_layout);
+          vs_point_light_render_system(vs_device& device, vs_pipeline_compiler& pipeline_compiler,
+                                       VkRenderPass render_pass, VkRenderPass deferred_render_pass,
+                                       VkDescriptorSetLayout global_set_layout);
 		~vs_point_light_render_system();
 
                 vs_point_light_render_system(const vs_point_light_render_system &) = delete;
                 vs_point_light_render_system & operator==(const vs_point_light_render_system &) = delete;
 
 
-		void update(const frame_info& frame_info, global_ubo& ubo);
-		void render(frame_info& frame_info);
+		// spins the lights around the origin.
+		void update(const frame_info& frame_info);
+		// adds one instanced draw of the first light_count billboards of the light buffer
+		// uploaded by vs_light_cluster_system to the transparent pass of the stream.
+		// the deferred path replays the stream in the lighting subpass.
+		void render(frame_info& frame_info, vs_draw_stream& draw_stream, uint32_t light_count,
+		            render_path path = render_path::forward);
+		// same draw with the instance count of the VkDrawIndirectCommand in draw_buffer, for lights
+		// culled and packed on the gpu by vs_light_compute_system.
+		void renderIndirect(frame_info& frame_info, vs_draw_stream& draw_stream, VkBuffer draw_buffer,
+		                    render_path path = render_path::forward);
 
 
 	private:
 		void createPipelineLayout(VkDescriptorSetLayout global_set_layout);
-		void createPipeline(VkRenderPass render_pass);
+		void createPipelines(vs_pipeline_compiler& pipeline_compiler, VkRenderPass render_pass,
+		                     VkRenderPass deferred_render_pass);
+		draw_call makeDrawCall(const frame_info& frame_info, render_path path) const;
 
 
 		vs_device& device_;
-		std::unique_ptr<vs_pipeline> pipeline;
+		vs_pipeline_compiler::handle pipeline;
+		vs_pipeline_compiler::handle deferred_pipeline_;
 		VkPipelineLayout pipeline_layout_;
 	};
 }
@@ -0,0 +1,178 @@
+﻿#include "vs_scene_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vs {
+// rotates [first, first + count) to destination in every array, destination is
+// a position before the move and outside the range.
+template <typename T>
+static void moveElements(std::vector<T> &values, uint32_t first,
+                         uint32_t count, uint32_t destination) {
+  auto begin = values.begin();
+  if (destination < first) {
+    std::rotate(begin + destination, begin + first, begin + first + count);
+  } else {
+    std::rotate(begin + first, begin + first + count, begin + destination);
+  }
+}
+
+vs_scene_graph::node_id vs_scene_graph::createNode(node_id parent) {
+  node_id node;
+  if (!free_ids_.empty()) {
+    node = free_ids_.back();
+    free_ids_.pop_back();
+  } else {
+    node = static_cast<node_id>(positions_.size());
+    positions_.push_back(0);
+    parent_ids_.push_back(INVALID_NODE);
+    dirty_flags_.push_back(0);
+  }
+
+  uint32_t position = static_cast<uint32_t>(node_ids_.size());
+  if (parent != INVALID_NODE) {
+    const uint32_t parent_position = positions_[parent];
+    position = parent_position + subtree_sizes_[parent_position];
+  }
+
+  node_ids_.insert(node_ids_.begin() + position, node);
+  parents_.insert(parents_.begin() + position, NO_PARENT);
+  subtree_sizes_.insert(subtree_sizes_.begin() + position, 1);
+  local_.insert(local_.begin() + position, glm::mat4{1.f});
+  world_.insert(world_.begin() + position, glm::mat4{1.f});
+
+  parent_ids_[node] = parent;
+  addToAncestors(parent, 1);
+  fixPositions(position);
+  markDirty(node);
+  return node;
+}
+
+void vs_scene_graph::destroyNode(node_id node) {
+  const uint32_t first = positions_[node];
+  const uint32_t count = subtree_sizes_[first];
+  addToAncestors(parent_ids_[node], -static_cast<int32_t>(count));
+
+  for (uint32_t i = first; i < first + count; ++i) {
+    const node_id destroyed = node_ids_[i];
+    positions_[destroyed] = UINT32_MAX;
+    parent_ids_[destroyed] = INVALID_NODE;
+    dirty_flags_[destroyed] = 0;
+    free_ids_.push_back(destroyed);
+  }
+  dirty_nodes_.erase(std::remove_if(dirty_nodes_.begin(), dirty_nodes_.end(),
+                                    [this](node_id dirty) {
+                                      return positions_[dirty] == UINT32_MAX;
+                                    }),
+                     dirty_nodes_.end());
+
+  node_ids_.erase(node_ids_.begin() + first, node_ids_.begin() + first + count);
+  parents_.erase(parents_.begin() + first, parents_.begin() + first + count);
+  subtree_sizes_.erase(subtree_sizes_.begin() + first,
+                       subtree_sizes_.begin() + first + count);
+  local_.erase(local_.begin() + first, local_.begin() + first + count);
+  world_.erase(world_.begin() + first, world_.begin() + first + count);
+  fixPositions(first);
+}
+
+void vs_scene_graph::setParent(node_id node, node_id parent) {
+  if (parent_ids_[node] == parent)
+    return;
+
+  const uint32_t first = positions_[node];
+  const uint32_t count = subtree_sizes_[first];
+  if (parent != INVALID_NODE && positions_[parent] >= first &&
+      positions_[parent] < first + count) {
+    throw std::runtime_error("scene graph node can't be parented to its own "
+                             "subtree");
+  }
+
+  // end of the new parent's subtree, measured before the range is taken out
+  // so it is a position in the arrays as they are now.
+  uint32_t destination = static_cast<uint32_t>(node_ids_.size());
+  if (parent != INVALID_NODE) {
+    const uint32_t parent_position = positions_[parent];
+    destination = parent_position + subtree_sizes_[parent_position];
+  }
+
+  addToAncestors(parent_ids_[node], -static_cast<int32_t>(count));
+  parent_ids_[node] = parent;
+  addToAncestors(parent, static_cast<int32_t>(count));
+
+  if (destination != first && destination != first + count) {
+    moveRange(first, count, destination);
+  }
+  fixPositions(std::min(first, destination));
+  markDirty(node);
+}
+
+void vs_scene_graph::setLocalMatrix(node_id node,
+                                    const glm::mat4 &local_matrix) {
+  local_[positions_[node]] = local_matrix;
+  markDirty(node);
+}
+
+void vs_scene_graph::update() {
+  updated_nodes_.clear();
+  if (dirty_nodes_.empty())
+    return;
+
+  dirty_positions_.clear();
+  for (node_id node : dirty_nodes_) {
+    dirty_positions_.push_back(positions_[node]);
+    dirty_flags_[node] = 0;
+  }
+  dirty_nodes_.clear();
+  std::sort(dirty_positions_.begin(), dirty_positions_.end());
+
+  // a dirty node inside a subtree that was already updated is covered by it.
+  uint32_t covered_end = 0;
+  for (uint32_t first : dirty_positions_) {
+    if (first < covered_end)
+      continue;
+
+    const uint32_t end = first + subtree_sizes_[first];
+    for (uint32_t i = first; i < end; ++i) {
+      const uint32_t parent = parents_[i];
+      world_[i] = parent == NO_PARENT ? local_[i] : world_[parent] * local_[i];
+      updated_nodes_.push_back(node_ids_[i]);
+    }
+    covered_end = end;
+  }
+}
+
+void vs_scene_graph::markDirty(node_id node) {
+  if (dirty_flags_[node] != 0)
+    return;
+  dirty_flags_[node] = 1;
+  dirty_nodes_.push_back(node);
+}
+
+void vs_scene_graph::moveRange(uint32_t first, uint32_t count,
+                               uint32_t destination) {
+  moveElements(node_ids_, first, count, destination);
+  moveElements(subtree_sizes_, first, count, destination);
+  moveElements(local_, first, count, destination);
+  moveElements(world_, first, count, destination);
+  // parents_ is rebuilt by fixPositions.
+}
+
+void vs_scene_graph::addToAncestors(node_id parent, int32_t count) {
+  for (node_id ancestor = parent; ancestor != INVALID_NODE;
+       ancestor = parent_ids_[ancestor]) {
+    subtree_sizes_[positions_[ancestor]] += count;
+  }
+}
+
+void vs_scene_graph::fixPositions(uint32_t first) {
+  for (uint32_t i = first; i < node_ids_.size(); ++i) {
+    positions_[node_ids_[i]] = i;
+  }
+  // parents come first, nodes in front of first kept their parent positions.
+  for (uint32_t i = first; i < node_ids_.size(); ++i) {
+    const node_id parent = parent_ids_[node_ids_[i]];
+    parents_[i] = parent == INVALID_NODE ? NO_PARENT : positions_[parent];
+  }
+}
+} // namespace vs
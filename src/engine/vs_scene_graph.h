@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+
+namespace vs
+{
+	// parent/child hierarchy of local matrices, no vulkan involved. nodes are stored depth first in
+	// flat arrays so every subtree is one contiguous range that starts with its root, parents always
+	// come before their children. update() recomputes the world matrices of the dirty subtrees only,
+	// front to back in one pass over the ranges.
+	// node ids stay valid until the node is destroyed, positions move when the hierarchy changes.
+	class vs_scene_graph
+	{
+	public:
+		using node_id = uint32_t;
+		static constexpr node_id INVALID_NODE = UINT32_MAX;
+
+		vs_scene_graph() = default;
+
+		vs_scene_graph(const vs_scene_graph&) = delete;
+		vs_scene_graph& operator==(const vs_scene_graph&) = delete;
+
+		// the node is placed at the end of its parent's subtree, so building a hierarchy depth first
+		// only ever appends. starts out with an identity local matrix.
+		node_id createNode(node_id parent = INVALID_NODE);
+		// destroys the node and its whole subtree.
+		void destroyNode(node_id node);
+		// moves the node and its subtree under parent, INVALID_NODE makes it a root. throws when
+		// parent is inside the subtree of node.
+		void setParent(node_id node, node_id parent);
+
+		void setLocalMatrix(node_id node, const glm::mat4& local_matrix);
+		const glm::mat4& getLocalMatrix(node_id node) const { return local_[positions_[node]]; }
+		// valid after update().
+		const glm::mat4& getWorldMatrix(node_id node) const { return world_[positions_[node]]; }
+		node_id getParent(node_id node) const { return parent_ids_[node]; }
+		bool isDirty(node_id node) const { return dirty_flags_[node] != 0; }
+
+		// recomputes the world matrices of every dirty node and its descendants.
+		void update();
+
+		// nodes whose world matrix changed in the last update, depth first.
+		const std::vector<node_id>& getUpdatedNodes() const { return updated_nodes_; }
+		size_t getNodeCount() const { return node_ids_.size(); }
+
+	private:
+		static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+		void markDirty(node_id node);
+		// moves count nodes starting at first so they start at destination in the arrays before the
+		// move, destination is outside [first, first + count].
+		void moveRange(uint32_t first, uint32_t count, uint32_t destination);
+		void addToAncestors(node_id parent, int32_t count);
+		// rewrites the position tables from position first to the end.
+		void fixPositions(uint32_t first);
+
+		// by position, depth first.
+		std::vector<node_id> node_ids_;
+		std::vector<uint32_t> parents_; // position of the parent, NO_PARENT for roots
+		std::vector<uint32_t> subtree_sizes_; // including the node itself
+		std::vector<glm::mat4> local_;
+		std::vector<glm::mat4> world_;
+
+		// by node id.
+		std::vector<uint32_t> positions_;
+		std::vector<node_id> parent_ids_;
+		std::vector<uint8_t> dirty_flags_;
+		std::vector<node_id> free_ids_;
+
+		std::vector<node_id> dirty_nodes_;
+		std::vector<uint32_t> dirty_positions_;
+		std::vector<node_id> updated_nodes_;
+	};
+}
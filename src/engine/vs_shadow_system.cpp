@@ -0,0 +1,674 @@
+﻿#include "vs_shadow_system.h"
+#include "vs_light_cluster_system.h"
+
+// libs
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <limits>
+#include <stdexcept>
+
+namespace vs {
+// face f looks along face_forward[f] with face_up[f] up, like glm::lookAt.
+static const glm::vec3 face_forward[6] = {{1.f, 0.f, 0.f},  {-1.f, 0.f, 0.f},
+                                          {0.f, 1.f, 0.f},  {0.f, -1.f, 0.f},
+                                          {0.f, 0.f, 1.f},  {0.f, 0.f, -1.f}};
+static const glm::vec3 face_up[6] = {{0.f, 1.f, 0.f}, {0.f, 1.f, 0.f},
+                                     {0.f, 0.f, 1.f}, {0.f, 0.f, 1.f},
+                                     {0.f, 1.f, 0.f}, {0.f, 1.f, 0.f}};
+static constexpr uint32_t ALL_FACES = 0x3f;
+
+struct shadow_push_constant_data {
+  glm::mat4 model_view_projection;
+};
+
+static VkImageMemoryBarrier depthBarrier(VkImage image, VkImageLayout old_layout,
+                                         VkImageLayout new_layout,
+                                         VkAccessFlags src_access,
+                                         VkAccessFlags dst_access) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+  return barrier;
+}
+
+vs_shadow_system::vs_shadow_system(vs_device &device, int frames_in_flight)
+    : device_(device) {
+  depth_format_ = device_.findSupportedFormat(
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+  createRenderPasses();
+  createPipeline();
+  createSampler();
+
+  const VkImageUsageFlags cache_usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  directional_cache_ = createShadowImage(DIRECTIONAL_SHADOW_SIZE, 1,
+                                         cache_usage, static_render_pass_);
+  point_cache_ = createShadowImage(POINT_SHADOW_SIZE,
+                                   6 * MAX_SHADOWED_POINT_LIGHTS, cache_usage,
+                                   static_render_pass_);
+
+  const VkImageUsageFlags map_usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  frames_.resize(frames_in_flight);
+  for (auto &frame : frames_) {
+    frame.directional = createShadowImage(DIRECTIONAL_SHADOW_SIZE, 1,
+                                          map_usage, dynamic_render_pass_);
+    frame.point = createShadowImage(POINT_SHADOW_SIZE,
+                                    6 * MAX_SHADOWED_POINT_LIGHTS, map_usage,
+                                    dynamic_render_pass_);
+  }
+
+  // the caches rest in transfer source layout, faces that were never
+  // rendered hold the far plane and shadow nothing.
+  VkCommandBuffer command_buffer = device_.beginSingleTimeCommands();
+  VkImageMemoryBarrier to_clear[2] = {
+      depthBarrier(directional_cache_.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                   VK_ACCESS_TRANSFER_WRITE_BIT),
+      depthBarrier(point_cache_.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                   VK_ACCESS_TRANSFER_WRITE_BIT)};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, to_clear);
+
+  VkClearDepthStencilValue far_plane{1.f, 0};
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0,
+                                VK_REMAINING_ARRAY_LAYERS};
+  vkCmdClearDepthStencilImage(command_buffer, directional_cache_.image,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &far_plane,
+                              1, &range);
+  vkCmdClearDepthStencilImage(command_buffer, point_cache_.image,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &far_plane,
+                              1, &range);
+
+  VkImageMemoryBarrier to_source[2] = {
+      depthBarrier(directional_cache_.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+      depthBarrier(point_cache_.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT)};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, to_source);
+  device_.endSingleTimeCommands(command_buffer);
+}
+
+vs_shadow_system::~vs_shadow_system() {
+  for (auto &frame : frames_) {
+    destroyShadowImage(frame.directional);
+    destroyShadowImage(frame.point);
+  }
+  destroyShadowImage(directional_cache_);
+  destroyShadowImage(point_cache_);
+  vkDestroySampler(device_.device(), sampler_, nullptr);
+  vkDestroyPipelineLayout(device_.device(), pipeline_layout_, nullptr);
+  vkDestroyRenderPass(device_.device(), static_render_pass_, nullptr);
+  vkDestroyRenderPass(device_.device(), dynamic_render_pass_, nullptr);
+}
+
+void vs_shadow_system::createRenderPasses() {
+  // static caches are cleared and handed to the copy, the maps of the frame
+  // get the dynamic objects on top of the copied cache. the layouts of the
+  // maps around the dynamic pass are set by the barriers in composite().
+  VkAttachmentDescription depth_attachment{};
+  depth_attachment.format = depth_format_;
+  depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depth_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+  VkAttachmentReference depth_ref{
+      0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 0;
+  subpass.pDepthStencilAttachment = &depth_ref;
+
+  // the last copy out of the cache has to finish before it is cleared, and
+  // the next copy waits for the new depth.
+  std::array<VkSubpassDependency, 2> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  VkRenderPassCreateInfo render_pass_info{};
+  render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_info.attachmentCount = 1;
+  render_pass_info.pAttachments = &depth_attachment;
+  render_pass_info.subpassCount = 1;
+  render_pass_info.pSubpasses = &subpass;
+  render_pass_info.dependencyCount =
+      static_cast<uint32_t>(dependencies.size());
+  render_pass_info.pDependencies = dependencies.data();
+  if (vkCreateRenderPass(device_.device(), &render_pass_info, nullptr,
+                         &static_render_pass_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow render pass");
+  }
+
+  depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  depth_attachment.initialLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depth_attachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  render_pass_info.dependencyCount = 0;
+  render_pass_info.pDependencies = nullptr;
+  if (vkCreateRenderPass(device_.device(), &render_pass_info, nullptr,
+                         &dynamic_render_pass_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow render pass");
+  }
+}
+
+void vs_shadow_system::createPipeline() {
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(shadow_push_constant_data);
+
+  VkPipelineLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = 0;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_constant_range;
+  if (vkCreatePipelineLayout(device_.device(), &layout_info, nullptr,
+                             &pipeline_layout_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow pipeline layout");
+  }
+
+  // depth only from the position stream, the two render passes only differ
+  // in load ops and layouts so one pipeline serves both.
+  pipeline_config_info pipeline_config{};
+  vs_pipeline::defaultPipelineConfigInfo(pipeline_config,
+                                         VK_SAMPLE_COUNT_1_BIT, false);
+  pipeline_config.binding_descriptions =
+      vs_model_component::vertex::getPositionBindingDescriptions();
+  pipeline_config.attribute_descriptions =
+      vs_model_component::vertex::getPositionAttributeDescriptions();
+  pipeline_config.color_blend_info.attachmentCount = 0;
+  pipeline_config.color_blend_info.pAttachments = nullptr;
+  pipeline_config.rasterization_info.depthBiasEnable = VK_TRUE;
+  pipeline_config.rasterization_info.depthBiasConstantFactor = 1.25f;
+  pipeline_config.rasterization_info.depthBiasSlopeFactor = 1.75f;
+  pipeline_config.render_pass = static_render_pass_;
+  pipeline_config.pipeline_layout = pipeline_layout_;
+  pipeline_ = std::make_unique<vs_pipeline>(device_, "shaders/shadow.vert.spv",
+                                            "", pipeline_config);
+}
+
+void vs_shadow_system::createSampler() {
+  // hardware comparison with bilinear filtering, outside the maps is lit.
+  VkSamplerCreateInfo sampler_info{};
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_info.magFilter = VK_FILTER_LINEAR;
+  sampler_info.minFilter = VK_FILTER_LINEAR;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  sampler_info.compareEnable = VK_TRUE;
+  sampler_info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  sampler_info.minLod = 0.f;
+  sampler_info.maxLod = 0.f;
+  if (vkCreateSampler(device_.device(), &sampler_info, nullptr, &sampler_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow sampler");
+  }
+}
+
+vs_shadow_system::shadow_image
+vs_shadow_system::createShadowImage(uint32_t size, uint32_t layers,
+                                    VkImageUsageFlags usage,
+                                    VkRenderPass render_pass) {
+  shadow_image result{};
+  result.size = size;
+  result.layers = layers;
+
+  VkImageCreateInfo image_info{};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType = VK_IMAGE_TYPE_2D;
+  image_info.extent = {size, size, 1};
+  image_info.mipLevels = 1;
+  image_info.arrayLayers = layers;
+  image_info.format = depth_format_;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_info.usage = usage;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  device_.createImageWithInfo(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              result.image, result.memory);
+
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = result.image;
+  view_info.viewType =
+      layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = depth_format_;
+  view_info.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, layers};
+  if (vkCreateImageView(device_.device(), &view_info, nullptr, &result.view) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow image view");
+  }
+
+  result.layer_views.resize(layers);
+  result.framebuffers.resize(layers);
+  for (uint32_t layer = 0; layer < layers; ++layer) {
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, layer, 1};
+    if (vkCreateImageView(device_.device(), &view_info, nullptr,
+                          &result.layer_views[layer]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create shadow layer view");
+    }
+
+    VkFramebufferCreateInfo framebuffer_info{};
+    framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_info.renderPass = render_pass;
+    framebuffer_info.attachmentCount = 1;
+    framebuffer_info.pAttachments = &result.layer_views[layer];
+    framebuffer_info.width = size;
+    framebuffer_info.height = size;
+    framebuffer_info.layers = 1;
+    if (vkCreateFramebuffer(device_.device(), &framebuffer_info, nullptr,
+                            &result.framebuffers[layer]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create shadow framebuffer");
+    }
+  }
+  return result;
+}
+
+void vs_shadow_system::destroyShadowImage(shadow_image &image) {
+  for (auto framebuffer : image.framebuffers) {
+    vkDestroyFramebuffer(device_.device(), framebuffer, nullptr);
+  }
+  for (auto view : image.layer_views) {
+    vkDestroyImageView(device_.device(), view, nullptr);
+  }
+  vkDestroyImageView(device_.device(), image.view, nullptr);
+  vkDestroyImage(device_.device(), image.image, nullptr);
+  vkFreeMemory(device_.device(), image.memory, nullptr);
+  image = shadow_image{};
+}
+
+void vs_shadow_system::assignLights(vs_game_object::map &lights) {
+  slots_.clear();
+  for (auto &kv : lights) {
+    auto &light = *kv.second.point_light_comp;
+    light.shadow_index = -1;
+    if (!light.cast_shadows || slots_.size() == MAX_SHADOWED_POINT_LIGHTS)
+      continue;
+
+    light.shadow_index = static_cast<int32_t>(slots_.size());
+    light_slot slot{};
+    slot.id = kv.first;
+    // never matches a real range, the first update renders every face.
+    slot.range = -1.f;
+    slots_.push_back(slot);
+  }
+  next_slot_ = 0;
+}
+
+void vs_shadow_system::setDirectionalLight(const glm::vec3 &direction,
+                                           const glm::vec4 &color) {
+  sun_direction_ = glm::normalize(direction);
+  sun_color_ = color;
+  // refit on the next update.
+  static_signature_ = 0;
+}
+
+uint64_t
+vs_shadow_system::staticSignature(const vs_game_object::map &game_objects) {
+  // fnv-1a over the ids, models and world matrices of the static objects.
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&hash](const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+  };
+  for (const auto &kv : game_objects) {
+    const auto &object = kv.second;
+    if (object.model_comp == nullptr || !object.isStatic())
+      continue;
+    const vs_model_component *model = object.model_comp.get();
+    mix(&kv.first, sizeof(kv.first));
+    mix(&model, sizeof(model));
+    mix(&object.transform_comp.mat4(), sizeof(glm::mat4));
+  }
+  // 0 is reserved for never fitted.
+  return hash == 0 ? 1 : hash;
+}
+
+void vs_shadow_system::fitDirectional(const vs_game_object::map &game_objects) {
+  // one orthographic map over the bounds of every object at fitting time.
+  glm::vec3 scene_min{std::numeric_limits<float>::max()};
+  glm::vec3 scene_max{-std::numeric_limits<float>::max()};
+  for (const auto &kv : game_objects) {
+    const auto &object = kv.second;
+    if (object.model_comp == nullptr)
+      continue;
+    const auto &bounds = object.model_comp->getBounds();
+    const glm::mat4 &world = object.transform_comp.mat4();
+    for (int i = 0; i < 8; ++i) {
+      const glm::vec3 corner{(i & 1) ? bounds.max.x : bounds.min.x,
+                             (i & 2) ? bounds.max.y : bounds.min.y,
+                             (i & 4) ? bounds.max.z : bounds.min.z};
+      const glm::vec3 world_corner = glm::vec3(world * glm::vec4(corner, 1.f));
+      scene_min = glm::min(scene_min, world_corner);
+      scene_max = glm::max(scene_max, world_corner);
+    }
+  }
+  if (scene_min.x > scene_max.x) {
+    scene_min = glm::vec3{-1.f};
+    scene_max = glm::vec3{1.f};
+  }
+
+  const glm::vec3 center = 0.5f * (scene_min + scene_max);
+  const float radius = glm::max(0.5f * glm::length(scene_max - scene_min), 0.01f);
+  const glm::vec3 up = glm::abs(sun_direction_.y) > 0.99f
+                           ? glm::vec3{0.f, 0.f, 1.f}
+                           : glm::vec3{0.f, 1.f, 0.f};
+  const glm::mat4 view =
+      glm::lookAtRH(center - sun_direction_ * radius, center, up);
+  const glm::mat4 projection =
+      glm::orthoRH_ZO(-radius, radius, -radius, radius, 0.f, 2.f * radius);
+  sun_view_projection_ = projection * view;
+}
+
+void vs_shadow_system::updateLightSlots(const vs_game_object::map &lights) {
+  for (auto &slot : slots_) {
+    auto it = lights.find(slot.id);
+    if (it == lights.end())
+      continue;
+
+    const auto &light = it->second;
+    const glm::vec3 &position = light.transform_comp.getTranslation();
+    const float range = glm::max(
+        vs_light_cluster_system::lightRange(light.point_light_comp->light_intensity),
+        light.transform_comp.getScale().x);
+    if (position == slot.position && range == slot.range)
+      continue;
+
+    slot.position = position;
+    slot.range = range;
+    slot.dirty_faces = ALL_FACES;
+    const glm::mat4 projection = glm::perspectiveRH_ZO(
+        glm::half_pi<float>(), 1.f, POINT_SHADOW_NEAR, range);
+    for (uint32_t face = 0; face < 6; ++face) {
+      slot.face_view_projection[face] =
+          projection *
+          glm::lookAtRH(position, position + face_forward[face], face_up[face]);
+    }
+  }
+}
+
+void vs_shadow_system::update(frame_info &frame_info, global_ubo &ubo) {
+  static_faces_rendered_ = 0;
+
+  const uint64_t signature = staticSignature(frame_info.game_objects);
+  if (signature != static_signature_) {
+    static_signature_ = signature;
+    fitDirectional(frame_info.game_objects);
+    directional_dirty_ = true;
+    for (auto &slot : slots_) {
+      slot.dirty_faces = ALL_FACES;
+    }
+  }
+  updateLightSlots(frame_info.lights);
+
+  renderStaticFaces(frame_info);
+  composite(frame_info);
+  writeSun(ubo);
+}
+
+void vs_shadow_system::writeSun(global_ubo &ubo) const {
+  ubo.sun_view_projection = sun_view_projection_;
+  ubo.sun_direction = glm::vec4(sun_direction_, 0.f);
+  ubo.sun_color = sun_color_;
+}
+
+void vs_shadow_system::renderStaticFaces(frame_info &frame_info) {
+  VkCommandBuffer command_buffer = frame_info.command_buffer;
+
+  if (directional_dirty_ && sun_color_.w > 0.f) {
+    beginPass(command_buffer, static_render_pass_,
+              directional_cache_.framebuffers[0], directional_cache_.size);
+    drawObjects(command_buffer, frame_info.game_objects, sun_view_projection_,
+                false, glm::vec4{0.f});
+    vkCmdEndRenderPass(command_buffer);
+    directional_dirty_ = false;
+    ++static_faces_rendered_;
+  }
+
+  // round robin over the slots so a light that keeps moving can't starve
+  // the others of the budget.
+  uint32_t budget = MAX_STATIC_FACES;
+  const uint32_t slot_count = static_cast<uint32_t>(slots_.size());
+  for (uint32_t n = 0; n < slot_count && budget > 0; ++n) {
+    const uint32_t index = (next_slot_ + n) % slot_count;
+    auto &slot = slots_[index];
+    uint32_t light_budget = STATIC_FACES_PER_LIGHT;
+    for (uint32_t face = 0; face < 6 && light_budget > 0 && budget > 0;
+         ++face) {
+      if ((slot.dirty_faces & (1u << face)) == 0)
+        continue;
+
+      beginPass(command_buffer, static_render_pass_,
+                point_cache_.framebuffers[index * 6 + face],
+                point_cache_.size);
+      drawObjects(command_buffer, frame_info.game_objects,
+                  slot.face_view_projection[face], false,
+                  glm::vec4(slot.position, slot.range));
+      vkCmdEndRenderPass(command_buffer);
+      slot.dirty_faces &= ~(1u << face);
+      --light_budget;
+      --budget;
+      ++static_faces_rendered_;
+    }
+  }
+  if (slot_count > 0) {
+    next_slot_ = (next_slot_ + 1) % slot_count;
+  }
+}
+
+void vs_shadow_system::composite(frame_info &frame_info) {
+  VkCommandBuffer command_buffer = frame_info.command_buffer;
+  auto &frame = frames_[frame_info.frame_index];
+
+  // the fence of this frame was waited on, so the last reads of the maps are
+  // done and their contents can be dropped.
+  VkImageMemoryBarrier to_copy[2] = {
+      depthBarrier(frame.directional.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                   VK_ACCESS_TRANSFER_WRITE_BIT),
+      depthBarrier(frame.point.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                   VK_ACCESS_TRANSFER_WRITE_BIT)};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, to_copy);
+
+  auto copy_cache = [command_buffer](const shadow_image &cache,
+                                     const shadow_image &target) {
+    VkImageCopy region{};
+    region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, cache.layers};
+    region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, cache.layers};
+    region.extent = {cache.size, cache.size, 1};
+    vkCmdCopyImage(command_buffer, cache.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  };
+  copy_cache(directional_cache_, frame.directional);
+  copy_cache(point_cache_, frame.point);
+
+  VkImageMemoryBarrier to_draw[2] = {
+      depthBarrier(frame.directional.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT),
+      depthBarrier(frame.point.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       0, 0, nullptr, 0, nullptr, 2, to_draw);
+
+  bool any_dynamic = false;
+  for (const auto &kv : frame_info.game_objects) {
+    if (kv.second.model_comp != nullptr && !kv.second.isStatic()) {
+      any_dynamic = true;
+      break;
+    }
+  }
+
+  if (any_dynamic && sun_color_.w > 0.f) {
+    beginPass(command_buffer, dynamic_render_pass_,
+              frame.directional.framebuffers[0], frame.directional.size);
+    drawObjects(command_buffer, frame_info.game_objects, sun_view_projection_,
+                true, glm::vec4{0.f});
+    vkCmdEndRenderPass(command_buffer);
+  }
+
+  for (uint32_t index = 0; any_dynamic && index < slots_.size(); ++index) {
+    const auto &slot = slots_[index];
+    for (uint32_t face = 0; face < 6; ++face) {
+      beginPass(command_buffer, dynamic_render_pass_,
+                frame.point.framebuffers[index * 6 + face], frame.point.size);
+      drawObjects(command_buffer, frame_info.game_objects,
+                  slot.face_view_projection[face], true,
+                  glm::vec4(slot.position, slot.range));
+      vkCmdEndRenderPass(command_buffer);
+    }
+  }
+
+  VkImageMemoryBarrier to_sample[2] = {
+      depthBarrier(frame.directional.image,
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                   VK_ACCESS_SHADER_READ_BIT),
+      depthBarrier(frame.point.image,
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                   VK_ACCESS_SHADER_READ_BIT)};
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, to_sample);
+}
+
+void vs_shadow_system::drawObjects(VkCommandBuffer command_buffer,
+                                   const vs_game_object::map &game_objects,
+                                   const glm::mat4 &view_projection,
+                                   bool dynamic,
+                                   const glm::vec4 &light_sphere) {
+  pipeline_->bind(command_buffer);
+
+  for (const auto &kv : game_objects) {
+    const auto &object = kv.second;
+    if (object.model_comp == nullptr || object.isStatic() == dynamic)
+      continue;
+
+    const glm::mat4 &world = object.transform_comp.mat4();
+    if (light_sphere.w > 0.f) {
+      // bounding sphere of the world box against the range of the light.
+      const auto &bounds = object.model_comp->getBounds();
+      const glm::vec3 center = glm::vec3(
+          world * glm::vec4(0.5f * (bounds.min + bounds.max), 1.f));
+      const glm::vec3 half_size = 0.5f * (bounds.max - bounds.min);
+      const float radius =
+          glm::length(glm::vec3{glm::length(glm::vec3(world[0])) * half_size.x,
+                                glm::length(glm::vec3(world[1])) * half_size.y,
+                                glm::length(glm::vec3(world[2])) * half_size.z});
+      if (glm::length(center - glm::vec3(light_sphere)) >
+          light_sphere.w + radius)
+        continue;
+    }
+
+    shadow_push_constant_data push{};
+    push.model_view_projection = view_projection * world;
+    vkCmdPushConstants(command_buffer, pipeline_layout_,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       sizeof(shadow_push_constant_data), &push);
+    object.model_comp->bindPositions(command_buffer);
+    object.model_comp->draw(command_buffer);
+  }
+}
+
+void vs_shadow_system::beginPass(VkCommandBuffer command_buffer,
+                                 VkRenderPass render_pass,
+                                 VkFramebuffer framebuffer, uint32_t size) {
+  VkClearValue clear_value{};
+  clear_value.depthStencil = {1.f, 0};
+
+  VkRenderPassBeginInfo render_pass_info{};
+  render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  render_pass_info.renderPass = render_pass;
+  render_pass_info.framebuffer = framebuffer;
+  render_pass_info.renderArea.offset = {0, 0};
+  render_pass_info.renderArea.extent = {size, size};
+  render_pass_info.clearValueCount = 1;
+  render_pass_info.pClearValues = &clear_value;
+  vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{0.f, 0.f, static_cast<float>(size),
+                      static_cast<float>(size), 0.f, 1.f};
+  VkRect2D scissor{{0, 0}, {size, size}};
+  vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+VkDescriptorImageInfo
+vs_shadow_system::directionalDescriptorInfo(int frame_index) const {
+  return {sampler_, frames_[frame_index].directional.view,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+
+VkDescriptorImageInfo
+vs_shadow_system::pointDescriptorInfo(int frame_index) const {
+  return {sampler_, frames_[frame_index].point.view,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+} // namespace vs
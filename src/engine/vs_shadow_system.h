@@ -0,0 +1,130 @@
+﻿#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "engine/renderer/vs_device.h"
+#include "engine/renderer/vs_pipeline.h"
+#include "engine/vs_frame_info.h"
+
+
+namespace vs
+{
+	// shadow maps of the sun and of up to MAX_SHADOWED_POINT_LIGHTS point lights with cast_shadows set.
+	// every map keeps a cached depth of the static geometry, re-rendered only when the static set or
+	// the light changes. each frame the cache is copied into the map of the frame in flight and the
+	// dynamic objects, anything vs_game_object::isStatic() rejects, are drawn on top of it.
+	// point lights render their 6 faces into consecutive layers of one array, face f of slot s is
+	// layer s * 6 + f, the face bases in the .cpp are repeated by the shaders.
+	// records transfers and render passes, call before the main render pass begins.
+	class vs_shadow_system
+	{
+	public:
+		static constexpr uint32_t MAX_SHADOWED_POINT_LIGHTS = 4;
+		static constexpr uint32_t DIRECTIONAL_SHADOW_SIZE = 2048;
+		static constexpr uint32_t POINT_SHADOW_SIZE = 512;
+		// near plane of the point light faces, matches SHADOW_NEAR of the shaders.
+		static constexpr float POINT_SHADOW_NEAR = 0.05f;
+		// static faces one light and all lights together may re-render per frame, the others keep
+		// their stale cache until a later frame gets to them.
+		static constexpr uint32_t STATIC_FACES_PER_LIGHT = 2;
+		static constexpr uint32_t MAX_STATIC_FACES = 6;
+
+		vs_shadow_system(vs_device& device, int frames_in_flight);
+		~vs_shadow_system();
+
+		vs_shadow_system(const vs_shadow_system&) = delete;
+		vs_shadow_system& operator==(const vs_shadow_system&) = delete;
+
+		// gives the first MAX_SHADOWED_POINT_LIGHTS lights with cast_shadows a slot, written to their
+		// shadow_index, the others get -1. lights with a slot aren't animated.
+		void assignLights(vs_game_object::map& lights);
+		// direction the sun shines in, color w is the intensity, 0 turns it off.
+		void setDirectionalLight(const glm::vec3& direction, const glm::vec4& color);
+
+		// refreshes the static caches within the budgets and composites the maps of
+		// frame_info.frame_index, the sun parameters are written to ubo.
+		void update(frame_info& frame_info, global_ubo& ubo);
+		// the sun parameters without touching the maps, for shaders built without shadows.
+		void writeSun(global_ubo& ubo) const;
+
+		// bindings 5 and 6 of the global set, sampled with depth comparison.
+		VkDescriptorImageInfo directionalDescriptorInfo(int frame_index) const;
+		VkDescriptorImageInfo pointDescriptorInfo(int frame_index) const;
+
+		// static faces re-rendered by the last update, the sun counts as one.
+		uint32_t getStaticFacesRendered() const { return static_faces_rendered_; }
+
+	private:
+		struct shadow_image
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE; // every layer, for sampling
+			std::vector<VkImageView> layer_views;
+			std::vector<VkFramebuffer> framebuffers; // one per layer
+			uint32_t size = 0;
+			uint32_t layers = 0;
+		};
+
+		struct light_slot
+		{
+			vs_game_object::id_t id = 0;
+			glm::vec3 position{0.f};
+			float range = 0.f;
+			uint32_t dirty_faces = 0; // bit f for face f
+			std::array<glm::mat4, 6> face_view_projection{};
+		};
+
+		struct frame_resources
+		{
+			shadow_image directional;
+			shadow_image point;
+		};
+
+		void createRenderPasses();
+		void createPipeline();
+		void createSampler();
+		shadow_image createShadowImage(uint32_t size, uint32_t layers, VkImageUsageFlags usage,
+		                               VkRenderPass render_pass);
+		void destroyShadowImage(shadow_image& image);
+
+		// hash of the static objects and their transforms, refits the sun when it changes.
+		uint64_t staticSignature(const vs_game_object::map& game_objects);
+		void updateLightSlots(const vs_game_object::map& lights);
+		void fitDirectional(const vs_game_object::map& game_objects);
+
+		void renderStaticFaces(frame_info& frame_info);
+		// copies the caches into the maps of the frame and draws the dynamic objects on top.
+		void composite(frame_info& frame_info);
+		// draws the static or the dynamic objects, light_sphere w is the range of a point light and
+		// skips the objects outside of it, 0 draws all of them.
+		void drawObjects(VkCommandBuffer command_buffer, const vs_game_object::map& game_objects,
+		                 const glm::mat4& view_projection, bool dynamic, const glm::vec4& light_sphere);
+		void beginPass(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer,
+		               uint32_t size);
+
+		vs_device& device_;
+		VkFormat depth_format_;
+		VkRenderPass static_render_pass_;
+		VkRenderPass dynamic_render_pass_;
+		VkPipelineLayout pipeline_layout_;
+		std::unique_ptr<vs_pipeline> pipeline_;
+		VkSampler sampler_;
+
+		shadow_image directional_cache_;
+		shadow_image point_cache_;
+		std::vector<frame_resources> frames_;
+
+		std::vector<light_slot> slots_;
+		uint32_t next_slot_ = 0;
+
+		glm::vec3 sun_direction_{0.f, 1.f, 0.f};
+		glm::vec4 sun_color_{0.f};
+		glm::mat4 sun_view_projection_{1.f};
+		bool directional_dirty_ = true;
+		uint64_t static_signature_ = 0;
+		uint32_t static_faces_rendered_ = 0;
+	};
+}
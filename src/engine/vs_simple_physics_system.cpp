@@ -53,8 +53,10 @@ void vs_simple_physics_system::update(const frame_info &frame_info) {
                                      t.getOrientation().y, t.getOrientation().z);
 
 
-    obj.transform_comp.rotation = eulerAngles(rb_quatRot);
-    obj.transform_comp.translation = rb_position;
+    // the orientation maps straight onto the render rotation, bodies at rest
+    // write the same values and stay clean.
+    obj.transform_comp.setRotation(rb_quatRot);
+    obj.transform_comp.setTranslation(rb_position);
   }
 }
 } // namespace vs
@@ -1,11 +1,16 @@
 ﻿#include "vs_simple_render_system.h"
 
+#include "engine/renderer/vs_swap_chain.h"
+#include "engine/vs_material_system.h"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 namespace vs {
@@ -15,17 +20,103 @@ struct simple_push_constant_data {
 };
 
 vs_simple_render_system::vs_simple_render_system(
-    vs_device &device, VkRenderPass render_pass,
-    VkDescriptorSetLayout global_set_layout)
+    vs_device &device, int frames_in_flight,
+    vs_pipeline_compiler &pipeline_compiler, VkRenderPass render_pass,
+    VkDescriptorSetLayout global_set_layout,
+    const shader_permutation &permutation)
     : device_(device) {
+  createInstanceBuffers(frames_in_flight);
+  createStaticCaches(frames_in_flight);
   createPipelineLayout(global_set_layout);
-  createPipeline(render_pass);
+  createPipeline(pipeline_compiler, render_pass, permutation);
 }
 
 vs_simple_render_system::~vs_simple_render_system() {
+  // frees the static secondaries as well.
+  vkDestroyCommandPool(device_.device(), static_command_pool_, nullptr);
   vkDestroyPipelineLayout(device_.device(), pipeline_layout_, nullptr);
 }
 
+void vs_simple_render_system::createInstanceBuffers(int frames_in_flight) {
+  instance_set_layout_ =
+      vs_descriptor_set_layout::vs_builder(device_)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_VERTEX_BIT)
+          .build();
+
+  instance_descriptor_pool_ =
+      vs_descriptor_pool::vs_builder(device_)
+          .setMaxSets(2 * frames_in_flight)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       2 * frames_in_flight)
+          .build();
+
+  // one buffer per frame in flight so the cpu never writes instances the
+  // gpu is still reading.
+  instance_buffers_.resize(frames_in_flight);
+  instance_descriptor_sets_.resize(frames_in_flight);
+  for (size_t i = 0; i < instance_buffers_.size(); ++i) {
+    instance_buffers_[i] = std::make_unique<vs_buffer>(
+        device_, sizeof(instance_data), MAX_INSTANCES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (instance_buffers_[i]->map() != VK_SUCCESS) {
+      throw std::runtime_error("instance buffer could not be mapped");
+    }
+
+    auto buffer_info = instance_buffers_[i]->descriptorInfo();
+    vs_descriptor_writer(*instance_set_layout_, *instance_descriptor_pool_)
+        .writeBuffer(0, &buffer_info)
+        .build(instance_descriptor_sets_[i]);
+  }
+}
+
+void vs_simple_render_system::createStaticCaches(int frames_in_flight) {
+  static_instance_buffers_.resize(frames_in_flight);
+  static_instance_descriptor_sets_.resize(frames_in_flight);
+  for (size_t i = 0; i < static_instance_buffers_.size(); ++i) {
+    static_instance_buffers_[i] = std::make_unique<vs_buffer>(
+        device_, sizeof(instance_data), MAX_INSTANCES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (static_instance_buffers_[i]->map() != VK_SUCCESS) {
+      throw std::runtime_error("instance buffer could not be mapped");
+    }
+
+    auto buffer_info = static_instance_buffers_[i]->descriptorInfo();
+    vs_descriptor_writer(*instance_set_layout_, *instance_descriptor_pool_)
+        .writeBuffer(0, &buffer_info)
+        .build(static_instance_descriptor_sets_[i]);
+  }
+
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex =
+      device_.findPhysicalQueueFamilies().graphicsFamily;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  if (vkCreateCommandPool(device_.device(), &pool_info, nullptr,
+                          &static_command_pool_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create static command pool");
+  }
+
+  static_caches_.resize(frames_in_flight);
+  for (auto &cache : static_caches_) {
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandPool = static_command_pool_;
+    alloc_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device_.device(), &alloc_info,
+                                 &cache.command_buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate static command buffer");
+    }
+  }
+}
+
 void vs_simple_render_system::createPipelineLayout(
     VkDescriptorSetLayout global_set_layout) {
   VkPushConstantRange push_constant_range{};
@@ -34,7 +125,8 @@ void vs_simple_render_system::createPipelineLayout(
   push_constant_range.offset = 0;
   push_constant_range.size = sizeof(simple_push_constant_data);
 
-  std::vector<VkDescriptorSetLayout> descriptor_set_layouts{global_set_layout};
+  std::vector<VkDescriptorSetLayout> descriptor_set_layouts{
+      global_set_layout, instance_set_layout_->getDescriptorSetLayout()};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -51,44 +143,276 @@ void vs_simple_render_system::createPipelineLayout(
   }
 }
 
-void vs_simple_render_system::createPipeline(VkRenderPass render_pass) {
+void vs_simple_render_system::createPipeline(
+    vs_pipeline_compiler &pipeline_compiler, VkRenderPass render_pass,
+    const shader_permutation &permutation) {
   assert(pipeline_layout_ != nullptr &&
          "cannont create pipeline before pipeline layout");
 
-  pipeline_config_info pipeline_config{};
+  // one config per submission, the compiler keeps it until compile().
+  auto makeConfig = [&]() {
+    auto pipeline_config = std::make_unique<pipeline_config_info>();
+    vs_pipeline::defaultPipelineConfigInfo(*pipeline_config,
+                                           device_.msaa_samples, true);
+    pipeline_config->render_pass = render_pass;
+    pipeline_config->pipeline_layout = pipeline_layout_;
+    pipeline_config->permutation = permutation;
+    return pipeline_config;
+  };
+  const std::string frag_path =
+      vs_material_system::fragmentShader(device_, "shaders/simple_shader");
+  pipeline = pipeline_compiler.submit("shaders/simple_shader.vert.spv",
+                                      frag_path, makeConfig());
+  instanced_pipeline_ = pipeline_compiler.submit(
+      "shaders/simple_shader_instanced.vert.spv", frag_path, makeConfig());
+}
 
-  vs_pipeline::defaultPipelineConfigInfo(pipeline_config, device_.msaa_samples,
-                                         true);
-  pipeline_config.render_pass = render_pass;
-  pipeline_config.pipeline_layout = pipeline_layout_;
-  pipeline = std::make_unique<vs_pipeline>(
-      device_, "shaders/simple_shader.vert.spv",
-      "shaders/simple_shader.frag.spv", pipeline_config);
+// view space distance, used for the depth bucket of the sort key.
+static float viewDistance(const frame_info &frame_info,
+                          const vs_game_object &object) {
+  return glm::length(glm::vec3(frame_info.camera.getView() *
+                               glm::vec4(object.transform_comp.getTranslation(), 1.f)));
 }
 
-void vs_simple_render_system::renderGameObjects(frame_info &frame_info) {
-  pipeline->bind(frame_info.command_buffer);
+void vs_simple_render_system::renderGameObjects(frame_info &frame_info,
+                                                vs_draw_stream &draw_stream,
+                                                bool include_static) {
+  draws_.clear();
+  if (frame_info.visible_objects != nullptr) {
+    for (auto *object : *frame_info.visible_objects) {
+      if (!include_static && object->isStatic())
+        continue;
+      draws_.emplace_back(object->model_comp.get(), object);
+    }
+  } else {
+    for (auto &kv : frame_info.game_objects) {
+      auto &object = kv.second;
+      if (object.model_comp == nullptr ||
+          (!include_static && object.isStatic()))
+        continue;
+      draws_.emplace_back(object.model_comp.get(), &object);
+    }
+  }
 
-  vkCmdBindDescriptorSets(frame_info.command_buffer,
-                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0,
-                          1, &frame_info.global_descriptor_set, 0, nullptr);
+  addDraws(frame_info, draw_stream, draws_,
+           *instance_buffers_[frame_info.frame_index],
+           instance_descriptor_sets_[frame_info.frame_index]);
+}
 
+// order independent, the game object map may iterate differently after it
+// grew.
+static uint64_t staticSetSignature(
+    const std::vector<std::pair<vs_model_component *, vs_game_object *>>
+        &draws) {
+  auto mix = [](uint64_t value) {
+    // splitmix64 finalizer
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+  };
+
+  uint64_t signature = mix(draws.size());
+  for (const auto &draw : draws) {
+    // the world matrix, parented objects move without their own transform
+    // changing.
+    uint32_t bits[16];
+    std::memcpy(bits, &draw.second->transform_comp.mat4(), sizeof(bits));
+    uint64_t object_hash =
+        mix(draw.second->getId()) ^ mix(reinterpret_cast<uintptr_t>(draw.first));
+    // the material is baked into the instances and the draw grouping.
+    object_hash = mix(object_hash ^ draw.second->material_id);
+    for (uint32_t value : bits) {
+      object_hash = mix(object_hash ^ value);
+    }
+    signature ^= object_hash;
+  }
+  return signature;
+}
+
+VkCommandBuffer
+vs_simple_render_system::renderStaticObjects(frame_info &frame_info,
+                                             vs_swap_chain &swap_chain) {
+  static_draws_.clear();
   for (auto &kv : frame_info.game_objects) {
     auto &object = kv.second;
-    if (object.model_comp == nullptr)
-      continue;
+    if (object.model_comp != nullptr && object.isStatic())
+      static_draws_.emplace_back(object.model_comp.get(), &object);
+  }
+  if (static_draws_.empty())
+    return VK_NULL_HANDLE;
+
+  auto &cache = static_caches_[frame_info.frame_index];
+  const uint64_t signature = staticSetSignature(static_draws_) ^
+                             reinterpret_cast<uintptr_t>(
+                                 frame_info.global_descriptor_set);
+  const uint64_t pipelines =
+      reinterpret_cast<uintptr_t>(pipeline.get()) ^
+      (reinterpret_cast<uintptr_t>(instanced_pipeline_.get()) << 1);
+  const uint64_t relocation_generation =
+      device_.memoryPool().getRelocationGeneration();
+
+  if (cache.recorded) {
+    bool valid = true;
+    if (cache.signature != signature) {
+      static_cache_stats_.static_set_changes++;
+      valid = false;
+    }
+    if (cache.pipelines != pipelines) {
+      static_cache_stats_.pipeline_changes++;
+      valid = false;
+    }
+    if (cache.swap_chain_id != swap_chain.getId()) {
+      static_cache_stats_.swap_chain_changes++;
+      valid = false;
+    }
+    if (cache.relocation_generation != relocation_generation) {
+      static_cache_stats_.buffer_relocations++;
+      valid = false;
+    }
+    if (valid) {
+      static_cache_stats_.hits++;
+      return cache.command_buffer;
+    }
+  }
+
+  // the fence of this frame has been waited on, neither the buffer nor the
+  // instances are in use anymore.
+  static_stream_.clear();
+  addDraws(frame_info, static_stream_, static_draws_,
+           *static_instance_buffers_[frame_info.frame_index],
+           static_instance_descriptor_sets_[frame_info.frame_index]);
+  static_stream_.sort();
+
+  // no framebuffer, the buffer is executed with every swap chain image.
+  VkCommandBufferInheritanceInfo inheritance_info{};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass = swap_chain.getRenderPass();
+  inheritance_info.subpass = 0;
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance_info;
+  if (vkBeginCommandBuffer(cache.command_buffer, &begin_info) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin static command buffer");
+  }
+
+  const VkExtent2D extent = swap_chain.getSwapChainExtent();
+  VkViewport viewport{0.0f,
+                      0.0f,
+                      static_cast<float>(extent.width),
+                      static_cast<float>(extent.height),
+                      0.0f,
+                      1.0f};
+  VkRect2D scissor{{0, 0}, extent};
+  vkCmdSetViewport(cache.command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(cache.command_buffer, 0, 1, &scissor);
+
+  static_stream_.replay(cache.command_buffer);
+
+  if (vkEndCommandBuffer(cache.command_buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to end static command buffer");
+  }
+
+  cache.recorded = true;
+  cache.signature = signature;
+  cache.pipelines = pipelines;
+  cache.swap_chain_id = swap_chain.getId();
+  cache.relocation_generation = relocation_generation;
+  static_cache_stats_.rebuilds++;
+  return cache.command_buffer;
+}
+
+void vs_simple_render_system::addDraws(frame_info &frame_info,
+                                       vs_draw_stream &draw_stream,
+                                       std::vector<model_draw> &draws,
+                                       vs_buffer &instance_buffer,
+                                       VkDescriptorSet instance_descriptor_set) {
+  if (draws.empty())
+    return;
+
+  // objects sharing a model and material end up next to each other and form
+  // one group. the material id stays uniform within a draw, the fixed texture
+  // array of vs_material_system can't be indexed non uniformly.
+  std::sort(draws.begin(), draws.end(),
+            [](const model_draw &a, const model_draw &b) {
+              if (a.first != b.first)
+                return a.first < b.first;
+              return a.second->material_id < b.second->material_id;
+            });
+
+  const auto instanced_count =
+      std::min<size_t>(draws.size(), MAX_INSTANCES);
+  auto *instances =
+      static_cast<instance_data *>(instance_buffer.getMappedMemory());
+  for (size_t i = 0; i < instanced_count; ++i) {
+    auto &transform = draws[i].second->transform_comp;
+    instances[i].model_matrix = transform.mat4();
+    instances[i].normal_matrix = transform.normal_matrix();
+    // the shaders only read the mat3, the spare corner carries the material.
+    instances[i].normal_matrix[3][3] =
+        static_cast<float>(draws[i].second->material_id);
+  }
+
+  draw_call call{};
+  call.pipeline = instanced_pipeline_.get();
+  call.pipeline_layout = pipeline_layout_;
+  call.descriptor_sets[0] = frame_info.global_descriptor_set;
+  call.descriptor_sets[1] = instance_descriptor_set;
+  call.descriptor_set_count = 2;
+
+  size_t group_begin = 0;
+  while (group_begin < instanced_count) {
+    auto *model = draws[group_begin].first;
+    const uint32_t material_id = draws[group_begin].second->material_id;
+    float nearest = viewDistance(frame_info, *draws[group_begin].second);
+    size_t group_end = group_begin + 1;
+    while (group_end < instanced_count && draws[group_end].first == model &&
+           draws[group_end].second->material_id == material_id) {
+      nearest =
+          std::min(nearest, viewDistance(frame_info, *draws[group_end].second));
+      ++group_end;
+    }
+
+    call.model = model;
+    call.material_id = material_id;
+    call.instance_count = static_cast<uint32_t>(group_end - group_begin);
+    call.first_instance = static_cast<uint32_t>(group_begin);
+    draw_stream.add(draw_pass::opaque, call, nearest);
+    group_begin = group_end;
+  }
+
+  if (instanced_count < draws.size()) {
+    renderPushConstants(frame_info, draw_stream,
+                        draws.cbegin() + instanced_count, draws.cend());
+  }
+}
+
+void vs_simple_render_system::renderPushConstants(
+    frame_info &frame_info, vs_draw_stream &draw_stream,
+    std::vector<model_draw>::const_iterator begin,
+    std::vector<model_draw>::const_iterator end) {
+  draw_call call{};
+  call.pipeline = pipeline.get();
+  call.pipeline_layout = pipeline_layout_;
+  call.descriptor_sets[0] = frame_info.global_descriptor_set;
+  call.descriptor_set_count = 1;
+  call.push_constant_stages =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  for (auto it = begin; it != end; ++it) {
+    auto &object = *it->second;
 
     simple_push_constant_data push{};
 
     push.model_matrix = object.transform_comp.mat4();
     push.normal_matrix = object.transform_comp.normal_matrix();
+    push.normal_matrix[3][3] = static_cast<float>(object.material_id);
 
-    vkCmdPushConstants(frame_info.command_buffer, pipeline_layout_,
-                       VK_SHADER_STAGE_VERTEX_BIT |
-                           VK_SHADER_STAGE_FRAGMENT_BIT,
-                       0, sizeof(simple_push_constant_data), &push);
-    object.model_comp->bind(frame_info.command_buffer);
-    object.model_comp->draw(frame_info.command_buffer);
+    call.model = it->first;
+    call.material_id = object.material_id;
+    draw_stream.add(draw_pass::opaque, call, viewDistance(frame_info, object),
+                    &push, sizeof(simple_push_constant_data));
   }
 }
 } // namespace vs
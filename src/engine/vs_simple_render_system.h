@@ -3,33 +3,112 @@
 
 #include <memory>
 
+#include <utility>
+#include <vector>
+
+#include "engine/renderer/vs_buffer.h"
+#include "engine/renderer/vs_descriptors.h"
 #include "engine/renderer/vs_device.h"
 #include "engine/renderer/vs_pipeline.h"
+#include "engine/renderer/vs_pipeline_compiler.h"
+#include "engine/renderer/vs_swap_chain.h"
+#include "engine/vs_draw_stream.h"
 #include "engine/vs_frame_info.h"
 
 
 namespace vs
 {
+	// per instance data read by simple_shader_instanced.vert, same layout as the push constants.
+	struct instance_data
+	{
+		glm::mat4 model_matrix{1.f};
+		glm::mat4 normal_matrix{1.f};
+	};
+
 	class vs_simple_render_system
 	{
 	public:
-		vs_simple_render_system(vs_device& device, VkRenderPass render_pass, VkDescriptorSetLayout global_set_layout);
+		// instances that fit in one frame's instance buffer, the rest falls back to push constants.
+		static constexpr uint32_t MAX_INSTANCES = 16384;
+
+		// the pipelines are submitted to pipeline_compiler, render once it has compiled them.
+		vs_simple_render_system(vs_device& device, int frames_in_flight, vs_pipeline_compiler& pipeline_compiler,
+		                        VkRenderPass render_pass, VkDescriptorSetLayout global_set_layout,
+		                        const shader_permutation& permutation);
 		~vs_simple_render_system();
 
 
 		vs_simple_render_system(const vs_simple_render_system&) = delete;
 		vs_simple_render_system& operator==(const vs_simple_render_system&) = delete;
 
-		void renderGameObjects(frame_info& frame_info);
+		// how often the static secondaries were reused and why they had to be recorded again.
+		struct static_cache_stats
+		{
+			uint32_t hits = 0;
+			uint32_t rebuilds = 0;
+			uint32_t static_set_changes = 0;
+			uint32_t pipeline_changes = 0;
+			uint32_t swap_chain_changes = 0;
+			uint32_t buffer_relocations = 0;
+		};
+
+		// groups objects by model and material and adds one instanced draw per group to the stream.
+		void renderGameObjects(frame_info& frame_info, vs_draw_stream& draw_stream, bool include_static = true);
+		// secondary with every static object for the render pass of swap_chain, reused until the static set,
+		// the pipelines, the swap chain or the buffer memory change. static objects skip culling.
+		// VK_NULL_HANDLE when there are no static objects.
+		VkCommandBuffer renderStaticObjects(frame_info& frame_info, vs_swap_chain& swap_chain);
+
+		const static_cache_stats& getStaticCacheStats() const { return static_cache_stats_; }
 
 
 	private:
+		using model_draw = std::pair<vs_model_component*, vs_game_object*>;
+
+		// recorded for one frame in flight.
+		struct static_cache
+		{
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+			bool recorded = false;
+			uint64_t signature = 0;
+			uint64_t pipelines = 0;
+			uint64_t swap_chain_id = 0;
+			uint64_t relocation_generation = 0;
+		};
+
+		void createInstanceBuffers(int frames_in_flight);
+		void createStaticCaches(int frames_in_flight);
 		void createPipelineLayout(VkDescriptorSetLayout global_set_layout);
-		void createPipeline(VkRenderPass render_pass);
+		void createPipeline(vs_pipeline_compiler& pipeline_compiler, VkRenderPass render_pass,
+		                    const shader_permutation& permutation);
+
+		void addDraws(frame_info& frame_info, vs_draw_stream& draw_stream, std::vector<model_draw>& draws,
+		              vs_buffer& instance_buffer, VkDescriptorSet instance_descriptor_set);
+		void renderPushConstants(frame_info& frame_info, vs_draw_stream& draw_stream,
+		                         std::vector<model_draw>::const_iterator begin,
+		                         std::vector<model_draw>::const_iterator end);
 
 
 		vs_device& device_;
-		std::unique_ptr<vs_pipeline> pipeline;
+		vs_pipeline_compiler::handle pipeline;
+		vs_pipeline_compiler::handle instanced_pipeline_;
 		VkPipelineLayout pipeline_layout_;
+
+		std::unique_ptr<vs_descriptor_set_layout> instance_set_layout_;
+		std::unique_ptr<vs_descriptor_pool> instance_descriptor_pool_;
+		std::vector<std::unique_ptr<vs_buffer>> instance_buffers_;
+		std::vector<VkDescriptorSet> instance_descriptor_sets_;
+
+		// static objects get their own instance buffers, written only when their secondary is recorded.
+		std::vector<std::unique_ptr<vs_buffer>> static_instance_buffers_;
+		std::vector<VkDescriptorSet> static_instance_descriptor_sets_;
+		VkCommandPool static_command_pool_ = VK_NULL_HANDLE;
+		std::vector<static_cache> static_caches_;
+		static_cache_stats static_cache_stats_{};
+		vs_draw_stream static_stream_;
+
+		// reused between frames to avoid reallocating.
+		std::vector<model_draw> draws_;
+		std::vector<model_draw> static_draws_;
 	};
 }
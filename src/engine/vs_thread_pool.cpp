@@ -0,0 +1,97 @@
+﻿#include "vs_thread_pool.h"
+
+#include <utility>
+
+namespace vs {
+vs_thread_pool::vs_thread_pool(uint32_t worker_count) {
+  workers_.reserve(worker_count);
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&vs_thread_pool::workerLoop, this, i + 1);
+  }
+}
+
+vs_thread_pool::~vs_thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_condition_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+uint32_t vs_thread_pool::defaultWorkerCount() {
+  // hardware_concurrency may report 0 when it can't tell.
+  const uint32_t hardware_threads = std::thread::hardware_concurrency();
+  return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void vs_thread_pool::parallelFor(uint32_t count, const job_function &job) {
+  if (count == 0)
+    return;
+
+  if (workers_.empty() || count == 1) {
+    for (uint32_t i = 0; i < count; ++i) {
+      job(i, 0);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &job;
+    job_count_ = count;
+    next_index_.store(0);
+    busy_workers_ = static_cast<uint32_t>(workers_.size());
+    ++generation_;
+  }
+  work_condition_.notify_all();
+
+  runJobs(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] { return busy_workers_ == 0; });
+  job_ = nullptr;
+  if (job_exception_) {
+    std::rethrow_exception(std::exchange(job_exception_, nullptr));
+  }
+}
+
+void vs_thread_pool::workerLoop(uint32_t worker) {
+  uint64_t seen_generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_condition_.wait(lock, [&] {
+        return stopping_ || generation_ != seen_generation;
+      });
+      if (stopping_)
+        return;
+      seen_generation = generation_;
+    }
+
+    runJobs(worker);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_workers_ == 0)
+      done_condition_.notify_one();
+  }
+}
+
+void vs_thread_pool::runJobs(uint32_t worker) {
+  // indices are handed out one at a time so uneven jobs balance themselves.
+  for (uint32_t index = next_index_.fetch_add(1); index < job_count_;
+       index = next_index_.fetch_add(1)) {
+    try {
+      (*job_)(index, worker);
+    } catch (...) {
+      // the remaining jobs are skipped.
+      next_index_.store(job_count_);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!job_exception_)
+        job_exception_ = std::current_exception();
+    }
+  }
+}
+} // namespace vs
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace vs
+{
+	// persistent worker threads for splitting per frame work, the calling thread joins in as worker 0.
+	// not reentrant, jobs must not call parallelFor themselves.
+	class vs_thread_pool
+	{
+	public:
+		// index of the job and of the thread running it, the worker index is below getThreadCount().
+		using job_function = std::function<void(uint32_t index, uint32_t worker)>;
+
+		// worker_count threads besides the calling one.
+		explicit vs_thread_pool(uint32_t worker_count = defaultWorkerCount());
+		~vs_thread_pool();
+
+		vs_thread_pool(const vs_thread_pool&) = delete;
+		vs_thread_pool& operator==(const vs_thread_pool&) = delete;
+
+		// runs job for every index in [0, count) and returns when all of them are done.
+		// the first exception thrown by a job is rethrown here.
+		void parallelFor(uint32_t count, const job_function& job);
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers_.size()) + 1; }
+
+		static uint32_t defaultWorkerCount();
+
+	private:
+		void workerLoop(uint32_t worker);
+		void runJobs(uint32_t worker);
+
+		std::vector<std::thread> workers_;
+		std::mutex mutex_;
+		std::condition_variable work_condition_;
+		std::condition_variable done_condition_;
+
+		const job_function* job_ = nullptr;
+		uint32_t job_count_ = 0;
+		std::atomic<uint32_t> next_index_{0};
+		uint32_t busy_workers_ = 0;
+		uint64_t generation_ = 0;
+		std::exception_ptr job_exception_;
+		bool stopping_ = false;
+	};
+}
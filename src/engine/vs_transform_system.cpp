@@ -0,0 +1,66 @@
+﻿#include "vs_transform_system.h"
+
+namespace vs {
+void vs_transform_system::update(frame_info &frame_info) {
+  dirty_transforms_.clear();
+  changed_objects_.clear();
+  collectDirty(frame_info.game_objects);
+  collectDirty(frame_info.lights);
+
+  for (auto *transform : dirty_transforms_) {
+    transform->updateMatrices();
+    // this wrote the local matrix, the hierarchy writes the world one back.
+    if (transform->scene_node_ != vs_scene_graph::INVALID_NODE)
+      scene_graph_.setLocalMatrix(transform->scene_node_, transform->mat4());
+  }
+
+  scene_graph_.update();
+  for (auto node : scene_graph_.getUpdatedNodes()) {
+    auto *object = node_objects_[node];
+    object->transform_comp.setWorldMatrix(scene_graph_.getWorldMatrix(node));
+    changed_objects_.push_back(object);
+  }
+}
+
+void vs_transform_system::setParent(vs_game_object &child,
+                                    vs_game_object *parent) {
+  auto child_node = child.transform_comp.getSceneNode();
+  if (child_node == vs_scene_graph::INVALID_NODE) {
+    if (parent == nullptr)
+      return;
+    child_node = addNode(child);
+  }
+
+  auto parent_node = vs_scene_graph::INVALID_NODE;
+  if (parent != nullptr) {
+    parent_node = parent->transform_comp.getSceneNode();
+    if (parent_node == vs_scene_graph::INVALID_NODE)
+      parent_node = addNode(*parent);
+  }
+  scene_graph_.setParent(child_node, parent_node);
+}
+
+void vs_transform_system::collectDirty(vs_game_object::map &objects) {
+  for (auto &kv : objects) {
+    auto &transform = kv.second.transform_comp;
+    if (!transform.isDirty())
+      continue;
+    dirty_transforms_.push_back(&transform);
+    changed_objects_.push_back(&kv.second);
+  }
+}
+
+vs_scene_graph::node_id
+vs_transform_system::addNode(vs_game_object &object) {
+  auto &transform = object.transform_comp;
+  // not parented yet, so the cached matrix is still the local one.
+  transform.updateMatrices();
+  const auto node = scene_graph_.createNode();
+  scene_graph_.setLocalMatrix(node, transform.mat4());
+  if (node >= node_objects_.size())
+    node_objects_.resize(node + 1);
+  node_objects_[node] = &object;
+  transform.scene_node_ = node;
+  return node;
+}
+} // namespace vs
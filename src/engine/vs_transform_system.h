@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "engine/vs_frame_info.h"
+#include "engine/vs_scene_graph.h"
+
+
+namespace vs
+{
+	// recomputes the cached matrices of every transform that changed since the last frame, run after
+	// everything that moves objects and before culling and rendering read them. only the dirty ones
+	// are touched, a quaternion to matrix is a handful of multiplies, so this stays scalar.
+	// parented transforms go through a scene graph afterwards, which only propagates the subtrees
+	// below transforms that changed.
+	class vs_transform_system
+	{
+	public:
+		vs_transform_system() = default;
+
+		vs_transform_system(const vs_transform_system&) = delete;
+		vs_transform_system& operator==(const vs_transform_system&) = delete;
+
+		void update(frame_info& frame_info);
+
+		// the child's transform becomes relative to parent, nullptr makes it a root again. both objects
+		// must already live in their map, the hierarchy keeps pointers to their transforms.
+		void setParent(vs_game_object& child, vs_game_object* parent);
+
+		// transforms recomputed by the last update.
+		size_t getUpdatedCount() const { return dirty_transforms_.size(); }
+		// world matrices propagated through the hierarchy by the last update.
+		size_t getPropagatedCount() const { return scene_graph_.getUpdatedNodes().size(); }
+		// objects whose world matrix the last update changed, recomputed or propagated. an object can
+		// show up twice.
+		const std::vector<vs_game_object*>& getChangedObjects() const { return changed_objects_; }
+
+	private:
+		void collectDirty(vs_game_object::map& objects);
+		vs_scene_graph::node_id addNode(vs_game_object& object);
+
+		std::vector<transform_component*> dirty_transforms_;
+		std::vector<vs_game_object*> changed_objects_;
+
+		vs_scene_graph scene_graph_;
+		// by node id.
+		std::vector<vs_game_object*> node_objects_;
+	};
+}
@@ -1,9 +1,22 @@
 #include "vs_app.h"
 #include "vs_camera.h"
+#include "vs_deferred_lighting_system.h"
+#include "vs_draw_stream.h"
+#include "vs_frustum_culling_system.h"
+#include "vs_indirect_render_system.h"
+#include "vs_light_cluster_system.h"
+#include "vs_light_compute_system.h"
+#include "vs_memory_pool.h"
 #include "vs_movement_component.h"
+#include "vs_occlusion_culling_system.h"
+#include "vs_pipeline_compiler.h"
 #include "vs_point_light_render_system.h"
+#include "vs_secondary_recorder.h"
+#include "vs_shadow_system.h"
 #include "vs_simple_physics_system.h"
 #include "vs_simple_render_system.h"
+#include "vs_thread_pool.h"
+#include "vs_transform_system.h"
 // libs
 #define GLM_LANG_STL11_FORCED
 #define GLM_FORCE_RADIANS
@@ -17,61 +30,162 @@
 
 namespace vs {
 
-vs_app::vs_app() {
+vs_app::vs_app() : vs_app(settings{}) {}
+
+vs_app::vs_app(const settings &settings)
+    : renderer_{window_, device_, sizeof(global_ubo), settings.frames_in_flight},
+      cache_static_geometry_{settings.cache_static_geometry},
+      cpu_occlusion_culling_{settings.cpu_occlusion_culling},
+      shadows_{settings.shadows}, log_draw_stats_{settings.log_draw_stats} {
+  // texture 0 and material 0 are the defaults every object starts with.
+  material_system_ = std::make_unique<vs_material_system>(device_);
+  material_system_->addTexture(
+      renderer_.getSwapChain()->getSwapChainTextureImageView(),
+      renderer_.getSwapChain()->getSwapChainTextureSampler());
+  material_system_->addMaterial({});
+  if (!material_system_->isBindless()) {
+    std::cout << "descriptor indexing is not supported, materials share "
+              << vs_material_system::FIXED_TEXTURES << " textures"
+              << std::endl;
+  }
+
   global_descriptor_pool_ =
       vs_descriptor_pool::vs_builder(device_)
-          .setMaxSets(vs_swap_chain::MAX_FRAMES_IN_FLIGHT)
+          .setMaxSets(renderer_.getFramesInFlight())
+          // update after bind when the texture array is bindless.
+          .setPoolFlags(material_system_->getPoolFlags())
           .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                       vs_swap_chain::MAX_FRAMES_IN_FLIGHT)
+                       renderer_.getFramesInFlight())
           .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                       vs_swap_chain::MAX_FRAMES_IN_FLIGHT)
+                       (2 + material_system_->getTextureCapacity()) *
+                           renderer_.getFramesInFlight())
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       4 * renderer_.getFramesInFlight())
           .build();
+
+  // the indirect draws start at their object's instance, without
+  // drawIndirectFirstInstance the cpu path renders instead.
+  gpu_driven_rendering_ = settings.gpu_driven_rendering &&
+                          device_.draw_indirect_first_instance_supported;
+  if (settings.gpu_driven_rendering && !gpu_driven_rendering_) {
+    std::cout << "drawIndirectFirstInstance is not supported, rendering "
+                 "through the cpu path"
+              << std::endl;
+  }
 }
 
 vs_app::~vs_app() {}
 
+void vs_app::pollToggleKeys() {
+  if (keyPressed(RENDER_PATH_KEY, render_path_key_down_)) {
+    if (gpu_driven_rendering_ ||
+        device_.draw_indirect_first_instance_supported) {
+      gpu_driven_rendering_ = !gpu_driven_rendering_;
+      std::cout << "render path: "
+                << (gpu_driven_rendering_ ? "gpu driven" : "cpu") << std::endl;
+    } else {
+      std::cout << "drawIndirectFirstInstance is not supported, staying on "
+                   "the cpu path"
+                << std::endl;
+    }
+  }
+  if (keyPressed(STATIC_CACHE_KEY, static_cache_key_down_)) {
+    cache_static_geometry_ = !cache_static_geometry_;
+    std::cout << "static geometry cache: "
+              << (cache_static_geometry_ ? "on" : "off") << std::endl;
+  }
+  if (keyPressed(CPU_OCCLUSION_KEY, cpu_occlusion_key_down_)) {
+    cpu_occlusion_culling_ = !cpu_occlusion_culling_;
+    std::cout << "cpu occlusion culling: "
+              << (cpu_occlusion_culling_ ? "on" : "off") << std::endl;
+  }
+}
+
+bool vs_app::keyPressed(int key, bool &key_down) {
+  const bool was_down = key_down;
+  key_down = glfwGetKey(window_.getGLFWwindow(), key) == GLFW_PRESS;
+  return key_down && !was_down;
+}
+
 void vs_app::run() {
 
   loadGameObjects();
 
-  /* UBO BUFFERS
+  // workers for per frame cpu jobs
+  vs_thread_pool thread_pool{};
+
+  // render systems submit their pipelines here, compiled together below
+  vs_pipeline_compiler pipeline_compiler{device_, thread_pool};
+  // specialization constants of the model and lighting shaders
+  shader_permutation permutation{};
+  permutation.shadows = shadows_ ? VK_TRUE : VK_FALSE;
+
+  // point lights sorted into clusters, its buffers are part of the global set
+  vs_light_cluster_system light_cluster_system{
+      device_, renderer_.getFramesInFlight(), thread_pool};
+
+  // sun and point light shadow maps, sampled through the global set
+  vs_shadow_system shadow_system{device_, renderer_.getFramesInFlight()};
+  // without shadows every light keeps shadow_index -1 and is animated.
+  if (shadows_) {
+    shadow_system.assignLights(lights_);
+  }
+  // +y is down, the sun comes in from above at an angle
+  shadow_system.setDirectionalLight(glm::vec3{.3f, 1.f, .2f},
+                                    {1.f, .95f, .85f, .6f});
+
+  /* GLOBAL DESCRIPTORS
    * *****************************************************************************/
   /******************************************************************************************/
-  std::vector<std::unique_ptr<vs_buffer>> ubo_buffers{
-      vs_swap_chain::MAX_FRAMES_IN_FLIGHT};
-  for (int i = 0; i < ubo_buffers.size(); ++i) {
-    ubo_buffers[i] = std::make_unique<vs_buffer>(
-        device_, sizeof(global_ubo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-    if (ubo_buffers[i]->map() != VK_SUCCESS) {
-      throw std::runtime_error("global ubo could not be mapped");
-    }
-  }
+  // the global ubo lives in the uniform slice of every frame context, the
+  // clustered lights in the storage buffers of the light cluster system.
   // could be abstracted to a Master render system instead.
   auto global_set_layout =
       vs_descriptor_set_layout::vs_builder(device_)
           .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                       VK_SHADER_STAGE_ALL_GRAPHICS)
-          .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_VERTEX_BIT |
+                          VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(vs_material_system::TEXTURES_BINDING,
+                      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                      VK_SHADER_STAGE_FRAGMENT_BIT,
+                      material_system_->getTextureCapacity(),
+                      material_system_->getTextureBindingFlags())
+          .addBinding(vs_material_system::MATERIALS_BINDING,
+                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                       VK_SHADER_STAGE_FRAGMENT_BIT)
           .build();
 
-  VkDescriptorImageInfo imageInfo{};
-
-  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  imageInfo.imageView =
-      renderer_.getSwapChain()->getSwapChainTextureImageView();
-  imageInfo.sampler = renderer_.getSwapChain()->getSwapChainTextureSampler();
-
-  std::vector<VkDescriptorSet> global_descriptor_sets(
-      vs_swap_chain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < global_descriptor_sets.size(); ++i) {
-    auto buffer_info = ubo_buffers[i]->descriptorInfo();
+  for (int i = 0; i < renderer_.getFramesInFlight(); ++i) {
+    auto &frame_context = renderer_.getFrame(i);
+    auto buffer_info = frame_context.uniformDescriptorInfo();
+    auto lights_info = light_cluster_system.lightsDescriptorInfo(i);
+    auto clusters_info = light_cluster_system.clustersDescriptorInfo(i);
+    auto light_indices_info =
+        light_cluster_system.lightIndicesDescriptorInfo(i);
+    auto sun_shadow_info = shadow_system.directionalDescriptorInfo(i);
+    auto point_shadows_info = shadow_system.pointDescriptorInfo(i);
+    VkDescriptorSet global_descriptor_set;
     vs_descriptor_writer(*global_set_layout, *global_descriptor_pool_)
         .writeBuffer(0, &buffer_info)
-        .writeImage(1, &imageInfo)
-        .build(global_descriptor_sets[i]);
+        .writeBuffer(2, &lights_info)
+        .writeBuffer(3, &clusters_info)
+        .writeBuffer(4, &light_indices_info)
+        .writeImage(5, &sun_shadow_info)
+        .writeImage(6, &point_shadows_info)
+        .build(global_descriptor_set);
+    // the texture array and material buffer are written by the material system.
+    material_system_->registerSet(global_descriptor_set);
+    frame_context.setGlobalDescriptorSet(global_descriptor_set);
   }
 
   /* RENDER SYSTEMS
@@ -80,14 +194,68 @@ void vs_app::run() {
 
   // simple models renderer
   vs_simple_render_system simple_render_system{
-      device_, renderer_.getSwapChainRenderPass(),
-      global_set_layout->getDescriptorSetLayout()};
+      device_, renderer_.getFramesInFlight(), pipeline_compiler,
+      renderer_.getSwapChainRenderPass(), global_set_layout->getDescriptorSetLayout(), permutation};
+
+  // gpu driven models renderer
+  vs_indirect_render_system indirect_render_system{
+      device_, renderer_.getFramesInFlight(),
+      renderer_.getSwapChainRenderPass(),
+      renderer_.getDeferredRenderPass(),
+      global_set_layout->getDescriptorSetLayout(), permutation};
+
+  // lighting subpass of the deferred path and the choice of path
+  vs_deferred_lighting_system deferred_lighting_system{
+      device_, pipeline_compiler, renderer_.getDeferredRenderPass(),
+      global_set_layout->getDescriptorSetLayout(), permutation};
+
+  // world matrices of the objects that moved this frame
+  vs_transform_system transform_system{};
+
+  // cpu frustum culling, feeds the model render systems
+  vs_frustum_culling_system frustum_culling_system{};
+
+  // cpu occlusion culling, runs on the frustum culled objects
+  vs_occlusion_culling_system occlusion_culling_system{thread_pool};
+
+  // sorted draws of the simple and point light systems
+  vs_draw_stream draw_stream{};
+
+  // records the sorted draws on the worker threads
+  vs_secondary_recorder secondary_recorder{
+      device_, renderer_.getFramesInFlight(), thread_pool};
+  std::vector<VkCommandBuffer> frame_secondaries;
 
   // point light system
   vs_point_light_render_system point_light_render_system{
-      device_, renderer_.getSwapChainRenderPass(),
+      device_, pipeline_compiler, renderer_.getSwapChainRenderPass(),
+      renderer_.getDeferredRenderPass(),
       global_set_layout->getDescriptorSetLayout()};
 
+  // gpu animation and clustering of the point lights
+  vs_light_compute_system light_compute_system{
+      device_, renderer_.getFramesInFlight(), light_cluster_system};
+  if (GPU_LIGHT_UPDATE) {
+    light_compute_system.upload(lights_);
+  }
+
+  // the submitted pipelines are created in parallel on the workers
+  const uint32_t compiled_count = pipeline_compiler.getPendingCount();
+  const auto compile_start = std::chrono::high_resolution_clock::now();
+  pipeline_compiler.compile();
+  const float compile_time =
+      std::chrono::duration<float, std::milli>(
+          std::chrono::high_resolution_clock::now() - compile_start)
+          .count();
+
+  // every pipeline exists now, compare a first run with the next one. the
+  // creation time is summed over the threads, the compile time is wall clock.
+  std::cout << "pipeline creation: " << device_.getPipelineCreationTime()
+            << " ms (" << (device_.isPipelineCacheWarm() ? "warm" : "cold")
+            << " cache), " << compiled_count << " compiled in parallel in "
+            << compile_time << " ms, " << pipeline_compiler.getVariantHits()
+            << " shared with an identical variant" << std::endl;
+
   // phyics system
   vs_simple_physics_system physics_system{};
   // set up some rigid bodies
@@ -106,16 +274,18 @@ void vs_app::run() {
   /****************************************************************************/
   vs_camera camera{};
   auto camera_objet = vs_game_object::createGameObject();
-  camera_objet.transform_comp.translation.z = -8.f;
+  camera_objet.transform_comp.setTranslation({0.f, 0.f, -8.f});
   vs_movement_component movement_controller{window_.getGLFWwindow()};
 
   /*FRAME TIME*/
   auto currentTime = std::chrono::high_resolution_clock::now();
+  float stats_time = 0.f;
 
   /*MAIN LOOP******************************************************************/
   /****************************************************************************/
   while (!window_.shouldClose()) {
     glfwPollEvents();
+    pollToggleKeys();
 
     // frame time
     auto newTime = std::chrono::high_resolution_clock::now();
@@ -138,12 +308,18 @@ void vs_app::run() {
     if (auto command_buffer = renderer_.beginFrame()) {
       // start frame & create frame info
       int frame_index = renderer_.getFrameIndex();
+      auto &frame_context = renderer_.getCurrentFrame();
+
+      // compact device local memory a little every frame, keeps long
+      // sessions from failing allocations with plenty of free space left.
+      device_.memoryPool().defragment(DEFRAG_BYTES_PER_FRAME,
+                                      renderer_.getFramesInFlight());
 
       frame_info frame{frame_index,
                        frameTime,
                        command_buffer,
                        camera,
-                       global_descriptor_sets[frame_index],
+                       frame_context.getGlobalDescriptorSet(),
                        game_objects_,
                        lights_};
 
@@ -151,32 +327,169 @@ void vs_app::run() {
       // player movement
       movement_controller.moveInPlaneXZ(window_.getGLFWwindow(), frameTime,
                                         camera_objet);
-      camera.setViewYXZ(camera_objet.transform_comp.translation,
-                        camera_objet.transform_comp.rotation);
+      camera.setViewYXZ(camera_objet.transform_comp.getTranslation(),
+                        camera_objet.transform_comp.getEulerRotation());
 
       // global ubo
       global_ubo ubo{};
       ubo.projection = camera.getProjection();
       ubo.view = camera.getView();
       ubo.ambient_light_color = {.8f, .8f, .8f, .2f};
-      ubo.cam_pos = glm::vec4(camera_objet.transform_comp.translation, 1.0f);
-
-      point_light_render_system.update(frame, ubo);
+      ubo.cam_pos =
+          glm::vec4(camera_objet.transform_comp.getTranslation(), 1.0f);
+
+      // the compute path is recorded outside the render pass
+      if (GPU_LIGHT_UPDATE) {
+        light_compute_system.update(
+            frame, renderer_.getSwapChain()->getSwapChainExtent(), ubo);
+      } else {
+        point_light_render_system.update(frame);
+        light_cluster_system.update(
+            frame, renderer_.getSwapChain()->getSwapChainExtent(), ubo);
+      }
 
       // physics
       physics_system.update(frame);
 
+      // everything that moves objects has run, cache their matrices
+      transform_system.update(frame);
+
+      // static shadow pages and the dynamic objects on top, recorded outside
+      // the render pass and writes the sun into the ubo
+      if (shadows_) {
+        shadow_system.update(frame, ubo);
+      } else {
+        shadow_system.writeSun(ubo);
+      }
+
       // write updates to buffer
-      ubo_buffers[frame_index]->writeToIndex(&ubo, frame_index);
-      ubo_buffers[frame_index]->flush();
+      frame_context.writeUniform(&ubo);
+
+      // culling
+      frustum_culling_system.cull(frame, transform_system.getChangedObjects());
+      if (cpu_occlusion_culling_ && !gpu_driven_rendering_) {
+        occlusion_culling_system.cull(frame);
+      }
 
       // Render
-      // Begin
-      renderer_.beginSwapChainRenderPass(command_buffer);
+      // culling dispatch has to be recorded outside the render pass
+      if (gpu_driven_rendering_) {
+        indirect_render_system.cull(frame, *renderer_.getSwapChain());
+      }
+
+      // forward or deferred, from the light count and the overdraw. the gpu
+      // path only knows how many lights it uploaded, not how many are visible.
+      const uint32_t light_count = GPU_LIGHT_UPDATE
+                                       ? light_compute_system.getLightCount()
+                                       : light_cluster_system.getLightCount();
+      const render_path path =
+          DEFERRED_SHADING && gpu_driven_rendering_
+              ? deferred_lighting_system.selectPath(frame, light_count)
+              : render_path::forward;
+      renderer_.setRenderPath(path);
+
+      // collect and sort the draws of this frame
+      draw_stream.clear();
+      if (!gpu_driven_rendering_) {
+        simple_render_system.renderGameObjects(frame, draw_stream,
+                                               !cache_static_geometry_);
+      }
+      if (GPU_LIGHT_UPDATE) {
+        point_light_render_system.renderIndirect(
+            frame, draw_stream, light_compute_system.getDrawBuffer(frame_index),
+            path);
+      } else {
+        point_light_render_system.render(frame, draw_stream, light_count, path);
+      }
+      draw_stream.sort();
 
       // my frame rendering
-      simple_render_system.renderGameObjects(frame);
-      point_light_render_system.render(frame);
+      if (gpu_driven_rendering_) {
+        // Begin
+        renderer_.beginSwapChainRenderPass(command_buffer);
+        indirect_render_system.renderGameObjects(frame, path);
+
+        // retest what the first pass found occluded against its own depth,
+        // then continue drawing on top of it. a deferred pass has to run
+        // through its lighting subpass, the lighting waits for the second one
+        if (path == render_path::deferred) {
+          renderer_.nextSubpass(command_buffer);
+        }
+        renderer_.endSwapChainRenderPass(command_buffer);
+        indirect_render_system.cullDisoccluded(
+            frame, *renderer_.getSwapChain(), renderer_.getImageIndex());
+        renderer_.beginSwapChainRenderPass(command_buffer, true);
+        indirect_render_system.renderDisoccluded(frame, path);
+        if (path == render_path::deferred) {
+          renderer_.nextSubpass(command_buffer);
+          deferred_lighting_system.render(frame, *renderer_.getSwapChain(),
+                                          renderer_.getImageIndex());
+        }
+        draw_stream.replay(command_buffer);
+      } else {
+        // record on the workers, executed in order by the render pass
+        secondary_recorder.beginFrame(frame_index);
+        secondary_target target{
+            renderer_.getSwapChainRenderPass(),
+            renderer_.getSwapChain()->getFrameBuffer(
+                static_cast<int>(renderer_.getImageIndex())),
+            renderer_.getSwapChain()->getSwapChainExtent()};
+        // static geometry first, the sorted stream holds the transparent
+        // draws that have to come after it
+        frame_secondaries.clear();
+        if (cache_static_geometry_) {
+          if (auto static_buffer = simple_render_system.renderStaticObjects(
+                  frame, *renderer_.getSwapChain())) {
+            frame_secondaries.push_back(static_buffer);
+          }
+        }
+        const auto &secondaries =
+            draw_stream.replayParallel(secondary_recorder, target);
+        frame_secondaries.insert(frame_secondaries.end(), secondaries.begin(),
+                                 secondaries.end());
+        renderer_.beginSwapChainRenderPass(command_buffer, frame_secondaries);
+      }
+
+      if (log_draw_stats_) {
+        stats_time += frameTime;
+        if (stats_time >= 1.f) {
+          const auto &stats = draw_stream.getStats();
+          std::cout << "draws: " << stats.draws
+                    << " pipeline binds: " << stats.pipeline_binds << " ("
+                    << stats.pipeline_binds_skipped << " skipped)"
+                    << " descriptor binds: " << stats.descriptor_binds << " ("
+                    << stats.descriptor_binds_skipped << " skipped)"
+                    << " vertex binds: " << stats.vertex_binds << " ("
+                    << stats.vertex_binds_skipped << " skipped)" << std::endl;
+          if (cache_static_geometry_ && !gpu_driven_rendering_) {
+            const auto &cache = simple_render_system.getStaticCacheStats();
+            std::cout << "static cache hits: " << cache.hits
+                      << " rebuilds: " << cache.rebuilds
+                      << " (set: " << cache.static_set_changes
+                      << " pipeline: " << cache.pipeline_changes
+                      << " swap chain: " << cache.swap_chain_changes
+                      << " relocation: " << cache.buffer_relocations << ")"
+                      << std::endl;
+          }
+          if (cpu_occlusion_culling_ && !gpu_driven_rendering_) {
+            std::cout << "frustum culled: "
+                      << frustum_culling_system.getCulledCount()
+                      << " occlusion culled: "
+                      << occlusion_culling_system.getCulledCount()
+                      << std::endl;
+          }
+          if (DEFERRED_SHADING && gpu_driven_rendering_) {
+            std::cout << "path: "
+                      << (path == render_path::deferred ? "deferred"
+                                                        : "forward")
+                      << " overdraw: " << deferred_lighting_system.getOverdraw()
+                      << std::endl;
+          }
+          std::cout << "static shadow faces: "
+                    << shadow_system.getStaticFacesRendered() << std::endl;
+          stats_time = 0.f;
+        }
+      }
 
       // END
       renderer_.endSwapChainRenderPass(command_buffer);
@@ -196,6 +509,10 @@ void vs_app::createWorld(vs_simple_physics_system *physicssystem) {
     floor.rigid_body_comp->rigidBody->enableGravity(false);
     floor.rigid_body_comp->rigidBody->setType(reactphysics3d::BodyType::STATIC);
     floor.rigid_body_comp->rigidBody->setIsActive(true);
+    floor.addOccluderComponent();
+    // tints the default texture gray.
+    floor.material_id = material_system_->addMaterial(
+        {.base_color = {.6f, .6f, .6f, 1.f}});
 
     game_objects_.emplace(floor.getId(), std::move(floor));
   }
@@ -210,6 +527,12 @@ void vs_app::loadGameObjects() {
 
   /** SPINNING POINT LIGHTS **/
   createSpinningPointLights();
+
+  // a fixed lamp above the room that casts shadows
+  auto lamp = vs_game_object::createPointLight(20.f);
+  lamp.transform_comp.setTranslation({0.f, -3.f, 0.f});
+  lamp.point_light_comp->cast_shadows = true;
+  lights_.emplace(lamp.getId(), std::move(lamp));
 }
 void vs_app::createSpinningPointLights() {
   std::vector<glm::vec3> lightColors{
@@ -224,9 +547,9 @@ void vs_app::createSpinningPointLights() {
         glm::mat4(1.f), (i * glm::two_pi<float>()) / lightColors.size(),
         {0.f, -2.f, 0.f});
 
-    point_light.transform_comp.translation =
+    point_light.transform_comp.setTranslation(
         glm::vec3{0.f, -1.f, 0.f} +
-        glm::vec3(rotate_light * glm::vec4(-8.f, -1.f, -1.f, 1.f));
+        glm::vec3(rotate_light * glm::vec4(-8.f, -1.f, -1.f, 1.f)));
 
     lights_.emplace(point_light.getId(), std::move(point_light));
   }
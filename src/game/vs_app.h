@@ -3,7 +3,9 @@
 #include "vs_asset_manager.h"
 #include "vs_descriptors.h"
 #include "vs_device.h"
+#include "vs_frame_info.h"
 #include "vs_game_object.h"
+#include "vs_material_system.h"
 #include "vs_renderer.h"
 #include "vs_simple_physics_system.h"
 #include "vs_window.h"
@@ -22,8 +24,50 @@ public:
   static constexpr float aspect_ratio = 16.f / 9.f;
   static constexpr int HEIGHT = 1280;
   static constexpr int WIDTH = HEIGHT*aspect_ratio;
+  // device local bytes the memory pool may move per frame when defragmenting.
+  static constexpr VkDeviceSize DEFRAG_BYTES_PER_FRAME = 4 * 1024 * 1024;
+  // cull and build draw lists on the gpu instead of the simple render system.
+  static constexpr bool GPU_DRIVEN_RENDERING = true;
+  // hide objects behind tagged occluders on the cpu path, the gpu driven path
+  // already does this with hi-z.
+  static constexpr bool CPU_OCCLUSION_CULLING = true;
+  // keep the draws of objects that never move in a secondary command buffer
+  // that is only re-recorded when the static set changes.
+  static constexpr bool CACHE_STATIC_GEOMETRY = true;
+  // animate, frustum cull and cluster the point lights in compute shaders, the
+  // cpu path is kept to verify the gpu one against.
+  static constexpr bool GPU_LIGHT_UPDATE = true;
+  // let vs_deferred_lighting_system switch the gpu driven path to deferred
+  // shading when the scene has many lights and a lot of overdraw.
+  static constexpr bool DEFERRED_SHADING = true;
+  // render the sun and point light shadow maps, without them the shaders are
+  // built with the SHADOWS permutation off and never sample the maps.
+  static constexpr bool SHADOWS = true;
+  // print draw and bind counts of the sorted draw stream once a second.
+  static constexpr bool LOG_DRAW_STATS = false;
+  // frames the cpu may record ahead of the gpu, 3 hides more cpu spikes at
+  // the cost of a frame of latency and more per-frame buffers.
+  static constexpr int FRAMES_IN_FLIGHT = vs_swap_chain::DEFAULT_FRAMES_IN_FLIGHT;
+
+  // what the app starts with, the flags above are the defaults. main() fills
+  // this from the command line.
+  struct settings {
+    bool gpu_driven_rendering = GPU_DRIVEN_RENDERING;
+    bool cache_static_geometry = CACHE_STATIC_GEOMETRY;
+    bool cpu_occlusion_culling = CPU_OCCLUSION_CULLING;
+    bool shadows = SHADOWS;
+    bool log_draw_stats = LOG_DRAW_STATS;
+    int frames_in_flight = FRAMES_IN_FLIGHT;
+  };
+  // F2 switches between the gpu driven and the cpu render path while running,
+  // F3 and F4 turn the static geometry cache and the occlusion culling of the
+  // cpu path on and off.
+  static constexpr int RENDER_PATH_KEY = GLFW_KEY_F2;
+  static constexpr int STATIC_CACHE_KEY = GLFW_KEY_F3;
+  static constexpr int CPU_OCCLUSION_KEY = GLFW_KEY_F4;
 
   vs_app();
+  explicit vs_app(const settings &settings);
   ~vs_app();
 
   vs_app(const vs_app &) = delete;
@@ -33,16 +77,35 @@ public:
 
 private:
   void loadGameObjects();
+  // switches the render path, the static cache and the cpu occlusion culling
+  // on key presses, before the frame is recorded.
+  void pollToggleKeys();
+  // true on the frame key goes down.
+  bool keyPressed(int key, bool &key_down);
 
   vs_window window_{WIDTH, HEIGHT, "Vulkan App"};
   vs_device device_{window_};
-  vs_renderer renderer_{window_, device_};
+  // built with settings.frames_in_flight, see vs_app().
+  vs_renderer renderer_;
   vs_asset_manager asset_manager{device_};
 
   // order of declaration matters (pool need to be constructed after device and
   // destroyed before device.)
 
   std::unique_ptr<vs_descriptor_pool> global_descriptor_pool_{};
+  // bindless textures and materials of the global set, game objects pick
+  // theirs by material id.
+  std::unique_ptr<vs_material_system> material_system_{};
+  // settings.gpu_driven_rendering where the device supports it, see vs_app().
+  bool gpu_driven_rendering_ = false;
+  bool cache_static_geometry_ = CACHE_STATIC_GEOMETRY;
+  bool cpu_occlusion_culling_ = CPU_OCCLUSION_CULLING;
+  // fixed at startup, it picks the permutation the pipelines are built with.
+  bool shadows_ = SHADOWS;
+  bool log_draw_stats_ = LOG_DRAW_STATS;
+  bool render_path_key_down_ = false;
+  bool static_cache_key_down_ = false;
+  bool cpu_occlusion_key_down_ = false;
   vs_game_object::map game_objects_;
   vs_game_object::map lights_;
   void createWorld(vs_simple_physics_system *physicssystem);
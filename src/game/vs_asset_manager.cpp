@@ -30,9 +30,9 @@ vs_game_object vs_asset_manager::spawnGameObject(const std::string &model_name,
       throw std::runtime_error(
           "failed to create a game object, model was not preloaded.");
     }
-    object.transform_comp.translation = position;
-    object.transform_comp.rotation = rotation;
-    object.transform_comp.scale = scale;
+    object.transform_comp.setTranslation(position);
+    object.transform_comp.setEulerRotation(rotation);
+    object.transform_comp.setScale(scale);
     object.color = {1.f, 1.f, 1.f};
     object.model_comp = model->second;
   }
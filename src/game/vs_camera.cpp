@@ -76,4 +76,29 @@ namespace vs
 		view_matrix[3][1] = -glm::dot(v, position);
 		view_matrix[3][2] = -glm::dot(w, position);
 	}
+
+	std::array<glm::vec4, 6> vs_camera::getFrustumPlanes() const
+	{
+		// Gribb & Hartmann, planes are combinations of the rows of the view projection matrix.
+		// clip space is x,y in [-w, w] and z in [0, w].
+		const glm::mat4 m = projection_matrix * view_matrix;
+		const glm::vec4 row0{m[0][0], m[1][0], m[2][0], m[3][0]};
+		const glm::vec4 row1{m[0][1], m[1][1], m[2][1], m[3][1]};
+		const glm::vec4 row2{m[0][2], m[1][2], m[2][2], m[3][2]};
+		const glm::vec4 row3{m[0][3], m[1][3], m[2][3], m[3][3]};
+
+		std::array<glm::vec4, 6> planes{
+			row3 + row0,
+			row3 - row0,
+			row3 + row1,
+			row3 - row1,
+			row2,
+			row3 - row2
+		};
+		for (auto& plane : planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return planes;
+	}
 }
@@ -6,6 +6,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+// std
+#include <array>
+
 namespace vs
 {
 	class vs_camera
@@ -21,6 +24,10 @@ namespace vs
 		const glm::mat4 getProjection() const { return projection_matrix; }
 		const glm::mat4 getView() const { return view_matrix; }
 
+		// world space planes (xyz normal pointing inwards, w distance) in the order
+		// left, right, top, bottom, near, far. a point p is inside when dot(xyz, p) + w >= 0.
+		std::array<glm::vec4, 6> getFrustumPlanes() const;
+
 	private:
 		glm::mat4 projection_matrix{1.f};
 		glm::mat4 view_matrix{1.f};
@@ -3,76 +3,49 @@
 #include "vs_simple_physics_system.h"
 #include <glm/gtc/quaternion.hpp>
 
-namespace vs {
-glm::mat4 transform_component::mat4() {
-  const float c3 = glm::cos(rotation.z);
-  const float s3 = glm::sin(rotation.z);
-  const float c2 = glm::cos(rotation.x);
-  const float s2 = glm::sin(rotation.x);
-  const float c1 = glm::cos(rotation.y);
-  const float s1 = glm::sin(rotation.y);
-  return glm::mat4{{
-                       scale.x * (c1 * c3 + s1 * s2 * s3),
-                       scale.x * (c2 * s3),
-                       scale.x * (c1 * s2 * s3 - c3 * s1),
-                       0.0f,
-                   },
-                   {
-                       scale.y * (c3 * s1 * s2 - c1 * s3),
-                       scale.y * (c2 * c3),
-                       scale.y * (c1 * c3 * s2 + s1 * s3),
-                       0.0f,
-                   },
-                   {
-                       scale.z * (c2 * s1),
-                       scale.z * (-s2),
-                       scale.z * (c1 * c2),
-                       0.0f,
-                   },
-                   {translation.x, translation.y, translation.z, 1.0f}};
-}
-
-glm::mat3 transform_component::normal_matrix() {
-  const float c3 = glm::cos(rotation.z);
-  const float s3 = glm::sin(rotation.z);
-  const float c2 = glm::cos(rotation.x);
-  const float s2 = glm::sin(rotation.x);
-  const float c1 = glm::cos(rotation.y);
-  const float s1 = glm::sin(rotation.y);
-  const glm::vec3 inv_scale = 1.0f / scale;
-
-  return glm::mat3{
-      {inv_scale.x * (c1 * c3 + s1 * s2 * s3), inv_scale.x * (c2 * s3),
-       inv_scale.x * (c1 * s2 * s3 - c3 * s1)},
-      {
-          inv_scale.y * (c3 * s1 * s2 - c1 * s3),
-          inv_scale.y * (c2 * c3),
-          inv_scale.y * (c1 * c3 * s2 + s1 * s3),
-      },
-      {
-          inv_scale.z * (c2 * s1),
-          inv_scale.z * (-s2),
-          inv_scale.z * (c1 * c2),
-      },
-
-  };
-}
+// std
+#include <stdexcept>
 
+namespace vs {
 vs_game_object vs_game_object::createPointLight(float intensity, float radius,
                                                 glm::vec3 color) {
   vs_game_object object = vs_game_object::createGameObject();
   object.color = color;
-  object.transform_comp.scale.x = radius;
+  object.transform_comp.setScale({radius, 1.f, 1.f});
   object.point_light_comp = std::make_unique<point_light_component>();
   object.point_light_comp->light_intensity = intensity;
   return object;
 }
+bool vs_game_object::isStatic() const {
+  return rigid_body_comp == nullptr ||
+         rigid_body_comp->rigidBody->getType() ==
+             reactphysics3d::BodyType::STATIC;
+}
+
 void vs_game_object::addPhysicsComponent(
     vs_simple_physics_system *physicssystem,
     reactphysics3d::CollisionShapeName shape) {
 
   rigid_body_comp = std::make_unique<rigid_body_component>(
-      transform_comp, physicssystem, shape, transform_comp.scale);
+      transform_comp, physicssystem, shape, transform_comp.getScale());
+}
+
+void vs_game_object::addOccluderComponent() {
+  if (model_comp == nullptr) {
+    throw std::runtime_error("occluder needs a model to take its bounds from");
+  }
+
+  const auto &bounds = model_comp->getBounds();
+  occluder_comp = std::make_shared<occluder_component>();
+  for (int i = 0; i < 8; ++i) {
+    occluder_comp->vertices.emplace_back((i & 1) ? bounds.max.x : bounds.min.x,
+                                         (i & 2) ? bounds.max.y : bounds.min.y,
+                                         (i & 4) ? bounds.max.z : bounds.min.z);
+  }
+  // two triangles per face of the box, corner bits are x, y and z.
+  occluder_comp->indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+                            0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+                            0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
 }
 
 rigid_body_component::rigid_body_component(
@@ -102,10 +75,11 @@ rigid_body_component::rigid_body_component(
       break;
     }
 
-    glm::quat rot_quat = glm::quat_cast(transform_comp.mat4());
+    const glm::quat &rot_quat = transform_comp.getRotation();
+    const glm::vec3 &translation = transform_comp.getTranslation();
     transform = reactphysics3d::Transform(
-        {transform_comp.translation.x, transform_comp.translation.y-0.1f,
-         transform_comp.translation.z},
+        {translation.x, translation.y-0.1f,
+         translation.z},
         {rot_quat.x, rot_quat.y, rot_quat.z, rot_quat.w});
 
     rigidBody = physicssystem->physics_world->createRigidBody(transform);
@@ -114,9 +88,9 @@ rigid_body_component::rigid_body_component(
 
     transform.setOrientation({rot_quat.x, rot_quat.y, rot_quat.z, rot_quat.w});
 
-    transform.setPosition({transform_comp.translation.x,
-                           transform_comp.translation.y,
-                           transform_comp.translation.z});
+    transform.setPosition({translation.x,
+                           translation.y,
+                           translation.z});
 
     collider->getMaterial().setBounciness(0);
     rigidBody->setType(reactphysics3d::BodyType::DYNAMIC);
@@ -1,28 +1,19 @@
 ﻿#pragma once
 #include "vs_model_component.h"
+#include "vs_transform_component.h"
 
 // std
 #include <memory>
 #include <unordered_map>
+#include <vector>
 // libs
 #include "reactphysics3d/reactphysics3d.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 namespace vs {
 class vs_simple_physics_system;
 
-struct transform_component {
-  glm::vec3 translation{};
-  glm::vec3 scale{1.f, 1.f, 1.f};
-  glm::vec3 rotation;
-
-  // Matrix corresponds to Translate * Ry * Rx * Rz * Scale
-  // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
-  // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-  glm::mat4 mat4();
-
-  glm::mat3 normal_matrix();
-};
 struct rigid_body_component {
   rigid_body_component(transform_component transform_comp,
                        vs_simple_physics_system *physicssystem,
@@ -37,6 +28,16 @@ struct rigid_body_component {
 
 struct point_light_component {
   float light_intensity = 1.0f;
+  // set before vs_shadow_system::assignLights, which writes shadow_index.
+  bool cast_shadows = false;
+  int32_t shadow_index = -1;
+};
+
+// simplified model space mesh the cpu occlusion culling rasterizes, should
+// stay inside the rendered model so it never hides more than the model does.
+struct occluder_component {
+  std::vector<glm::vec3> vertices;
+  std::vector<uint32_t> indices;
 };
 
 class vs_game_object {
@@ -62,18 +63,29 @@ public:
   }
 
   glm::vec3 color{};
+  // index into the material buffer of vs_material_system.
+  uint32_t material_id = 0;
   transform_component transform_comp{};
 
   // optional pointer components
   std::shared_ptr<vs_model_component> model_comp;
   std::shared_ptr<point_light_component> point_light_comp;
   std::shared_ptr<rigid_body_component> rigid_body_comp;
+  std::shared_ptr<occluder_component> occluder_comp;
+
+  // objects without a rigid body or with a static one never move, the static
+  // caches of the render and shadow systems record them once. Inactive bodies
+  // are not static, they may be activated again.
+  bool isStatic() const;
 
   void addPhysicsComponent(vs_simple_physics_system *physicssystem,
                            reactphysics3d::CollisionShapeName shape =
                                reactphysics3d::CollisionShapeName::BOX);
   void addPhysicsComponent(vs_simple_physics_system *physicssystem,
                            reactphysics3d::ConcaveMeshShape *mesh_shape);
+  // tags the object as an occluder using the bounds of its model, only for
+  // solid box like models such as walls and floors.
+  void addOccluderComponent();
 
 private:
   explicit vs_game_object(id_t obj_id) : id_(obj_id){};
@@ -11,6 +11,7 @@
 // std
 #include <cassert>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 
 namespace std {
@@ -28,10 +29,21 @@ namespace vs {
 vs_model_component::vs_model_component(
     vs_device &device, const vs_model_component::builder &builder)
     : device_(device) {
+  // vertex and index uploads share one submission.
+  vs_transfer_batch transfer_batch{device_};
 
   createVertexBuffers(builder.vertices);
+  createPositionBuffer(builder.vertices);
   createIndexBuffers(builder.indices);
+  transfer_batch.submit();
   string_name = builder.name;
+
+  bounds_.min = glm::vec3{std::numeric_limits<float>::max()};
+  bounds_.max = glm::vec3{-std::numeric_limits<float>::max()};
+  for (const auto &v : builder.vertices) {
+    bounds_.min = glm::min(bounds_.min, v.position);
+    bounds_.max = glm::max(bounds_.max, v.position);
+  }
 }
 
 vs_model_component::~vs_model_component() {}
@@ -55,21 +67,55 @@ void vs_model_component::createVertexBuffers(
   VkDeviceSize buffer_size = sizeof(vertices[0]) * vertex_count_;
   uint32_t vertex_size = sizeof(vertices[0]);
 
-  vs_buffer staging_buffer{device_, vertex_size, vertex_count_,
-                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  auto staging_buffer = std::make_shared<vs_buffer>(
+      device_, vertex_size, vertex_count_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-  staging_buffer.map();
-  staging_buffer.writeToBuffer((void *)vertices.data());
+  staging_buffer->map();
+  staging_buffer->writeToBuffer((void *)vertices.data());
 
   vertex_buffer_ = std::make_unique<vs_buffer>(
       device_, vertex_size, vertex_count_,
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  device_.copyBuffer(staging_buffer.getBuffer(), vertex_buffer_->getBuffer(),
+  device_.copyBuffer(staging_buffer->getBuffer(), vertex_buffer_->getBuffer(),
                      buffer_size);
+  // keep the staging memory alive until the batched copy has executed.
+  device_.releaseAfterTransfer(
+      [staging_buffer]() mutable { staging_buffer.reset(); });
+}
+
+void vs_model_component::createPositionBuffer(
+    const std::vector<vertex> &vertices) {
+  // a third of the full vertex, depth only passes fetch far less memory.
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto &v : vertices) {
+    positions.push_back(v.position);
+  }
+  uint32_t position_size = sizeof(positions[0]);
+
+  auto staging_buffer = std::make_shared<vs_buffer>(
+      device_, position_size, vertex_count_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  staging_buffer->map();
+  staging_buffer->writeToBuffer((void *)positions.data());
+
+  position_buffer_ = std::make_unique<vs_buffer>(
+      device_, position_size, vertex_count_,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  device_.copyBuffer(staging_buffer->getBuffer(),
+                     position_buffer_->getBuffer(),
+                     position_size * vertex_count_);
+  // keep the staging memory alive until the batched copy has executed.
+  device_.releaseAfterTransfer(
+      [staging_buffer]() mutable { staging_buffer.reset(); });
 }
 
 void vs_model_component::createIndexBuffers(
@@ -82,28 +128,35 @@ void vs_model_component::createIndexBuffers(
   VkDeviceSize buffer_size = sizeof(indices[0]) * index_count_;
   uint32_t index_size = sizeof(indices[0]);
 
-  vs_buffer staging_buffer{device_, index_size, index_count_,
-                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  auto staging_buffer = std::make_shared<vs_buffer>(
+      device_, index_size, index_count_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-  staging_buffer.map();
-  staging_buffer.writeToBuffer((void *)indices.data());
+  staging_buffer->map();
+  staging_buffer->writeToBuffer((void *)indices.data());
 
   index_buffer_ = std::make_unique<vs_buffer>(
       device_, index_size, index_count_,
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  device_.copyBuffer(staging_buffer.getBuffer(), index_buffer_->getBuffer(),
+  device_.copyBuffer(staging_buffer->getBuffer(), index_buffer_->getBuffer(),
                      buffer_size);
+  // keep the staging memory alive until the batched copy has executed.
+  device_.releaseAfterTransfer(
+      [staging_buffer]() mutable { staging_buffer.reset(); });
 }
 
-void vs_model_component::draw(VkCommandBuffer command_buffer) {
+void vs_model_component::draw(VkCommandBuffer command_buffer,
+                              uint32_t instance_count,
+                              uint32_t first_instance) {
   if (has_index_buffer_) {
-    vkCmdDrawIndexed(command_buffer, index_count_, 1, 0, 0, 0);
+    vkCmdDrawIndexed(command_buffer, index_count_, instance_count, 0, 0,
+                     first_instance);
   } else {
-    vkCmdDraw(command_buffer, vertex_count_, 1, 0, 0);
+    vkCmdDraw(command_buffer, vertex_count_, instance_count, 0,
+              first_instance);
   }
 }
 
@@ -118,6 +171,17 @@ void vs_model_component::bind(VkCommandBuffer command_buffer) {
   }
 }
 
+void vs_model_component::bindPositions(VkCommandBuffer command_buffer) {
+  VkBuffer buffers[] = {position_buffer_->getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+
+  if (has_index_buffer_) {
+    vkCmdBindIndexBuffer(command_buffer, index_buffer_->getBuffer(), 0,
+                         VK_INDEX_TYPE_UINT32);
+  }
+}
+
 std::vector<VkVertexInputBindingDescription>
 vs_model_component::vertex::getBindingDescriptions() {
   std::vector<VkVertexInputBindingDescription> binding_descriptions(1);
@@ -144,6 +208,20 @@ vs_model_component::vertex::getAttributeDescriptions() {
 
   return attribute_descriptions;
 }
+
+std::vector<VkVertexInputBindingDescription>
+vs_model_component::vertex::getPositionBindingDescriptions() {
+  std::vector<VkVertexInputBindingDescription> binding_descriptions(1);
+  binding_descriptions[0].binding = 0;
+  binding_descriptions[0].stride = sizeof(glm::vec3);
+  binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return binding_descriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription>
+vs_model_component::vertex::getPositionAttributeDescriptions() {
+  return {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}};
+}
 #pragma clang diagnostic pop
 
 void vs_model_component::builder::loadModel(const std::string &obj_file,
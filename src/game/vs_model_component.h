@@ -25,6 +25,11 @@ public:
     getBindingDescriptions();
     static std::vector<VkVertexInputAttributeDescription>
     getAttributeDescriptions();
+    // position only stream of bindPositions(), for depth only passes.
+    static std::vector<VkVertexInputBindingDescription>
+    getPositionBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription>
+    getPositionAttributeDescriptions();
 
     bool operator==(const vertex &other) const {
       return position == other.position && color == other.color &&
@@ -32,6 +37,12 @@ public:
     }
   };
 
+  // model space axis aligned bounds, used for culling.
+  struct bounding_box {
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+  };
+
   struct builder {
     std::vector<vertex> vertices{};
     std::vector<uint32_t> indices{};
@@ -53,16 +64,27 @@ public:
 
 
   void bind(VkCommandBuffer command_buffer);
-  void draw(VkCommandBuffer command_buffer);
+  // binds the tightly packed positions instead of the full vertices, the
+  // index buffer is shared.
+  void bindPositions(VkCommandBuffer command_buffer);
+  void draw(VkCommandBuffer command_buffer, uint32_t instance_count = 1,
+            uint32_t first_instance = 0);
+
+  const bounding_box &getBounds() const { return bounds_; }
+  bool hasIndexBuffer() const { return has_index_buffer_; }
+  uint32_t getIndexCount() const { return index_count_; }
+  uint32_t getVertexCount() const { return vertex_count_; }
 
   std::string string_name;
 private:
   void createVertexBuffers(const std::vector<vertex> &vertices);
+  void createPositionBuffer(const std::vector<vertex> &vertices);
   void createIndexBuffers(const std::vector<uint32_t> &indices);
 
   vs_device &device_;
 
   std::unique_ptr<vs_buffer> vertex_buffer_;
+  std::unique_ptr<vs_buffer> position_buffer_;
   uint32_t vertex_count_ = 0;
 
   bool has_index_buffer_ = false;
@@ -70,5 +92,7 @@ private:
   std::unique_ptr<vs_buffer> index_buffer_;
   uint32_t index_count_ = 0;
 
+  bounding_box bounds_{};
+
 };
 }; // namespace vs
\ No newline at end of file
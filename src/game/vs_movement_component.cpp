@@ -25,6 +25,7 @@ void vs_movement_component::init(GLFWwindow *window) {
 void vs_movement_component::moveInPlaneXZ(GLFWwindow *window, float dt,
                                           vs_game_object &game_object) {
   glm::vec3 rotate{0};
+  glm::vec3 rotation = game_object.transform_comp.getEulerRotation();
 
 
   if (glfwGetInputMode(window, GLFW_RAW_MOUSE_MOTION) == GLFW_TRUE) {
@@ -39,7 +40,7 @@ void vs_movement_component::moveInPlaneXZ(GLFWwindow *window, float dt,
 
     if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
       glm::vec3 n = mouse_speed * dt * glm::normalize(rotate);
-      game_object.transform_comp.rotation += n;
+      rotation += n;
 
     }
     rotate = {0.f, 0.f, 0.f};
@@ -56,17 +57,15 @@ void vs_movement_component::moveInPlaneXZ(GLFWwindow *window, float dt,
     rotate.x -= 1.f;
 
   if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
-    game_object.transform_comp.rotation +=
-        keyboard_look_speed * dt * glm::normalize(rotate);
+    rotation += keyboard_look_speed * dt * glm::normalize(rotate);
   }
 
   // limit pitch and yaw;
-  game_object.transform_comp.rotation.x =
-      glm::clamp(game_object.transform_comp.rotation.x, -1.5f, 1.5f);
-  game_object.transform_comp.rotation.y =
-      glm::mod(game_object.transform_comp.rotation.y, glm::two_pi<float>());
+  rotation.x = glm::clamp(rotation.x, -1.5f, 1.5f);
+  rotation.y = glm::mod(rotation.y, glm::two_pi<float>());
+  game_object.transform_comp.setEulerRotation(rotation);
 
-  float yaw = game_object.transform_comp.rotation.y;
+  float yaw = rotation.y;
   const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
   const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
   const glm::vec3 upDir{0.f, -1.f, 0.f};
@@ -89,7 +88,8 @@ void vs_movement_component::moveInPlaneXZ(GLFWwindow *window, float dt,
   if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon()) {
     glm::vec3 delta = (move_speed + mouse_speed_scroll_modifier) * dt *
                       glm::normalize(moveDir);
-    game_object.transform_comp.translation += delta;
+    game_object.transform_comp.setTranslation(
+        game_object.transform_comp.getTranslation() + delta);
   }
 
   // other
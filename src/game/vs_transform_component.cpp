@@ -0,0 +1,52 @@
+﻿
+#include "vs_transform_component.h"
+
+namespace vs {
+bool transform_component::updateMatrices() {
+  if (!dirty_)
+    return false;
+
+  // rotation is unit length, so its matrix needs no trig and no normalization.
+  const glm::mat3 rotation = glm::mat3_cast(rotation_);
+  world_matrix_ = glm::mat4{glm::vec4{rotation[0] * scale_.x, 0.0f},
+                            glm::vec4{rotation[1] * scale_.y, 0.0f},
+                            glm::vec4{rotation[2] * scale_.z, 0.0f},
+                            glm::vec4{translation_, 1.0f}};
+
+  const glm::vec3 inv_scale = 1.0f / scale_;
+  normal_matrix_ = glm::mat3{rotation[0] * inv_scale.x,
+                             rotation[1] * inv_scale.y,
+                             rotation[2] * inv_scale.z};
+
+  dirty_ = false;
+  return true;
+}
+
+glm::vec3 transform_component::getEulerRotation() const {
+  // R = Ry * Rx * Rz, the third column is (cos(x) sin(y), -sin(x),
+  // cos(x) cos(y)) and gives x and y. z comes from Ry^T * R = Rx * Rz, whose
+  // first column is (cos(z), cos(x) sin(z), ..), so it stays exact near the
+  // poles where only y + z or y - z is defined.
+  const glm::mat3 r = glm::mat3_cast(rotation_);
+  const float y = glm::atan(r[2][0], r[2][2]);
+  const float x =
+      glm::atan(-r[2][1], glm::sqrt(r[2][0] * r[2][0] + r[2][2] * r[2][2]));
+  const float c1 = glm::cos(y);
+  const float s1 = glm::sin(y);
+  const float z = glm::atan(s1 * r[1][2] - c1 * r[1][0],
+                            c1 * r[0][0] - s1 * r[0][2]);
+  return {x, y, z};
+}
+
+void transform_component::setEulerRotation(const glm::vec3 &rotation) {
+  setRotation(glm::angleAxis(rotation.y, glm::vec3{0.f, 1.f, 0.f}) *
+              glm::angleAxis(rotation.x, glm::vec3{1.f, 0.f, 0.f}) *
+              glm::angleAxis(rotation.z, glm::vec3{0.f, 0.f, 1.f}));
+}
+
+void transform_component::setWorldMatrix(const glm::mat4 &world_matrix) {
+  world_matrix_ = world_matrix;
+  // parents may scale non uniformly, so take the general inverse transpose.
+  normal_matrix_ = glm::transpose(glm::inverse(glm::mat3(world_matrix)));
+}
+} // namespace vs
@@ -0,0 +1,90 @@
+﻿#pragma once
+#include "vs_scene_graph.h"
+
+// std
+#include <cassert>
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// glm only, so the tests build it without the physics and vulkan of
+// vs_game_object.
+namespace vs {
+// the matrices are cached, the setters mark them dirty when a value actually
+// changes and vs_transform_system recomputes all dirty ones in one pass before
+// rendering. Objects that don't move cost nothing after their first frame.
+// The rotation is kept as a normalized quaternion, euler angles only exist at
+// the edges for code that edits yaw and pitch directly, like the camera.
+// Transforms parented through vs_transform_system are relative to the parent,
+// mat4() is always the world matrix.
+class transform_component {
+public:
+  const glm::vec3 &getTranslation() const { return translation_; }
+  const glm::quat &getRotation() const { return rotation_; }
+  const glm::vec3 &getScale() const { return scale_; }
+
+  void setTranslation(const glm::vec3 &translation) {
+    if (translation != translation_) {
+      translation_ = translation;
+      dirty_ = true;
+    }
+  }
+  void setRotation(const glm::quat &rotation) {
+    const glm::quat normalized = glm::normalize(rotation);
+    if (normalized != rotation_) {
+      rotation_ = normalized;
+      dirty_ = true;
+    }
+  }
+  // Tait-bryan angles of Y(1), X(2), Z(3), see mat4(). x comes back in
+  // [-pi/2, pi/2], y and z in [-pi, pi].
+  glm::vec3 getEulerRotation() const;
+  void setEulerRotation(const glm::vec3 &rotation);
+  void setScale(const glm::vec3 &scale) {
+    if (scale != scale_) {
+      scale_ = scale;
+      dirty_ = true;
+    }
+  }
+
+  bool isDirty() const { return dirty_; }
+  // recomputes the matrices if they are dirty, returns true if it did.
+  bool updateMatrices();
+
+  // Matrix corresponds to Translate * Rotate * Scale, with euler angles the
+  // rotation is Ry * Rx * Rz (Tait-bryan angles of Y(1), X(2), Z(3))
+  // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+  // both are only valid after updateMatrices(), they can be read from any
+  // thread once it ran.
+  const glm::mat4 &mat4() const {
+    assert(!dirty_ && "transform read before its matrices were updated");
+    return world_matrix_;
+  }
+
+  const glm::mat3 &normal_matrix() const {
+    assert(!dirty_ && "transform read before its matrices were updated");
+    return normal_matrix_;
+  }
+
+  // node in the transform system's hierarchy, INVALID_NODE when the transform
+  // was never parented.
+  vs_scene_graph::node_id getSceneNode() const { return scene_node_; }
+
+private:
+  friend class vs_transform_system;
+
+  // replaces the local matrices with the world ones of the hierarchy.
+  void setWorldMatrix(const glm::mat4 &world_matrix);
+
+  glm::vec3 translation_{};
+  glm::vec3 scale_{1.f, 1.f, 1.f};
+  glm::quat rotation_{1.f, 0.f, 0.f, 0.f};
+
+  glm::mat4 world_matrix_{1.f};
+  glm::mat3 normal_matrix_{1.f};
+  bool dirty_ = true;
+  vs_scene_graph::node_id scene_node_ = vs_scene_graph::INVALID_NODE;
+};
+} // namespace vs
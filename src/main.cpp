@@ -1,10 +1,71 @@
 #include "game/vs_app.h"
 #include <iostream>
 #include <cstdlib>
+#include <string>
 
-int main()
+namespace
 {
-	vs::vs_app app{};
+	void printUsage(const char* program)
+	{
+		std::cerr << "usage: " << program << " [--gpu-path | --cpu-path] [--no-static-cache] [--no-cpu-occlusion] [--no-shadows] [--frames-in-flight <n>] [--stats]\n"
+			<< "  --gpu-path         cull and build the draws on the gpu (default where supported)\n"
+			<< "  --cpu-path         cull on the cpu and record the draws on the worker threads\n"
+			<< "  --no-static-cache  record the static objects of the cpu path every frame\n"
+			<< "  --no-cpu-occlusion don't hide objects behind occluders on the cpu path\n"
+			<< "  --no-shadows       build the shaders without shadows and skip the shadow maps\n"
+			<< "  --frames-in-flight record up to n frames ahead of the gpu, 2 (default) or 3\n"
+			<< "  --stats            print draw, bind and static cache counts once a second\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	vs::vs_app::settings settings{};
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--gpu-path")
+		{
+			settings.gpu_driven_rendering = true;
+		}
+		else if (arg == "--cpu-path")
+		{
+			settings.gpu_driven_rendering = false;
+		}
+		else if (arg == "--no-static-cache")
+		{
+			settings.cache_static_geometry = false;
+		}
+		else if (arg == "--no-cpu-occlusion")
+		{
+			settings.cpu_occlusion_culling = false;
+		}
+		else if (arg == "--no-shadows")
+		{
+			settings.shadows = false;
+		}
+		else if (arg == "--frames-in-flight" && i + 1 < argc)
+		{
+			settings.frames_in_flight = std::atoi(argv[++i]);
+			if (settings.frames_in_flight < 1 ||
+				settings.frames_in_flight > vs::vs_swap_chain::MAX_FRAMES_IN_FLIGHT)
+			{
+				printUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (arg == "--stats")
+		{
+			settings.log_draw_stats = true;
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	vs::vs_app app{settings};
 
 	try
 	{
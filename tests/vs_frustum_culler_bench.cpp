@@ -0,0 +1,127 @@
+#include "vs_test.h"
+
+#include "engine/vs_frustum_culler.h"
+#include "game/vs_camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times what vs_frustum_culling_system does per frame with a large scene:
+// rebuilding every world box like it did before the store was maintained,
+// updating only the boxes of the objects that moved, and culling with the
+// simd kernels and the scalar reference. The results of both culls are
+// compared, so the benchmark doubles as a check at full size.
+namespace {
+using vs::vs_frustum_culler;
+
+constexpr int FRAMES = 100;
+// share of the objects that move every frame.
+constexpr float MOVING_SHARE = 0.01f;
+
+struct object {
+  glm::vec3 min;
+  glm::vec3 max;
+  glm::mat4 world_matrix;
+};
+
+glm::mat4 randomPlacement(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> position{-500.f, 500.f};
+  std::uniform_real_distribution<float> angle{0.f, 6.28f};
+  const glm::mat4 world = glm::translate(
+      glm::mat4{1.f}, {position(rng), position(rng) * 0.1f, position(rng)});
+  return glm::rotate(world, angle(rng), {0.f, 1.f, 0.f});
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  // ctest runs a small scene, pass an object count for the real one.
+  const size_t count = argc > 1 ? std::stoul(argv[1]) : 100000;
+  const size_t moving = std::max<size_t>(1, count * MOVING_SHARE);
+
+  std::mt19937 rng{1};
+  std::uniform_real_distribution<float> size{0.5f, 4.f};
+  std::vector<object> objects(count);
+  for (auto &o : objects) {
+    o.min = -0.5f * glm::vec3{size(rng), size(rng), size(rng)};
+    o.max = -o.min;
+    o.world_matrix = randomPlacement(rng);
+  }
+
+  // rebuilt recomputes every box each frame, culler only the moved ones.
+  vs_frustum_culler culler;
+  vs_frustum_culler rebuilt;
+  std::vector<vs_frustum_culler::handle> handles;
+  for (const auto &o : objects) {
+    handles.push_back(culler.add(o.min, o.max, o.world_matrix));
+    rebuilt.add(o.min, o.max, o.world_matrix);
+  }
+
+  vs::vs_camera camera{};
+  camera.setPerspectiveProjection(glm::radians(60.f), 16.f / 9.f, 0.1f, 300.f);
+
+  std::vector<size_t> moved(moving);
+  std::vector<vs_frustum_culler::handle> visible;
+  std::vector<vs_frustum_culler::handle> reference;
+  std::vector<vs_frustum_culler::handle> rebuilt_visible;
+  double rebuild_ms = 0.0;
+  double incremental_ms = 0.0;
+  double simd_ms = 0.0;
+  double scalar_ms = 0.0;
+  size_t visible_total = 0;
+
+  for (int frame = 0; frame < FRAMES; ++frame) {
+    // the same objects move for both updates.
+    for (auto &index : moved) {
+      index = rng() % count;
+      objects[index].world_matrix = randomPlacement(rng);
+    }
+
+    rebuild_ms += vs::test::timeMs([&] {
+      for (size_t i = 0; i < count; ++i) {
+        rebuilt.setWorldMatrix(handles[i], objects[i].world_matrix);
+      }
+    });
+    incremental_ms += vs::test::timeMs([&] {
+      for (auto index : moved) {
+        culler.setWorldMatrix(handles[index], objects[index].world_matrix);
+      }
+    });
+
+    const float yaw = 6.28f * static_cast<float>(frame) / FRAMES;
+    camera.setViewDirection({0.f, -20.f, 0.f},
+                            {glm::sin(yaw), 0.f, glm::cos(yaw)});
+    const auto planes = camera.getFrustumPlanes();
+    simd_ms += vs::test::timeMs([&] { culler.cull(planes, visible); });
+    scalar_ms += vs::test::timeMs([&] { culler.cullScalar(planes, reference); });
+    visible_total += visible.size();
+    rebuilt.cullScalar(planes, rebuilt_visible);
+    VS_CHECK(rebuilt_visible == reference);
+
+    // nothing was removed, so handles match slots and both lists are sorted.
+    // only boxes on a plane may differ.
+    std::vector<vs_frustum_culler::handle> differing;
+    std::set_symmetric_difference(visible.begin(), visible.end(),
+                                  reference.begin(), reference.end(),
+                                  std::back_inserter(differing));
+    for (auto box : differing) {
+      VS_CHECK(std::abs(culler.visibilityMargin(box, planes)) < 1e-4f);
+    }
+  }
+  VS_CHECK(visible_total > 0);
+
+  std::printf("%zu objects, %zu moving, %zu visible on average\n", count,
+              moving, visible_total / FRAMES);
+  std::printf("%-24s %10s\n", "per frame", "ms");
+  std::printf("%-24s %10.4f\n", "recompute all boxes", rebuild_ms / FRAMES);
+  std::printf("%-24s %10.4f\n", "update moved boxes", incremental_ms / FRAMES);
+  std::printf("%-24s %10.4f\n", "cull simd", simd_ms / FRAMES);
+  std::printf("%-24s %10.4f\n", "cull scalar", scalar_ms / FRAMES);
+  return vs::test::exitCode();
+}
@@ -0,0 +1,235 @@
+#include "vs_test.h"
+
+#include "engine/vs_frustum_culler.h"
+#include "game/vs_camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Checks vs_frustum_culler against its scalar reference and against a culler
+// built from scratch after a long run of adds, moves and removes, so the simd
+// kernels and the incremental bookkeeping both have something to disagree
+// with.
+namespace {
+using vs::vs_frustum_culler;
+
+// boxes closer than this to a plane may go either way between the kernels.
+constexpr float BOUNDARY_EPSILON = 1e-4f;
+
+struct box {
+  glm::vec3 min;
+  glm::vec3 max;
+  glm::mat4 world_matrix;
+};
+
+glm::vec3 randomVec3(std::mt19937 &rng, float low, float high) {
+  std::uniform_real_distribution<float> dist{low, high};
+  return {dist(rng), dist(rng), dist(rng)};
+}
+
+box randomBox(std::mt19937 &rng) {
+  const glm::vec3 min = randomVec3(rng, -2.f, 0.f);
+  const glm::vec3 size = randomVec3(rng, 0.1f, 3.f);
+  const float angle = std::uniform_real_distribution<float>{0.f, 6.28f}(rng);
+  const glm::vec3 axis = glm::normalize(randomVec3(rng, -1.f, 1.f) +
+                                        glm::vec3{0.f, 0.f, 0.001f});
+  glm::mat4 world = glm::translate(glm::mat4{1.f}, randomVec3(rng, -60.f, 60.f));
+  world = glm::rotate(world, angle, axis);
+  world = glm::scale(world, randomVec3(rng, 0.5f, 2.f));
+  return {min, min + size, world};
+}
+
+std::array<glm::vec4, 6> randomFrustum(std::mt19937 &rng) {
+  vs::vs_camera camera{};
+  camera.setPerspectiveProjection(
+      glm::radians(std::uniform_real_distribution<float>{30.f, 90.f}(rng)),
+      std::uniform_real_distribution<float>{0.5f, 2.f}(rng), 0.1f, 80.f);
+  camera.setViewDirection(randomVec3(rng, -20.f, 20.f),
+                          glm::normalize(randomVec3(rng, -1.f, 1.f) +
+                                         glm::vec3{0.001f, 0.f, 0.f}));
+  return camera.getFrustumPlanes();
+}
+
+// the axis aligned cube [-10, 10], planes pointing inwards.
+std::array<glm::vec4, 6> cubeFrustum() {
+  return {glm::vec4{1.f, 0.f, 0.f, 10.f},  glm::vec4{-1.f, 0.f, 0.f, 10.f},
+          glm::vec4{0.f, 1.f, 0.f, 10.f},  glm::vec4{0.f, -1.f, 0.f, 10.f},
+          glm::vec4{0.f, 0.f, 1.f, 10.f},  glm::vec4{0.f, 0.f, -1.f, 10.f}};
+}
+
+bool contains(const std::vector<vs_frustum_culler::handle> &handles,
+              vs_frustum_culler::handle box) {
+  return std::find(handles.begin(), handles.end(), box) != handles.end();
+}
+
+// every box in one list and not the other has to sit on a plane.
+bool agree(const vs_frustum_culler &culler,
+           const std::array<glm::vec4, 6> &planes,
+           std::vector<vs_frustum_culler::handle> a,
+           std::vector<vs_frustum_culler::handle> b) {
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  std::vector<vs_frustum_culler::handle> differing;
+  std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(),
+                                std::back_inserter(differing));
+  for (auto box : differing) {
+    if (std::abs(culler.visibilityMargin(box, planes)) > BOUNDARY_EPSILON) {
+      std::cerr << "box " << box << " with margin "
+                << culler.visibilityMargin(box, planes) << " differs"
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+void testKnownBoxes() {
+  vs_frustum_culler culler;
+  const auto planes = cubeFrustum();
+  const glm::vec3 min{-0.5f};
+  const glm::vec3 max{0.5f};
+
+  const auto inside = culler.add(min, max, glm::mat4{1.f});
+  const auto outside =
+      culler.add(min, max, glm::translate(glm::mat4{1.f}, {50.f, 0.f, 0.f}));
+  const auto straddling =
+      culler.add(min, max, glm::translate(glm::mat4{1.f}, {10.f, 0.f, 0.f}));
+  // reaches 10.1 axis aligned, rotated by 45 degrees its corner reaches 9.89.
+  const glm::mat4 beyond = glm::translate(glm::mat4{1.f}, {10.6f, 0.f, 0.f});
+  const auto axis_aligned = culler.add(min, max, beyond);
+  const auto rotated = culler.add(
+      min, max, glm::rotate(beyond, glm::radians(45.f), {0.f, 0.f, 1.f}));
+  // scaled down it fits inside again.
+  const auto scaled = culler.add(
+      min, max,
+      glm::scale(glm::translate(glm::mat4{1.f}, {9.9f, 0.f, 0.f}), glm::vec3{0.1f}));
+
+  std::vector<vs_frustum_culler::handle> visible;
+  culler.cull(planes, visible);
+  VS_CHECK(contains(visible, inside));
+  VS_CHECK(!contains(visible, outside));
+  VS_CHECK(contains(visible, straddling));
+  VS_CHECK(!contains(visible, axis_aligned));
+  VS_CHECK(contains(visible, rotated));
+  VS_CHECK(contains(visible, scaled));
+  VS_CHECK(visible.size() == 4);
+
+  // moving a box only touches that box.
+  culler.setWorldMatrix(outside, glm::mat4{1.f});
+  culler.setWorldMatrix(inside,
+                        glm::translate(glm::mat4{1.f}, {0.f, -40.f, 0.f}));
+  culler.cull(planes, visible);
+  VS_CHECK(contains(visible, outside));
+  VS_CHECK(!contains(visible, inside));
+  VS_CHECK(contains(visible, rotated));
+
+  // removing keeps the other handles valid and hands the freed one out again.
+  culler.remove(straddling);
+  VS_CHECK(culler.size() == 5);
+  culler.cull(planes, visible);
+  VS_CHECK(!contains(visible, straddling));
+  VS_CHECK(contains(visible, outside));
+  VS_CHECK(contains(visible, rotated));
+  VS_CHECK(contains(visible, scaled));
+  VS_CHECK(culler.add(min, max, glm::mat4{1.f}) == straddling);
+}
+
+void testSimdMatchesScalar() {
+  std::mt19937 rng{7};
+  vs_frustum_culler culler;
+  // not a multiple of 8, so the scalar tail runs too.
+  for (int i = 0; i < 1003; ++i) {
+    const box b = randomBox(rng);
+    culler.add(b.min, b.max, b.world_matrix);
+  }
+
+  std::vector<vs_frustum_culler::handle> simd;
+  std::vector<vs_frustum_culler::handle> scalar;
+  size_t total_visible = 0;
+  for (int frustum = 0; frustum < 64; ++frustum) {
+    const auto planes = randomFrustum(rng);
+    culler.cull(planes, simd);
+    culler.cullScalar(planes, scalar);
+    VS_CHECK(agree(culler, planes, simd, scalar));
+    total_visible += scalar.size();
+  }
+  // random frustums that never see anything would not test much.
+  VS_CHECK(total_visible > 0);
+  VS_CHECK(total_visible < 64 * culler.size());
+}
+
+void testIncrementalMatchesRebuild() {
+  std::mt19937 rng{42};
+  vs_frustum_culler culler;
+  // what the culler should hold, by handle.
+  std::vector<box> boxes;
+  std::vector<bool> alive;
+  std::vector<vs_frustum_culler::handle> live;
+
+  for (int step = 0; step < 20000; ++step) {
+    const uint32_t op = rng() % 10;
+    if (op < 3 || live.empty()) {
+      const box b = randomBox(rng);
+      const auto handle = culler.add(b.min, b.max, b.world_matrix);
+      if (handle >= boxes.size()) {
+        boxes.resize(handle + 1);
+        alive.resize(handle + 1, false);
+      }
+      VS_CHECK(!alive[handle]);
+      boxes[handle] = b;
+      alive[handle] = true;
+      live.push_back(handle);
+    } else if (op < 8) {
+      const auto handle = live[rng() % live.size()];
+      boxes[handle].world_matrix = randomBox(rng).world_matrix;
+      culler.setWorldMatrix(handle, boxes[handle].world_matrix);
+    } else {
+      const size_t index = rng() % live.size();
+      culler.remove(live[index]);
+      alive[live[index]] = false;
+      live[index] = live.back();
+      live.pop_back();
+    }
+
+    if (step % 500 != 0)
+      continue;
+
+    // a culler built from the final state in one go.
+    vs_frustum_culler rebuilt;
+    std::vector<vs_frustum_culler::handle> rebuilt_to_handle;
+    for (auto handle : live) {
+      const auto &b = boxes[handle];
+      const auto rebuilt_handle = rebuilt.add(b.min, b.max, b.world_matrix);
+      if (rebuilt_handle >= rebuilt_to_handle.size())
+        rebuilt_to_handle.resize(rebuilt_handle + 1);
+      rebuilt_to_handle[rebuilt_handle] = handle;
+    }
+    VS_CHECK(culler.size() == live.size());
+
+    const auto planes = randomFrustum(rng);
+    std::vector<vs_frustum_culler::handle> incremental;
+    std::vector<vs_frustum_culler::handle> fresh;
+    culler.cull(planes, incremental);
+    rebuilt.cullScalar(planes, fresh);
+    for (auto &handle : fresh) {
+      handle = rebuilt_to_handle[handle];
+    }
+    for (auto handle : incremental) {
+      VS_CHECK(handle < alive.size() && alive[handle]);
+    }
+    VS_CHECK(agree(culler, planes, incremental, fresh));
+  }
+}
+} // namespace
+
+int main() {
+  testKnownBoxes();
+  testSimdMatchesScalar();
+  testIncrementalMatchesRebuild();
+  return vs::test::exitCode();
+}
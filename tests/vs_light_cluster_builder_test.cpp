@@ -0,0 +1,211 @@
+#include "vs_test.h"
+
+#include "engine/vs_light_cluster_builder.h"
+#include "engine/vs_thread_pool.h"
+#include "game/vs_camera.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Random lights in front of a perspective camera. Every point sampled inside
+// a light's sphere has to land in a cluster that lists the light, lights are
+// only listed in slices their depth range reaches, and the lists come out the
+// same with and without worker threads.
+namespace {
+using vs::vs_light_cluster_builder;
+
+constexpr float NEAR = .1f;
+constexpr float FAR = 1000.f;
+constexpr uint32_t LIGHT_COUNT = 3000;
+constexpr uint32_t SAMPLES_PER_LIGHT = 100;
+
+struct light {
+  glm::vec3 position;
+  float range;
+};
+
+glm::mat4 projection() {
+  vs::vs_camera camera{};
+  camera.setPerspectiveProjection(glm::radians(60.f), 16.f / 9.f, NEAR, FAR);
+  return camera.getProjection();
+}
+
+std::vector<light> randomLights(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> side{-1.f, 1.f};
+  std::uniform_real_distribution<float> depth{-5.f, 60.f};
+  std::uniform_real_distribution<float> range{.2f, 8.f};
+  std::vector<light> lights(LIGHT_COUNT);
+  for (auto &l : lights) {
+    l.position = {side(rng) * 40.f, side(rng) * 25.f, depth(rng)};
+    l.range = range(rng);
+  }
+  return lights;
+}
+
+void build(vs_light_cluster_builder &builder, const std::vector<light> &lights) {
+  builder.setProjection(projection());
+  builder.clear();
+  for (const auto &l : lights) {
+    builder.addLight(l.position, l.range);
+  }
+  builder.build();
+}
+
+bool listsLight(const vs_light_cluster_builder &builder, uint32_t cluster,
+                uint32_t light) {
+  const auto &c = builder.getClusters()[cluster];
+  const auto begin = builder.getLightIndices().begin() + c.offset;
+  return std::binary_search(begin, begin + c.count, light);
+}
+
+// cluster of a view space point the shaders would read, false off screen.
+bool clusterOf(const vs_light_cluster_builder &builder, const glm::mat4 &proj,
+               const glm::vec3 &point, uint32_t &cluster) {
+  if (point.z <= NEAR || point.z >= FAR)
+    return false;
+  const glm::vec4 clip = proj * glm::vec4{point, 1.f};
+  const glm::vec2 ndc{clip.x / clip.w, clip.y / clip.w};
+  if (ndc.x < -1.f || ndc.x >= 1.f || ndc.y < -1.f || ndc.y >= 1.f)
+    return false;
+  const auto x = static_cast<uint32_t>((ndc.x + 1.f) * .5f *
+                                       vs_light_cluster_builder::GRID_X);
+  const auto y = static_cast<uint32_t>((ndc.y + 1.f) * .5f *
+                                       vs_light_cluster_builder::GRID_Y);
+  const glm::vec2 scale_bias = builder.getDepthScaleBias();
+  const float slice =
+      std::floor(std::log(point.z) * scale_bias.x + scale_bias.y);
+  const auto z = static_cast<uint32_t>(std::clamp(
+      slice, 0.f, static_cast<float>(vs_light_cluster_builder::GRID_Z - 1)));
+  cluster = vs_light_cluster_builder::clusterIndex(x, y, z);
+  return true;
+}
+
+void testCoverage(const vs_light_cluster_builder &builder,
+                  const std::vector<light> &lights, std::mt19937 &rng) {
+  const glm::mat4 proj = projection();
+  std::uniform_real_distribution<float> unit{-1.f, 1.f};
+  uint32_t checked = 0;
+  uint32_t missed = 0;
+  for (uint32_t i = 0; i < lights.size(); ++i) {
+    for (uint32_t s = 0; s < SAMPLES_PER_LIGHT; ++s) {
+      const glm::vec3 offset{unit(rng), unit(rng), unit(rng)};
+      if (glm::dot(offset, offset) > 1.f)
+        continue;
+      uint32_t cluster = 0;
+      if (!clusterOf(builder, proj,
+                     lights[i].position + offset * lights[i].range, cluster))
+        continue;
+      ++checked;
+      if (!listsLight(builder, cluster, i))
+        ++missed;
+    }
+  }
+  VS_CHECK(checked > LIGHT_COUNT * SAMPLES_PER_LIGHT / 10);
+  if (missed > 0) {
+    std::cerr << missed << " of " << checked
+              << " points inside a light are in a cluster without it"
+              << std::endl;
+    ++vs::test::failures();
+  }
+}
+
+// every list is sorted and only holds lights that reach the slice's depths.
+void testLists(const vs_light_cluster_builder &builder,
+               const std::vector<light> &lights) {
+  const auto &indices = builder.getLightIndices();
+  const float depth_ratio = FAR / NEAR;
+  for (uint32_t z = 0; z < vs_light_cluster_builder::GRID_Z; ++z) {
+    const float slice_near =
+        NEAR * std::pow(depth_ratio, static_cast<float>(z) /
+                                         vs_light_cluster_builder::GRID_Z);
+    const float slice_far =
+        NEAR * std::pow(depth_ratio, static_cast<float>(z + 1) /
+                                         vs_light_cluster_builder::GRID_Z);
+    for (uint32_t c = 0; c < vs_light_cluster_builder::GRID_X *
+                                 vs_light_cluster_builder::GRID_Y;
+         ++c) {
+      const auto &cluster =
+          builder.getClusters()[z * vs_light_cluster_builder::GRID_X *
+                                    vs_light_cluster_builder::GRID_Y +
+                                c];
+      for (uint32_t k = 0; k < cluster.count; ++k) {
+        const uint32_t i = indices[cluster.offset + k];
+        VS_CHECK(k == 0 || indices[cluster.offset + k - 1] < i);
+        VS_CHECK(i < lights.size());
+        // the first and last slice also take what is clamped into them.
+        const float margin = 1e-3f * slice_far;
+        VS_CHECK(z == 0 ||
+                 lights[i].position.z + lights[i].range >= slice_near - margin);
+        VS_CHECK(z == vs_light_cluster_builder::GRID_Z - 1 ||
+                 lights[i].position.z - lights[i].range <= slice_far + margin);
+      }
+    }
+  }
+}
+
+bool sameLists(const vs_light_cluster_builder &a,
+               const vs_light_cluster_builder &b) {
+  if (a.getLightIndices() != b.getLightIndices())
+    return false;
+  for (uint32_t c = 0; c < vs_light_cluster_builder::CLUSTER_COUNT; ++c) {
+    if (a.getClusters()[c].offset != b.getClusters()[c].offset ||
+        a.getClusters()[c].count != b.getClusters()[c].count)
+      return false;
+  }
+  return true;
+}
+
+// lights behind the camera or beside the frustum are in no cluster.
+void testOutside() {
+  vs_light_cluster_builder builder{1024};
+  build(builder, {{{0.f, 0.f, -5.f}, 1.f},
+                  {{500.f, 0.f, 10.f}, 1.f},
+                  {{0.f, 0.f, 2000.f}, 1.f}});
+  VS_CHECK(builder.getLightIndices().empty());
+  VS_CHECK(builder.getDroppedCount() == 0);
+
+  build(builder, {{{0.f, 0.f, 10.f}, 1.f}});
+  VS_CHECK(!builder.getLightIndices().empty());
+  // clear() drops the lights of the last build.
+  builder.clear();
+  builder.build();
+  VS_CHECK(builder.getLightIndices().empty());
+}
+
+// references past max_light_indices are dropped and counted.
+void testDropped(const std::vector<light> &lights,
+                 const vs_light_cluster_builder &unlimited) {
+  constexpr uint32_t LIMIT = 1000;
+  vs_light_cluster_builder builder{LIMIT};
+  build(builder, lights);
+  VS_CHECK(builder.getLightIndices().size() == LIMIT);
+  VS_CHECK(builder.getDroppedCount() ==
+           unlimited.getLightIndices().size() - LIMIT);
+}
+} // namespace
+
+int main() {
+  std::mt19937 rng{1};
+  const auto lights = randomLights(rng);
+
+  vs::vs_thread_pool thread_pool{3};
+  vs_light_cluster_builder serial{1u << 20};
+  vs_light_cluster_builder threaded{1u << 20, &thread_pool};
+  build(serial, lights);
+  build(threaded, lights);
+  VS_CHECK(serial.getDroppedCount() == 0);
+  VS_CHECK(sameLists(serial, threaded));
+
+  testCoverage(serial, lights, rng);
+  testLists(serial, lights);
+  testOutside();
+  testDropped(lights, serial);
+
+  // the same frame again reuses the boxes and gives the same lists.
+  build(threaded, lights);
+  VS_CHECK(sameLists(serial, threaded));
+  return vs::test::exitCode();
+}
@@ -0,0 +1,170 @@
+#include "vs_test.h"
+
+#include "vs_buffer.h"
+#include "vs_device.h"
+#include "vs_memory_pool.h"
+
+// std
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Keeps a few hundred vertex buffers alive in the memory pool, frees and
+// allocates some of them every frame and defragments like vs_app does. Each
+// buffer is filled with a pattern derived from its seed, every few frames all
+// of them are read back, so a relocation that copies the wrong range, patches
+// the wrong owner or drops a buffer mid copy shows up as a mismatch. At the
+// end blocks that were spilled into have to be emptied and freed again.
+namespace {
+constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+constexpr VkDeviceSize DEFRAG_BUDGET = 4 * 1024 * 1024;
+constexpr size_t MAX_LIVE_BUFFERS = 256;
+constexpr uint32_t VERIFY_INTERVAL = 16;
+
+struct live_buffer {
+  std::unique_ptr<vs::vs_buffer> buffer;
+  uint32_t seed;
+};
+
+uint32_t patternWord(uint32_t seed, uint32_t index) {
+  return seed * 2654435761u + index * 40503u + 1u;
+}
+
+live_buffer createBuffer(vs::vs_device &device, std::mt19937 &rng) {
+  // 4 KiB to 512 KiB, a mix that leaves holes of every size behind.
+  const uint32_t words = 1024u << (rng() % 8);
+  live_buffer live{};
+  live.seed = static_cast<uint32_t>(rng());
+  live.buffer = std::make_unique<vs::vs_buffer>(
+      device, sizeof(uint32_t), words, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  vs::vs_buffer staging{device, sizeof(uint32_t), words,
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  staging.map();
+  auto *data = static_cast<uint32_t *>(staging.getMappedMemory());
+  for (uint32_t i = 0; i < words; ++i) {
+    data[i] = patternWord(live.seed, i);
+  }
+  device.copyBuffer(staging.getBuffer(), live.buffer->getBuffer(),
+                    live.buffer->getBufferSize());
+  return live;
+}
+
+bool verifyBuffer(vs::vs_device &device, const live_buffer &live) {
+  const auto words = live.buffer->getInstanceCount();
+  vs::vs_buffer readback{device, sizeof(uint32_t), words,
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  // the handle changes when the pool relocates the buffer, always ask for it.
+  device.copyBuffer(live.buffer->getBuffer(), readback.getBuffer(),
+                    live.buffer->getBufferSize());
+  readback.map();
+  const auto *data = static_cast<const uint32_t *>(readback.getMappedMemory());
+  for (uint32_t i = 0; i < words; ++i) {
+    if (data[i] != patternWord(live.seed, i)) {
+      std::cerr << "buffer with seed " << live.seed << " differs at word " << i
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool verifyAll(vs::vs_device &device, const std::vector<live_buffer> &buffers) {
+  bool intact = true;
+  for (const auto &live : buffers) {
+    intact = verifyBuffer(device, live) && intact;
+  }
+  return intact;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  // ctest runs a short soak, pass a frame count for a longer one.
+  const uint32_t frames = argc > 1 ? std::stoul(argv[1]) : 10000;
+
+  std::unique_ptr<vs::vs_device> device;
+  try {
+    device = std::make_unique<vs::vs_device>();
+  } catch (const std::exception &e) {
+    // debug builds also need the validation layers installed.
+    std::cerr << "no usable vulkan device, skipping: " << e.what() << std::endl;
+    return vs::test::SKIPPED;
+  }
+  auto &pool = device->memoryPool();
+
+  std::mt19937 rng{1234};
+  std::vector<live_buffer> buffers;
+  for (size_t i = 0; i < MAX_LIVE_BUFFERS / 2; ++i) {
+    buffers.push_back(createBuffer(*device, rng));
+  }
+
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    pool.defragment(DEFRAG_BUDGET, FRAMES_IN_FLIGHT);
+
+    // churn right after defragment(), so some frees land on buffers whose
+    // copy is still in flight.
+    const uint32_t frees = rng() % 4;
+    for (uint32_t i = 0; i < frees && !buffers.empty(); ++i) {
+      const size_t victim = rng() % buffers.size();
+      std::swap(buffers[victim], buffers.back());
+      buffers.pop_back();
+    }
+    const uint32_t allocations = rng() % 4;
+    for (uint32_t i = 0;
+         i < allocations && buffers.size() < MAX_LIVE_BUFFERS; ++i) {
+      buffers.push_back(createBuffer(*device, rng));
+    }
+
+    // stands in for the frame fence vs_app waits on before defragmenting.
+    vkQueueWaitIdle(device->graphicsQueue());
+
+    if (frame % VERIFY_INTERVAL == 0) {
+      VS_CHECK(verifyAll(*device, buffers));
+    }
+  }
+
+  // without churn the pool should settle and never make things worse.
+  const float fragmentation_before = pool.fragmentation();
+  for (uint32_t frame = 0; frame < 64; ++frame) {
+    pool.defragment(DEFRAG_BUDGET, FRAMES_IN_FLIGHT);
+    vkQueueWaitIdle(device->graphicsQueue());
+  }
+  VS_CHECK(pool.fragmentation() <= fragmentation_before);
+  VS_CHECK(verifyAll(*device, buffers));
+
+  // spill into two more blocks and free most of it again. what is left in
+  // them fits the first block, so defragmenting has to empty and free them.
+  const size_t blocks_before = pool.getBlockCount();
+  std::vector<live_buffer> spill;
+  while (pool.getBlockCount() < blocks_before + 2) {
+    spill.push_back(createBuffer(*device, rng));
+  }
+  for (size_t i = 0; i < spill.size(); i += 8) {
+    buffers.push_back(std::move(spill[i]));
+  }
+  spill.clear();
+  for (uint32_t frame = 0; frame < 256; ++frame) {
+    pool.defragment(DEFRAG_BUDGET, FRAMES_IN_FLIGHT);
+    vkQueueWaitIdle(device->graphicsQueue());
+  }
+  VS_CHECK(pool.getBlockCount() <= blocks_before);
+  VS_CHECK(verifyAll(*device, buffers));
+
+  // a soak that never relocated anything tested nothing.
+  VS_CHECK(pool.getRelocationGeneration() > 0);
+  std::cout << "soaked " << frames << " frames, " << buffers.size()
+            << " live buffers, " << pool.getRelocationGeneration()
+            << " relocation rounds, fragmentation " << pool.fragmentation()
+            << std::endl;
+
+  buffers.clear();
+  vkDeviceWaitIdle(device->device());
+  return vs::test::exitCode();
+}
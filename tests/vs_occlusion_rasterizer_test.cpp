@@ -0,0 +1,257 @@
+#include "vs_test.h"
+
+#include "engine/vs_occlusion_rasterizer.h"
+#include "engine/vs_thread_pool.h"
+#include "game/vs_camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Rasterizes a few fixed occluder scenes and compares the depth buffers with
+// the golden ones in tests/data. Run with --update after an intended change
+// to rewrite them:
+//
+//   vs_occlusion_rasterizer_test <tests/data> --update
+//
+// The scenes without projection put every vertex on a pixel corner and
+// match exactly. Rounding in the projected scene may move the edges of its
+// triangles, so a few pixels there may take the depth of a neighbour.
+namespace {
+using vs::vs_occlusion_rasterizer;
+
+constexpr uint32_t WIDTH = 64;
+constexpr uint32_t HEIGHT = 32;
+constexpr float DEPTH_TOLERANCE = 1e-5f;
+
+struct mesh {
+  std::vector<glm::vec3> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// two triangles between the corners, counter clockwise seen from -z.
+mesh quad(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d) {
+  return {{a, b, c, d}, {0, 1, 2, 0, 2, 3}};
+}
+
+mesh cube() {
+  mesh m;
+  for (int i = 0; i < 8; ++i) {
+    m.vertices.push_back({(i & 1) ? .5f : -.5f, (i & 2) ? .5f : -.5f,
+                          (i & 4) ? .5f : -.5f});
+  }
+  m.indices = {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+               2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+  return m;
+}
+
+struct scene {
+  const char *name;
+  std::function<void(vs_occlusion_rasterizer &)> draw;
+};
+
+// view projection is the identity, ndc is world space.
+void halfQuad(vs_occlusion_rasterizer &rasterizer) {
+  rasterizer.beginFrame(glm::mat4{1.f});
+  const mesh m = quad({-1.f, -1.f, .5f}, {0.f, -1.f, .5f}, {0.f, 1.f, .5f},
+                      {-1.f, 1.f, .5f});
+  rasterizer.addOccluder(glm::mat4{1.f}, m.vertices, m.indices);
+  rasterizer.rasterize();
+}
+
+// depth runs from 0 on the left edge to 1 on the right one.
+void slopedTriangle(vs_occlusion_rasterizer &rasterizer) {
+  rasterizer.beginFrame(glm::mat4{1.f});
+  const std::vector<glm::vec3> vertices{
+      {-1.f, -1.f, 0.f}, {1.f, -1.f, 1.f}, {-1.f, 1.f, 0.f}};
+  rasterizer.addOccluder(glm::mat4{1.f}, vertices, {0, 2, 1});
+  rasterizer.rasterize();
+}
+
+// a far wall, a near quad in front of it and a slanted triangle cutting
+// through both, every pixel keeps the nearest.
+void overlapping(vs_occlusion_rasterizer &rasterizer) {
+  rasterizer.beginFrame(glm::mat4{1.f});
+  const mesh wall = quad({-1.f, -1.f, .9f}, {1.f, -1.f, .9f},
+                         {1.f, 1.f, .9f}, {-1.f, 1.f, .9f});
+  const mesh near_quad = quad({-.5f, -.5f, .25f}, {.5f, -.5f, .25f},
+                              {.5f, .5f, .25f}, {-.5f, .5f, .25f});
+  const std::vector<glm::vec3> slanted{
+      {-.75f, -.875f, .1f}, {.75f, -.875f, .1f}, {0.f, .875f, .99f}};
+  rasterizer.addOccluder(glm::mat4{1.f}, wall.vertices, wall.indices);
+  rasterizer.addOccluder(glm::mat4{1.f}, near_quad.vertices, near_quad.indices);
+  rasterizer.addOccluder(glm::mat4{1.f}, slanted, {0, 1, 2});
+  rasterizer.rasterize();
+}
+
+// a rotated cube on a tiled floor that reaches behind the camera, the floor
+// tiles crossing the near plane are skipped.
+void perspective(vs_occlusion_rasterizer &rasterizer) {
+  vs::vs_camera camera{};
+  camera.setPerspectiveProjection(glm::radians(60.f), 2.f, 1.f, 20.f);
+  camera.setViewTarget({0.f, -1.5f, -1.f}, {0.f, 0.f, 4.f});
+  rasterizer.beginFrame(camera.getProjection() * camera.getView());
+
+  glm::mat4 cube_matrix = glm::translate(glm::mat4{1.f}, {.3f, -.5f, 4.f});
+  cube_matrix = glm::rotate(cube_matrix, glm::radians(30.f), {0.f, 1.f, 0.f});
+  const mesh box = cube();
+  rasterizer.addOccluder(cube_matrix, box.vertices, box.indices);
+
+  for (float z = -3.f; z < 12.f; z += 2.f) {
+    for (float x = -6.f; x < 6.f; x += 2.f) {
+      const mesh tile = quad({x, 0.f, z}, {x + 2.f, 0.f, z},
+                             {x + 2.f, 0.f, z + 2.f}, {x, 0.f, z + 2.f});
+      rasterizer.addOccluder(glm::mat4{1.f}, tile.vertices, tile.indices);
+    }
+  }
+  rasterizer.rasterize();
+}
+
+const std::vector<scene> &scenes() {
+  static const std::vector<scene> all{{"half_quad", halfQuad},
+                                      {"sloped_triangle", slopedTriangle},
+                                      {"overlapping", overlapping},
+                                      {"perspective", perspective}};
+  return all;
+}
+
+std::string goldenPath(const std::string &data_dir, const scene &s) {
+  return data_dir + "/occlusion_" + s.name + ".txt";
+}
+
+bool writeGolden(const std::string &path,
+                 const vs_occlusion_rasterizer &rasterizer) {
+  std::ofstream file{path};
+  if (!file)
+    return false;
+  file << "# vs_occlusion_rasterizer golden depth buffer, rows from the top, "
+          "1 is cleared\n";
+  file << rasterizer.getWidth() << " " << rasterizer.getHeight() << "\n";
+  const auto &depth = rasterizer.getDepthBuffer();
+  char value[32];
+  for (uint32_t y = 0; y < rasterizer.getHeight(); ++y) {
+    for (uint32_t x = 0; x < rasterizer.getWidth(); ++x) {
+      std::snprintf(value, sizeof(value), "%.7g", depth[y * rasterizer.getWidth() + x]);
+      file << (x == 0 ? "" : " ") << value;
+    }
+    file << "\n";
+  }
+  return static_cast<bool>(file);
+}
+
+bool readGolden(const std::string &path, std::vector<float> &depth) {
+  std::ifstream file{path};
+  std::string comment;
+  std::getline(file, comment);
+  uint32_t width = 0;
+  uint32_t height = 0;
+  file >> width >> height;
+  if (!file || width != WIDTH || height != HEIGHT)
+    return false;
+  depth.resize(width * height);
+  for (auto &d : depth) {
+    file >> d;
+  }
+  return static_cast<bool>(file);
+}
+
+// a pixel on an edge may end up with the depth of any of its neighbours.
+bool withinNeighbours(const std::vector<float> &golden, int32_t x, int32_t y,
+                      float depth) {
+  float lowest = golden[y * WIDTH + x];
+  float highest = lowest;
+  for (int32_t ny = std::max(y - 1, 0);
+       ny <= std::min(y + 1, static_cast<int32_t>(HEIGHT) - 1); ++ny) {
+    for (int32_t nx = std::max(x - 1, 0);
+         nx <= std::min(x + 1, static_cast<int32_t>(WIDTH) - 1); ++nx) {
+      lowest = std::min(lowest, golden[ny * WIDTH + nx]);
+      highest = std::max(highest, golden[ny * WIDTH + nx]);
+    }
+  }
+  return depth >= lowest - DEPTH_TOLERANCE && depth <= highest + DEPTH_TOLERANCE;
+}
+
+bool matchesGolden(const scene &s, const vs_occlusion_rasterizer &rasterizer,
+                   const std::vector<float> &golden, bool exact) {
+  const auto &depth = rasterizer.getDepthBuffer();
+  uint32_t edge_differences = 0;
+  for (int32_t y = 0; y < static_cast<int32_t>(HEIGHT); ++y) {
+    for (int32_t x = 0; x < static_cast<int32_t>(WIDTH); ++x) {
+      const float actual = depth[y * WIDTH + x];
+      const float expected = golden[y * WIDTH + x];
+      if (std::abs(actual - expected) <= DEPTH_TOLERANCE)
+        continue;
+      if (!exact && withinNeighbours(golden, x, y, actual)) {
+        ++edge_differences;
+        continue;
+      }
+      std::cerr << s.name << ": depth at " << x << ", " << y << " is "
+                << actual << ", expected " << expected << std::endl;
+      return false;
+    }
+  }
+  // a handful of edge pixels, not a different picture.
+  return edge_differences <= WIDTH * HEIGHT / 100;
+}
+
+// the same boxes the occlusion culling system would test, against the
+// analytic answer for the half quad.
+void testVisibility() {
+  vs_occlusion_rasterizer rasterizer{WIDTH, HEIGHT};
+  halfQuad(rasterizer);
+  const glm::vec3 extents{.2f, .2f, .1f};
+  VS_CHECK(!rasterizer.isVisible({-.5f, 0.f, .8f}, extents));
+  VS_CHECK(rasterizer.isVisible({-.5f, 0.f, .2f}, extents));
+  VS_CHECK(rasterizer.isVisible({.5f, 0.f, .8f}, extents));
+  // peeks past the occluder edge.
+  VS_CHECK(rasterizer.isVisible({-.1f, 0.f, .8f}, {.08f, .2f, .1f}));
+  // crosses the near plane.
+  VS_CHECK(rasterizer.isVisible({-.5f, 0.f, .05f}, extents));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <golden data dir> [--update]"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string data_dir = argv[1];
+  const bool update = argc > 2 && std::string{argv[2]} == "--update";
+
+  vs::vs_thread_pool thread_pool{3};
+  for (const auto &s : scenes()) {
+    vs_occlusion_rasterizer serial{WIDTH, HEIGHT};
+    vs_occlusion_rasterizer threaded{WIDTH, HEIGHT, &thread_pool};
+    s.draw(serial);
+    s.draw(threaded);
+    // every tile is rasterized the same way on any thread.
+    VS_CHECK(serial.getDepthBuffer() == threaded.getDepthBuffer());
+
+    const std::string path = goldenPath(data_dir, s);
+    if (update) {
+      VS_CHECK(writeGolden(path, serial));
+      std::cout << "wrote " << path << std::endl;
+      continue;
+    }
+
+    std::vector<float> golden;
+    if (!readGolden(path, golden)) {
+      std::cerr << "can't read " << path << std::endl;
+      ++vs::test::failures();
+      continue;
+    }
+    const bool exact = std::string{s.name} != "perspective";
+    VS_CHECK(matchesGolden(s, serial, golden, exact));
+  }
+
+  testVisibility();
+  return vs::test::exitCode();
+}
@@ -0,0 +1,109 @@
+#include "vs_test.h"
+
+#include "engine/vs_scene_graph.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Cost of vs_scene_graph::update() against the number of dirty nodes in a
+// large hierarchy, next to the scalar reference that multiplies up the
+// parent chain of every node. The propagated matrices are compared with the
+// reference after every measurement.
+namespace {
+using vs::vs_scene_graph;
+
+constexpr int REPEATS = 10;
+// descendants below every root, every third one fans out from the root, the
+// others extend a chain.
+constexpr uint32_t TREE_SIZE = 100;
+
+glm::mat4 localMatrix(uint32_t seed) {
+  const float angle = static_cast<float>(seed % 628) * 0.01f;
+  const glm::mat4 m = glm::translate(
+      glm::mat4{1.f}, {static_cast<float>(seed % 7) * 0.1f, 0.2f, 0.1f});
+  return glm::rotate(m, angle, {0.f, 1.f, 0.f});
+}
+
+void referenceWorldMatrices(const vs_scene_graph &graph,
+                            const std::vector<glm::mat4> &locals,
+                            std::vector<glm::mat4> &worlds) {
+  for (vs_scene_graph::node_id node = 0; node < locals.size(); ++node) {
+    glm::mat4 world = locals[node];
+    for (auto p = graph.getParent(node); p != vs_scene_graph::INVALID_NODE;
+         p = graph.getParent(p)) {
+      world = locals[p] * world;
+    }
+    worlds[node] = world;
+  }
+}
+
+bool matchesReference(const vs_scene_graph &graph,
+                      const std::vector<glm::mat4> &reference) {
+  for (vs_scene_graph::node_id node = 0; node < reference.size(); ++node) {
+    const glm::mat4 &world = graph.getWorldMatrix(node);
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        // chains are long, leave room for the rounding they accumulate.
+        if (std::abs(world[c][r] - reference[node][c][r]) > 1e-2f)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  // ctest runs a small hierarchy, pass a node count for the real one.
+  const uint32_t count =
+      std::max<uint32_t>(argc > 1 ? std::stoul(argv[1]) : 100000, TREE_SIZE);
+
+  vs_scene_graph graph;
+  std::vector<glm::mat4> locals(count);
+  // built depth first, so createNode only ever appends.
+  for (uint32_t node = 0; node < count; ++node) {
+    const uint32_t root = node - node % TREE_SIZE;
+    vs_scene_graph::node_id parent = vs_scene_graph::INVALID_NODE;
+    if (node != root)
+      parent = (node % 3 == 0) ? root : node - 1;
+    VS_CHECK(graph.createNode(parent) == node);
+    locals[node] = localMatrix(node);
+    graph.setLocalMatrix(node, locals[node]);
+  }
+  graph.update();
+
+  std::vector<glm::mat4> reference(count);
+  const double reference_ms = vs::test::timeMs(
+      [&] { referenceWorldMatrices(graph, locals, reference); });
+  VS_CHECK(matchesReference(graph, reference));
+
+  std::printf("%u nodes in trees of %u, reference recomputes all in %.3f ms\n",
+              count, TREE_SIZE, reference_ms);
+  std::printf("%10s %10s %12s\n", "dirty", "updated", "update ms");
+  uint32_t seed = 1;
+  for (uint32_t dirty = 0; dirty <= count; dirty = dirty == 0 ? 1 : dirty * 10) {
+    double best = 1e9;
+    for (int repeat = 0; repeat < REPEATS; ++repeat) {
+      for (uint32_t i = 0; i < dirty; ++i) {
+        // a large prime spreads the dirty nodes over the trees.
+        const uint32_t node =
+            static_cast<uint32_t>((uint64_t{i} * 7919 + repeat) % count);
+        locals[node] = localMatrix(seed++);
+        graph.setLocalMatrix(node, locals[node]);
+      }
+      best = std::min(best, vs::test::timeMs([&] { graph.update(); }));
+    }
+    std::printf("%10u %10zu %12.4f\n", dirty, graph.getUpdatedNodes().size(),
+                best);
+
+    referenceWorldMatrices(graph, locals, reference);
+    VS_CHECK(matchesReference(graph, reference));
+  }
+  return vs::test::exitCode();
+}
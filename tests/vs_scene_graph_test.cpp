@@ -0,0 +1,134 @@
+#include "vs_test.h"
+
+#include "engine/vs_scene_graph.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Builds a random hierarchy, then reparents, moves and destroys nodes at
+// random and compares every world matrix with the product of the local
+// matrices up the parent chain after each update.
+namespace {
+using vs::vs_scene_graph;
+
+glm::mat4 randomLocal(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> offset{-3.f, 3.f};
+  std::uniform_real_distribution<float> angle{0.f, 6.28f};
+  const glm::mat4 m = glm::translate(glm::mat4{1.f},
+                                     {offset(rng), offset(rng), offset(rng)});
+  return glm::rotate(m, angle(rng), {0.f, 1.f, 0.f});
+}
+
+bool isAncestor(const vs_scene_graph &graph, vs_scene_graph::node_id ancestor,
+                vs_scene_graph::node_id node) {
+  for (auto p = node; p != vs_scene_graph::INVALID_NODE; p = graph.getParent(p)) {
+    if (p == ancestor)
+      return true;
+  }
+  return false;
+}
+
+bool matchesReference(const vs_scene_graph &graph,
+                      const std::vector<glm::mat4> &locals,
+                      const std::vector<bool> &alive) {
+  for (vs_scene_graph::node_id node = 0; node < alive.size(); ++node) {
+    if (!alive[node])
+      continue;
+    glm::mat4 world = locals[node];
+    for (auto p = graph.getParent(node); p != vs_scene_graph::INVALID_NODE;
+         p = graph.getParent(p)) {
+      world = locals[p] * world;
+    }
+    const glm::mat4 &actual = graph.getWorldMatrix(node);
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        if (std::abs(actual[c][r] - world[c][r]) > 1e-3f) {
+          std::cerr << "node " << node << " differs from the reference"
+                    << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main() {
+  std::mt19937 rng{1};
+  vs_scene_graph graph;
+  std::vector<glm::mat4> locals;
+  std::vector<bool> alive;
+  std::vector<vs_scene_graph::node_id> live;
+
+  auto create = [&](vs_scene_graph::node_id parent) {
+    const auto node = graph.createNode(parent);
+    if (node >= locals.size()) {
+      locals.resize(node + 1);
+      alive.resize(node + 1, false);
+    }
+    VS_CHECK(!alive[node]);
+    locals[node] = randomLocal(rng);
+    alive[node] = true;
+    live.push_back(node);
+    graph.setLocalMatrix(node, locals[node]);
+  };
+
+  for (int i = 0; i < 2000; ++i) {
+    create(live.empty() || rng() % 5 == 0 ? vs_scene_graph::INVALID_NODE
+                                          : live[rng() % live.size()]);
+  }
+  graph.update();
+  VS_CHECK(matchesReference(graph, locals, alive));
+
+  for (int step = 0; step < 5000; ++step) {
+    const auto node = live[rng() % live.size()];
+    const uint32_t op = rng() % 20;
+    if (op < 6) {
+      const auto parent = rng() % 3 == 0 ? vs_scene_graph::INVALID_NODE
+                                         : live[rng() % live.size()];
+      if (parent != vs_scene_graph::INVALID_NODE && isAncestor(graph, node, parent)) {
+        // would make a cycle.
+        bool threw = false;
+        try {
+          graph.setParent(node, parent);
+        } catch (const std::exception &) {
+          threw = true;
+        }
+        VS_CHECK(threw);
+      } else {
+        graph.setParent(node, parent);
+        VS_CHECK(graph.getParent(node) == parent);
+      }
+    } else if (op < 17) {
+      locals[node] = randomLocal(rng);
+      graph.setLocalMatrix(node, locals[node]);
+    } else if (op < 18 && live.size() > 100) {
+      for (auto other : live) {
+        if (isAncestor(graph, node, other))
+          alive[other] = false;
+      }
+      graph.destroyNode(node);
+      std::erase_if(live, [&](vs_scene_graph::node_id n) { return !alive[n]; });
+      VS_CHECK(graph.getNodeCount() == live.size());
+    } else {
+      create(rng() % 2 == 0 ? vs_scene_graph::INVALID_NODE
+                            : live[rng() % live.size()]);
+    }
+
+    if (step % 50 == 0) {
+      graph.update();
+      VS_CHECK(matchesReference(graph, locals, alive));
+    }
+  }
+
+  // nothing changed, nothing is recomputed.
+  graph.update();
+  graph.update();
+  VS_CHECK(graph.getUpdatedNodes().empty());
+  return vs::test::exitCode();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Minimal checks shared by the tests in this directory. A failed check prints
+// where it failed and the test keeps going, exitCode() turns the count into
+// the process result ctest looks at.
+namespace vs::test {
+// returned by tests whose hardware is missing, ctest reports them as skipped.
+constexpr int SKIPPED = 77;
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+inline int exitCode() {
+  if (failures() > 0) {
+    std::cerr << failures() << " checks failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// milliseconds spent in fn, for the benchmarks.
+template <typename Fn> double timeMs(Fn &&fn) {
+  const auto start = std::chrono::high_resolution_clock::now();
+  fn();
+  const auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+} // namespace vs::test
+
+#define VS_CHECK(condition)                                                    \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << __FILE__ << ":" << __LINE__                                 \
+                << ": check failed: " #condition << std::endl;                 \
+      ++vs::test::failures();                                                  \
+    }                                                                          \
+  } while (false)
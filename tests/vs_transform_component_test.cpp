@@ -0,0 +1,112 @@
+#include "vs_test.h"
+
+#include "game/vs_transform_component.h"
+
+// std
+#include <cmath>
+#include <random>
+
+// Euler angles set on a transform_component come back out of
+// getEulerRotation(), and both describe the Ry * Rx * Rz matrix the
+// component documents. Near the poles only the rotation has to survive the
+// round trip, the angles themselves are not unique there.
+namespace {
+using vs::transform_component;
+
+constexpr float HALF_PI = 1.57079632679f;
+constexpr float PI = 3.14159265359f;
+constexpr float ANGLE_TOLERANCE = 1e-3f;
+constexpr float MATRIX_TOLERANCE = 1e-4f;
+
+// Ry * Rx * Rz written out, see transform_component::mat4().
+glm::mat3 eulerMatrix(const glm::vec3 &angles) {
+  const float c3 = std::cos(angles.z);
+  const float s3 = std::sin(angles.z);
+  const float c2 = std::cos(angles.x);
+  const float s2 = std::sin(angles.x);
+  const float c1 = std::cos(angles.y);
+  const float s1 = std::sin(angles.y);
+  return glm::mat3{
+      glm::vec3{c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1},
+      glm::vec3{c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3},
+      glm::vec3{c2 * s1, -s2, c1 * c2}};
+}
+
+bool nearlyEqual(const glm::mat3 &a, const glm::mat3 &b) {
+  for (int c = 0; c < 3; ++c) {
+    for (int r = 0; r < 3; ++r) {
+      if (std::abs(a[c][r] - b[c][r]) > MATRIX_TOLERANCE)
+        return false;
+    }
+  }
+  return true;
+}
+
+// the rotation part of the world matrix, with unit scale.
+glm::mat3 rotationOf(transform_component &transform) {
+  transform.updateMatrices();
+  return glm::mat3{transform.mat4()};
+}
+
+void testRoundTrip(std::mt19937 &rng) {
+  // pitch stays clear of the poles, where the angles are unique.
+  std::uniform_real_distribution<float> pitch{-HALF_PI + 0.05f,
+                                              HALF_PI - 0.05f};
+  std::uniform_real_distribution<float> angle{-PI + 1e-3f, PI - 1e-3f};
+  for (int i = 0; i < 10000; ++i) {
+    const glm::vec3 angles{pitch(rng), angle(rng), angle(rng)};
+    transform_component transform;
+    transform.setEulerRotation(angles);
+    VS_CHECK(nearlyEqual(rotationOf(transform), eulerMatrix(angles)));
+
+    const glm::vec3 back = transform.getEulerRotation();
+    if (std::abs(back.x - angles.x) > ANGLE_TOLERANCE ||
+        std::abs(back.y - angles.y) > ANGLE_TOLERANCE ||
+        std::abs(back.z - angles.z) > ANGLE_TOLERANCE) {
+      std::cerr << "angles " << angles.x << ", " << angles.y << ", "
+                << angles.z << " came back as " << back.x << ", " << back.y
+                << ", " << back.z << std::endl;
+      ++vs::test::failures();
+    }
+  }
+}
+
+void testPoles(std::mt19937 &rng) {
+  std::uniform_real_distribution<float> angle{-PI, PI};
+  std::uniform_real_distribution<float> offset{-1e-3f, 1e-3f};
+  for (int i = 0; i < 1000; ++i) {
+    const float pole = (i % 2 == 0) ? HALF_PI : -HALF_PI;
+    const glm::vec3 angles{pole + offset(rng), angle(rng), angle(rng)};
+    transform_component transform;
+    transform.setEulerRotation(angles);
+    const glm::mat3 expected = rotationOf(transform);
+
+    // y and z are ambiguous here, setting what came back must give the
+    // same rotation.
+    transform_component again;
+    again.setEulerRotation(transform.getEulerRotation());
+    VS_CHECK(nearlyEqual(rotationOf(again), expected));
+  }
+}
+
+void testDirty() {
+  transform_component transform;
+  VS_CHECK(transform.updateMatrices());
+  VS_CHECK(!transform.updateMatrices());
+
+  transform.setEulerRotation({0.3f, 0.2f, 0.1f});
+  VS_CHECK(transform.isDirty());
+  VS_CHECK(transform.updateMatrices());
+  // the same angles give the same quaternion, nothing to recompute.
+  transform.setEulerRotation({0.3f, 0.2f, 0.1f});
+  VS_CHECK(!transform.isDirty());
+}
+} // namespace
+
+int main() {
+  std::mt19937 rng{1};
+  testRoundTrip(rng);
+  testPoles(rng);
+  testDirty();
+  return vs::test::exitCode();
+}